@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include "Arena.h"
+
+namespace ELF
+{
+
+Arena::Arena(std::size_t block_size)
+    : block_size_(block_size), blocks_(nullptr), cursor_(nullptr), end_(nullptr), capacity_(0) { }
+
+Arena::Arena(Arena&& object) noexcept
+    : block_size_(object.block_size_), blocks_(object.blocks_), cursor_(object.cursor_), end_(object.end_),
+    capacity_(object.capacity_)
+{
+    object.blocks_ = nullptr;
+    object.cursor_ = object.end_ = nullptr;
+    object.capacity_ = 0;
+}
+
+Arena& Arena::operator=(Arena&& object) noexcept
+{
+    if (this != &object)
+    {
+        reset();
+        std::free(blocks_);
+        block_size_ = object.block_size_;
+        blocks_ = object.blocks_;
+        cursor_ = object.cursor_;
+        end_ = object.end_;
+        capacity_ = object.capacity_;
+
+        object.blocks_ = nullptr;
+        object.cursor_ = object.end_ = nullptr;
+        object.capacity_ = 0;
+    }
+    return *this;
+}
+
+Arena::~Arena()
+{
+    reset();
+    std::free(blocks_);
+}
+
+const char *Arena::copy_string(const char *text, std::size_t length)
+{
+    char *copy = static_cast<char *>(allocate(length + 1, 1));
+    std::memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void Arena::reset()
+{
+    if (blocks_ == nullptr)
+    {
+        return;
+    }
+
+    while (blocks_->next != nullptr)
+    {
+        Block *next = blocks_->next;
+        capacity_ -= blocks_->size;
+        std::free(blocks_);
+        blocks_ = next;
+    }
+    cursor_ = reinterpret_cast<char *>(blocks_ + 1);
+    end_ = reinterpret_cast<char *>(blocks_) + blocks_->size;
+}
+
+/*
+* The current block is full: start a new one, large enough for the request if it is bigger
+* than a block.  The space left in the old block is given up.
+*/
+void *Arena::allocate_slow(std::size_t size, std::size_t alignment)
+{
+    std::size_t block_size = std::max(block_size_, sizeof(Block) + size + alignment);
+    Block *block = static_cast<Block *>(std::malloc(block_size));
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    block->next = blocks_;
+    block->size = block_size;
+    blocks_ = block;
+    capacity_ += block_size;
+    cursor_ = reinterpret_cast<char *>(block + 1);
+    end_ = reinterpret_cast<char *>(block) + block_size;
+    return allocate(size, alignment);
+}
+
+} // namespace ELF
@@ -0,0 +1,115 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace ELF
+{
+
+/*
+* A monotonic allocator: memory is handed out by bumping a pointer through blocks taken
+* from the heap, and is only ever released all at once by reset() or the destructor.  Only
+* objects that need no destructor may live in an arena.
+*
+* The first block is kept across reset(), so an arena reused for file after file settles on
+* one or two heap allocations per file.
+*/
+class Arena
+{
+public:
+    explicit Arena(std::size_t block_size = 64 * 1024);
+    Arena(const Arena& object) = delete;
+    Arena(Arena&& object) noexcept;
+    Arena& operator=(const Arena& object) = delete;
+    Arena& operator=(Arena&& object) noexcept;
+    ~Arena();
+
+    void *allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        std::uintptr_t start = (reinterpret_cast<std::uintptr_t>(cursor_) + alignment - 1) & ~(alignment - 1);
+        if (cursor_ == nullptr || start + size > reinterpret_cast<std::uintptr_t>(end_))
+        {
+            return allocate_slow(size, alignment);
+        }
+        cursor_ = reinterpret_cast<char *>(start + size);
+        return reinterpret_cast<void *>(start);
+    }
+
+    template <typename T>
+    T *allocate_array(std::size_t number)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return static_cast<T *>(allocate(sizeof(T) * number, alignof(T)));
+    }
+
+    // A NUL terminated copy of [text, text + length).
+    const char *copy_string(const char *text, std::size_t length);
+
+    // Release everything allocated so far.
+    void reset();
+
+    // Bytes of heap held, including unused space at the end of blocks.
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    struct Block
+    {
+        Block *next;
+        std::size_t size;
+    };
+
+    void *allocate_slow(std::size_t size, std::size_t alignment);
+
+    std::size_t block_size_;
+    Block *blocks_;         // most recent first; the last one is kept by reset()
+    char *cursor_;
+    char *end_;
+    std::size_t capacity_;
+};
+
+/*
+* Lets standard containers draw their nodes from an Arena, for per-query structures that
+* should not go through malloc once per entry.  Deallocation does nothing.
+*/
+template <typename T>
+class Arena_allocator
+{
+public:
+    typedef T value_type;
+
+    explicit Arena_allocator(Arena& arena) noexcept : arena_(&arena) { }
+
+    template <typename U>
+    Arena_allocator(const Arena_allocator<U>& other) noexcept : arena_(other.arena()) { }
+
+    T *allocate(std::size_t number)
+    {
+        return static_cast<T *>(arena_->allocate(sizeof(T) * number, alignof(T)));
+    }
+
+    void deallocate(T *, std::size_t) noexcept { }
+
+    Arena *arena() const noexcept { return arena_; }
+
+private:
+    Arena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const Arena_allocator<T>& a, const Arena_allocator<U>& b) noexcept
+{
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const Arena_allocator<T>& a, const Arena_allocator<U>& b) noexcept
+{
+    return a.arena() != b.arena();
+}
+
+} // namespace ELF
+
+#endif // ARENA_H
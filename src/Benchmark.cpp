@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Benchmark.h"
+#include "Simd_scan.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+// Timed runs per loader and cache state; the median is reported.
+const int BENCHMARK_ROUNDS = 5;
+
+struct Loader_result
+{
+    double cold;                // milliseconds
+    double warm;
+    std::uint64_t bytes_read;   // 0 for the mapping
+    bool fell_back;             // io_uring was asked for and pread was used
+};
+
+void drop_page_cache(const std::string& file_path)
+{
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+double median(std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+} // namespace
+
+std::error_code run_benchmark(const std::string& file_path, unsigned parts,
+                              const std::function<void(const ELF_reader&, std::FILE *)>& show, std::FILE *out)
+{
+    std::FILE *null_out = std::fopen("/dev/null", "w");
+    if (null_out == nullptr)
+    {
+        return std::error_code(errno, std::system_category());
+    }
+
+    const char *names[] = {"mmap", "io_uring", "pread"};
+    Loader_result results[3];
+    std::error_code error;
+
+    for (int loader_index = 0; loader_index < 3 && !error; ++loader_index)
+    {
+        Region_loader loader(parts, loader_index == 2 ? Region_loader::Method::pread
+                                                      : Region_loader::Method::io_uring);
+        std::vector<double> cold, warm;
+
+        // The first warm run is not timed; it only fills the page cache.
+        for (int round = 0; round < 2 * BENCHMARK_ROUNDS + 1 && !error; ++round)
+        {
+            bool is_cold = round < BENCHMARK_ROUNDS;
+            if (is_cold)
+            {
+                drop_page_cache(file_path);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            {
+                ELF_reader reader;
+                error = loader_index == 0 ? reader.load_file(file_path) : reader.load_regions(file_path, loader);
+                if (!error)
+                {
+                    show(reader, null_out);
+                    std::fflush(null_out);
+                }
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (is_cold)
+                cold.push_back(elapsed.count());
+            else if (round != BENCHMARK_ROUNDS)
+                warm.push_back(elapsed.count());
+        }
+        if (!error)
+        {
+            results[loader_index] = Loader_result{median(cold), median(warm),
+                                                  loader_index == 0 ? 0 : loader.bytes_read(),
+                                                  loader_index == 1 && loader.method() != Region_loader::Method::io_uring};
+        }
+    }
+    std::fclose(null_out);
+    if (error)
+    {
+        return error;
+    }
+
+    fprintf(out, "Loader benchmark for %s, median of %d runs, %s kernels:\n", file_path.c_str(), BENCHMARK_ROUNDS,
+            simd_level_name(simd_level()));
+    fprintf(out, "  Loader      Bytes read   Cold (ms)   Warm (ms)\n");
+    for (int i = 0; i < 3; ++i)
+    {
+        if (i == 0)
+            fprintf(out, "  %-10s  %10s", names[i], "on demand");
+        else
+            fprintf(out, "  %-10s  %10lu", names[i], results[i].bytes_read);
+        fprintf(out, "  %10.3f  %10.3f%s\n", results[i].cold, results[i].warm,
+                results[i].fell_back ? "  (io_uring unavailable, used pread)" : "");
+    }
+    return error;
+}
+
+} // namespace ELF
@@ -0,0 +1,26 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <system_error>
+#include "ELF_reader.h"
+
+namespace ELF
+{
+
+/*
+* Compare the loaders on one file: the mmap loader, and the region loader reading the given
+* parts through io_uring and through pread.  Each run loads the file and passes the reader to
+* show with /dev/null as output, so the page faults a mapping takes while printing are
+* counted too.  Cold runs first ask the kernel to drop the file from the page cache, which
+* only works for pages nobody else has mapped.  Medians are printed to out.
+*/
+std::error_code run_benchmark(const std::string& file_path, unsigned parts,
+                              const std::function<void(const ELF_reader&, std::FILE *)>& show,
+                              std::FILE *out = stdout);
+
+} // namespace ELF
+
+#endif // BENCHMARK_H
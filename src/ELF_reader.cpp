@@ -1,8 +1,12 @@
 #include <string>
 #include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <map>
+#include <utility>
 #include <elf.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -10,39 +14,261 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include "ELF_reader.h"
-
-#ifndef ERROR_EXIT
-#define ERROR_EXIT(msg) do { \
-    ::perror(msg);           \
-    ::exit(EXIT_FAILURE);    \
-} while (0)
-#endif
+#include "Simd_scan.h"
+#include "Stream_loader.h"
 
 namespace ELF
 {
 
+namespace
+{
+
+// Surviving symbols per string table byte above which the prefix is found by scanning.
+const std::size_t PREFIX_SCAN_RATIO = 32;
+
+// Characters of a symbol name show_symbols() prints.
+const std::size_t SYMBOL_NAME_WIDTH = 25;
+
+// Hex dump lines formatted per write.
+const std::size_t DUMP_BATCH_LINES = 1024;
+
+// Longest hex dump line: "  0x", a 64-bit address, a space, the bytes and a newline.
+const std::size_t DUMP_LINE_SPACE = 4 + 16 + 1 + HEX_LINE_LENGTH + 1;
+
+// Hex digits readelf shows for an address: at least eight.
+std::size_t address_digits(std::uint64_t address)
+{
+    std::size_t digits = 8;
+    while (digits < 16 && (address >> (4 * digits)) != 0)
+    {
+        ++digits;
+    }
+    return digits;
+}
+
+char *format_address(char *out, std::uint64_t address, std::size_t digits)
+{
+    for (std::size_t i = digits; i-- != 0; )
+    {
+        *out++ = "0123456789abcdef"[(address >> (4 * i)) & 0xf];
+    }
+    return out;
+}
+
+struct Section_flag
+{
+    Elf64_Xword flag;
+    char letter;
+};
+
+// The sh_flags letters, in the (ASCII) order they are shown in.
+const Section_flag section_flags[] = {
+    {SHF_ALLOC,             'A'},
+    {SHF_COMPRESSED,        'C'},
+    {SHF_EXCLUDE,           'E'},
+    {SHF_GROUP,             'G'},
+    {SHF_INFO_LINK,         'I'},
+    {SHF_LINK_ORDER,        'L'},
+    {SHF_MERGE,             'M'},
+    {SHF_OS_NONCONFORMING,  'O'},
+    {SHF_STRINGS,           'S'},
+    {SHF_TLS,               'T'},
+    {SHF_WRITE,             'W'},
+    {SHF_EXECINSTR,         'X'},
+};
+
+// Sections above 2 GiB in the x86-64 medium and large code models; not in <elf.h>.
+const Elf64_Xword SHF_X86_64_LARGE = 0x10000000;
+
+// The Type column of a section header row.
+const char *section_type_text(Elf64_Word type)
+{
+    /*
+    * sh_type: This member categorizes the section's contents and semantics.
+    * 
+    */
+    switch (type)
+    {
+    // Section header table entry unused
+    case SHT_NULL:
+        return "NULL             ";
+
+    // Program data
+    case SHT_PROGBITS:
+        return "PROGBITS         ";
+
+    // Symbol table
+    case SHT_SYMTAB:
+        return "SYMTAB           ";
+
+    // String table
+    case SHT_STRTAB:
+        return "STRTAB           ";
+
+    // Relocation entries with addends
+    case SHT_RELA:
+        return "RELA             ";
+
+    // Symbol hash table
+    case SHT_HASH:
+        return "HASH             ";
+
+    // Dynamic linking information
+    case SHT_DYNAMIC:
+        return "DYNAMIC          ";
+
+    // Notes
+    case SHT_NOTE:
+        return "NOTE             ";
+
+    // Program space with no data (bss)
+    case SHT_NOBITS:
+        return "NOBITS           ";
+
+    // Relocation entries, no addends
+    case SHT_REL:
+        return "REL              ";
+
+    // Reserved
+    case SHT_SHLIB:
+        return "SHLIB            ";
+
+    // Dynamic linker symbol table
+    case SHT_DYNSYM:
+        return "DYNSYM           ";
+
+    // Array of constructors
+    case SHT_INIT_ARRAY:
+        return "INIT_ARRAY       ";
+
+    // Array of destructors
+    case SHT_FINI_ARRAY:
+        return "FINI_ARRAY       ";
+
+    // Array of pre-constructors
+    case SHT_PREINIT_ARRAY:
+        return "PREINIT_ARRAY    ";
+
+    // Section group
+    case SHT_GROUP:
+        return "GROUP            ";
+
+    // Extended section indeces
+    case SHT_SYMTAB_SHNDX:
+        return "SYMTAB_SHNDX     ";
+
+    // Relative relocations, compressed
+    case SHT_RELR:
+        return "RELR             ";
+
+    // Object attributes
+    case SHT_GNU_ATTRIBUTES:
+        return "GNU_ATTRIBUTES   ";
+
+    // GNU-style hash table
+    case SHT_GNU_HASH:
+        return "GNU_HASH         ";
+
+    // Prelink library list
+    case SHT_GNU_LIBLIST:
+        return "GNU_LIBLIST      ";
+
+    // Checksum for DSO content
+    case SHT_CHECKSUM:
+        return "CHECKSUM         ";
+
+    // Version definition section
+    case SHT_GNU_verdef:
+        return "VERDEF           ";
+
+    // Version needs section
+    case SHT_GNU_verneed:
+        return "VERNEED          ";
+
+    // Version symbol table
+    case SHT_GNU_versym:
+        return "VERSYM           ";
+
+    default:
+        return "Unknown          ";
+    }
+}
+
+class ELF_category : public std::error_category
+{
+public:
+    const char *name() const noexcept override
+    {
+        return "elf";
+    }
+
+    std::string message(int condition) const override
+    {
+        switch (static_cast<Error>(condition))
+        {
+        case Error::not_elf:
+            return "It's not a ELF file";
+        case Error::unsupported_class:
+            return "It only support 64-bit architecture now";
+        case Error::truncated:
+            return "File is truncated";
+        case Error::bad_symbol_table:
+            return "Symbol table has a bad entry size or string table link";
+        default:
+            return "Unknown error";
+        }
+    }
+};
+
+} // namespace
+
+const std::error_category& elf_category() noexcept
+{
+    static const ELF_category category;
+    return category;
+}
+
+std::error_code make_error_code(Error error) noexcept
+{
+    return std::error_code(static_cast<int>(error), elf_category());
+}
+
 ELF_reader::ELF_reader()
-    : fd_(-1), program_length_(0) , mmap_program_(nullptr) { }
+    : fd_(-1), program_length_(0) , mmap_program_(nullptr), section_rows_(nullptr) { }
 
 ELF_reader::ELF_reader(const std::string& file_path)
-    : file_path_(file_path)
+    : file_path_(file_path), fd_(-1), program_length_(0), mmap_program_(nullptr), section_rows_(nullptr)
 {
-    load_memory_map();
+    error_ = load_memory_map();
 }
 
 ELF_reader::ELF_reader(ELF_reader&& object) noexcept
     : file_path_(std::move(object.file_path_)), fd_(object.fd_),
-    program_length_(object.program_length_), mmap_program_(object.mmap_program_)
+    program_length_(object.program_length_), mmap_program_(object.mmap_program_),
+    error_(object.error_), device_(object.device_), inode_(object.inode_), modify_time_(object.modify_time_),
+    arena_(std::move(object.arena_)), section_rows_(object.section_rows_)
 {
     object.initialize_members();
+    object.error_.clear();
 }
 
 ELF_reader& ELF_reader::operator=(ELF_reader&& object) noexcept
 {
-    initialize_members(std::move(object.file_path_), object.fd_,
-                       object.program_length_, object.mmap_program_);
-
-    object.initialize_members();
+    if (this != &object)
+    {
+        close_memory_map();
+        initialize_members(std::move(object.file_path_), object.fd_,
+                           object.program_length_, object.mmap_program_);
+        error_ = object.error_;
+        device_ = object.device_;
+        inode_ = object.inode_;
+        modify_time_ = object.modify_time_;
+        arena_ = std::move(object.arena_);
+        section_rows_ = object.section_rows_;
+
+        object.initialize_members();
+        object.error_.clear();
+    }
     return *this;
 }
 
@@ -51,15 +277,114 @@ ELF_reader::~ELF_reader()
     close_memory_map();
 }
 
-void ELF_reader::load_file(const std::string& path_name)
+/*
+* Loading the path that is already mapped keeps the mapping when the file is still the same
+* one: same device, inode, size and modification time.  An image read by load_regions() or
+* load_stream() may hold only part of the file, so it is always replaced.
+*/
+std::error_code ELF_reader::load_file(const std::string& path_name)
 {
+    struct stat st;
+
+    if (mmap_program_ != nullptr && fd_ != -1 && path_name == file_path_ && ::stat(path_name.c_str(), &st) == 0 &&
+        st.st_dev == device_ && st.st_ino == inode_ && static_cast<std::size_t>(st.st_size) == program_length_ &&
+        st.st_mtim.tv_sec == modify_time_.tv_sec && st.st_mtim.tv_nsec == modify_time_.tv_nsec)
+    {
+        return error_;
+    }
+
+    close_memory_map();
     file_path_ = path_name;
+    error_ = load_memory_map();
+    return error_;
+}
+
+std::error_code ELF_reader::load_stream(int fd, const std::string& name, unsigned parts)
+{
+    Sparse_image image;
+
+    close_memory_map();
+    error_ = Stream_loader(fd, parts).load(image);
+    if (error_)
+    {
+        initialize_members(name);
+        return error_;
+    }
+
+    std::size_t program_length = image.length();
+    initialize_members(name, -1, program_length, image.release());
+    device_ = 0;
+    inode_ = 0;
+    modify_time_ = timespec();
+
+    if ((error_ = check_headers()))
+    {
+        close_memory_map();
+    }
+    else
+    {
+        decode_sections();
+    }
+    return error_;
+}
+
+std::error_code ELF_reader::load_regions(const std::string& path_name, Region_loader& loader)
+{
+    struct stat st;
+    Sparse_image image;
+    int fd;
+
     close_memory_map();
-    load_memory_map();
+    file_path_ = path_name;
+
+    if ((fd = open(file_path_.c_str(), O_RDONLY | O_CLOEXEC)) == -1 || fstat(fd, &st) == -1)
+    {
+        error_.assign(errno, std::system_category());
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+        return error_;
+    }
+
+    if (!S_ISREG(st.st_mode) || static_cast<std::size_t>(st.st_size) < sizeof(Elf64_Ehdr))
+    {
+        ::close(fd);
+        error_ = S_ISREG(st.st_mode) ? make_error_code(Error::truncated)
+                                     : std::make_error_code(std::errc::invalid_argument);
+        return error_;
+    }
+
+    error_ = loader.load(fd, static_cast<std::size_t>(st.st_size), image);
+    ::close(fd);
+    if (error_)
+    {
+        return error_;
+    }
+
+    initialize_members(std::move(file_path_), -1, image.length(), image.release());
+    device_ = st.st_dev;
+    inode_ = st.st_ino;
+    modify_time_ = st.st_mtim;
+
+    if ((error_ = check_headers()))
+    {
+        close_memory_map();
+    }
+    else
+    {
+        decode_sections();
+    }
+    return error_;
 }
 
-void ELF_reader::show_file_header() const
+void ELF_reader::show_file_header(std::FILE *out) const
 {
+    if (mmap_program_ == nullptr)
+    {
+        return;
+    }
+
     const Elf64_Ehdr *file_header;
     file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
 
@@ -79,27 +404,27 @@ void ELF_reader::show_file_header() const
     if (file_header->e_ident[EI_MAG0] != ELFMAG0 || file_header->e_ident[EI_MAG1] != ELFMAG1 ||
         file_header->e_ident[EI_MAG2] != ELFMAG2 || file_header->e_ident[EI_MAG3] != ELFMAG3)
     {
-        printf("It's not a ELF file.\n");
+        fprintf(out, "It's not a ELF file.\n");
         return;
     }
 
     if (file_header->e_ident[EI_CLASS] != ELFCLASS64)
     {
-        printf("It only support 64-bit architecture now!\n");
+        fprintf(out, "It only support 64-bit architecture now!\n");
         return;
     }
 
-    printf("ELF Header:\n");
+    fprintf(out, "ELF Header:\n");
 
     /*
     * Magic number and other info
     */
-    printf("  Magic:  ");
+    fprintf(out, "  Magic:  ");
     for (int i = 0; i < EI_NIDENT; ++i)
     {
-        printf(" %02x", file_header->e_ident[i]);
+        fprintf(out, " %02x", file_header->e_ident[i]);
     }
-    printf("\n");
+    fprintf(out, "\n");
 
     /*
     * EI_CLASS: The fifth byte identifies the architecture for this binary:
@@ -110,20 +435,20 @@ void ELF_reader::show_file_header() const
     *                 Gigabytes.
     *   ELFCLASS64  : This defines the 64-bit architecture.
     */
-    printf("  Class:                             ");
+    fprintf(out, "  Class:                             ");
     switch (file_header->e_ident[EI_CLASS])
     {
     case ELFCLASSNONE:
-        printf("INVALID\n");
+        fprintf(out, "INVALID\n");
         break;
     case ELFCLASS32:
-        printf("ELF32\n");
+        fprintf(out, "ELF32\n");
         break;
     case ELFCLASS64:
-        printf("Elf64\n");
+        fprintf(out, "ELF64\n");
         break;
     default:
-        printf("Unknown class");
+        fprintf(out, "Unknown class\n");
         break;
     }
 
@@ -135,20 +460,20 @@ void ELF_reader::show_file_header() const
     *     ELFDATA2LSB: Two's complement, little-endian.
     *     ELFDATA2MSB: Two's complement, big-endian.
     */
-    printf("  Data:                              ");
+    fprintf(out, "  Data:                              ");
     switch (file_header->e_ident[EI_DATA])
     {
     case ELFDATANONE:
-        printf("unknown data format\n");
+        fprintf(out, "unknown data format\n");
         break;
     case ELFDATA2LSB:
-        printf("2's complement, little-endian\n");
+        fprintf(out, "2's complement, little-endian\n");
         break;
     case ELFDATA2MSB:
-        printf("2's complement, big-endian\n");
+        fprintf(out, "2's complement, big-endian\n");
         break;
     default:
-        printf("error data format\n");
+        fprintf(out, "error data format\n");
         break;
     }
 
@@ -160,8 +485,8 @@ void ELF_reader::show_file_header() const
     *      the  ABI  identified  by the EI_OSABI field.  Applications conforming to
     *      this specification use the value 0.
     */
-    printf("  Version:                           ");
-    printf("%d\n", (int)file_header->e_ident[EI_ABIVERSION]);
+    fprintf(out, "  Version:                           ");
+    fprintf(out, "%d\n", (int)file_header->e_ident[EI_ABIVERSION]);
 
     /*
     * EI_OSABI: The  eighth  byte  identifies  the operating system and ABI to which the
@@ -181,41 +506,41 @@ void ELF_reader::show_file_header() const
     *     ELFOSABI_ARM        ARM architecture ABI.
     *     ELFOSABI_STANDALONE Stand-alone (embedded) ABI.
     */
-    printf("  OS/ABI:                            ");
+    fprintf(out, "  OS/ABI:                            ");
     switch (file_header->e_ident[EI_OSABI])
     {
     case ELFOSABI_SYSV:
-        printf("UNIX System V ABI\n");
+        fprintf(out, "UNIX System V ABI\n");
         break;
     case ELFOSABI_HPUX:
-        printf("HP-UX ABI\n");
+        fprintf(out, "HP-UX ABI\n");
         break;
     case ELFOSABI_NETBSD:
-        printf("NetBSD ABI\n");
+        fprintf(out, "NetBSD ABI\n");
         break;
     case ELFOSABI_LINUX:
-        printf("Linux ABI\n");
+        fprintf(out, "Linux ABI\n");
         break;
     case ELFOSABI_SOLARIS:
-        printf("Solaris ABI\n");
+        fprintf(out, "Solaris ABI\n");
         break;
     case ELFOSABI_IRIX:
-        printf("IRIX ABI\n");
+        fprintf(out, "IRIX ABI\n");
         break;
     case ELFOSABI_FREEBSD:
-        printf("FreeBSD ABI\n");
+        fprintf(out, "FreeBSD ABI\n");
         break;
     case ELFOSABI_TRU64:
-        printf("TRU64 UNIX ABI\n");
+        fprintf(out, "TRU64 UNIX ABI\n");
         break;
     case ELFOSABI_ARM:
-        printf("ARM architecture ABI\n");
+        fprintf(out, "ARM architecture ABI\n");
         break;
     case ELFOSABI_STANDALONE:
-        printf("Stand-alone (embedded) ABI\n");
+        fprintf(out, "Stand-alone (embedded) ABI\n");
         break;
     default:
-        printf("Unknown ABI\n");
+        fprintf(out, "Unknown ABI\n");
         break;
     }
 
@@ -228,26 +553,26 @@ void ELF_reader::show_file_header() const
     *     ET_DYN : A shared object.
     *     ET_CORE: A core file.
     */
-    printf("  Type:                              ");
+    fprintf(out, "  Type:                              ");
     switch (file_header->e_type)
     {
     case ET_NONE:
-        printf("unknonw type\n");
+        fprintf(out, "unknonw type\n");
         break;
     case ET_REL:
-        printf("relocatable file\n");
+        fprintf(out, "relocatable file\n");
         break;
     case ET_EXEC:
-        printf("executable file\n");
+        fprintf(out, "executable file\n");
         break;
     case ET_DYN:
-        printf("shared object\n");
+        fprintf(out, "shared object\n");
         break;
     case ET_CORE:
-        printf("core file\n");
+        fprintf(out, "core file\n");
         break;
     default:
-        printf("error\n");
+        fprintf(out, "error\n");
         break;
     }
 
@@ -275,68 +600,68 @@ void ELF_reader::show_file_header() const
     *     EM_X86_64   AMD x86-64
     *     EM_VAX      DEC Vax.
     */
-    printf("  Machine:                           ");
+    fprintf(out, "  Machine:                           ");
     switch (file_header->e_machine)
     {
     case EM_NONE:
-        printf("unknown machine\n");
+        fprintf(out, "unknown machine\n");
         break;
     case EM_M32:
-        printf("AT&T WE 32100\n");
+        fprintf(out, "AT&T WE 32100\n");
         break;
     case EM_SPARC:
-        printf("Sun Microsystems SPARC\n");
+        fprintf(out, "Sun Microsystems SPARC\n");
         break;
     case EM_386:
-        printf("Intel 80386\n");
+        fprintf(out, "Intel 80386\n");
         break;
     case EM_68K:
-        printf("Motorola 68000\n");
+        fprintf(out, "Motorola 68000\n");
         break;
     case EM_88K:
-        printf("Motorola 88000\n");
+        fprintf(out, "Motorola 88000\n");
         break;
     case EM_860:
-        printf("Intel 80860\n");
+        fprintf(out, "Intel 80860\n");
         break;
     case EM_MIPS:
-        printf("MIPS RS3000 (big-endian only)\n");
+        fprintf(out, "MIPS RS3000 (big-endian only)\n");
         break;
     case EM_PARISC:
-        printf("HP/PA\n");
+        fprintf(out, "HP/PA\n");
         break;
     case EM_SPARC32PLUS:
-        printf("SPARC with enhanced instruction set\n");
+        fprintf(out, "SPARC with enhanced instruction set\n");
         break;
     case EM_PPC:
-        printf("PowerPC\n");
+        fprintf(out, "PowerPC\n");
         break;
     case EM_PPC64:
-        printf("PowerPC 64-bit\n");
+        fprintf(out, "PowerPC 64-bit\n");
         break;
     case EM_S390:
-        printf("IBM S/390\n");
+        fprintf(out, "IBM S/390\n");
         break;
     case EM_ARM:
-        printf("Advanced RISC Machines\n");
+        fprintf(out, "Advanced RISC Machines\n");
         break;
     case EM_SH:
-        printf("Renesas SuperH\n");
+        fprintf(out, "Renesas SuperH\n");
         break;
     case EM_SPARCV9:
-        printf("SPARC v9 64-bit\n");
+        fprintf(out, "SPARC v9 64-bit\n");
         break;
     case EM_IA_64:
-        printf("Intel Itanium\n");
+        fprintf(out, "Intel Itanium\n");
         break;
     case EM_X86_64:
-        printf("AMD x86-64\n");
+        fprintf(out, "AMD x86-64\n");
         break;
     case EM_VAX:
-        printf("DEC Vax\n");
+        fprintf(out, "DEC Vax\n");
         break;
     default:
-        printf("error\n");
+        fprintf(out, "error\n");
         break;
     }
 
@@ -346,17 +671,17 @@ void ELF_reader::show_file_header() const
     *     EV_NONE   : Invalid version.
     *     EV_CURRENT: Current version.
     */
-    printf("  Version:                           ");
+    fprintf(out, "  Version:                           ");
     switch (file_header->e_ident[EI_VERSION])
     {
     case EV_NONE:
-        printf("invalid version\n");
+        fprintf(out, "invalid version\n");
         break;
     case EV_CURRENT:
-        printf("current version\n");
+        fprintf(out, "current version\n");
         break;
     default:
-        printf("error version\n");
+        fprintf(out, "error version\n");
         break;
     }
 
@@ -365,43 +690,43 @@ void ELF_reader::show_file_header() const
     *          thus starting the process.  If the file has no associated entry point,  this  member
     *          holds zero.
     */
-    printf("  Entry point address:               ");
-    printf("0x%lx\n", file_header->e_entry);
+    fprintf(out, "  Entry point address:               ");
+    fprintf(out, "0x%lx\n", file_header->e_entry);
 
     /*
     * e_phoff: This  member holds the program header table's file offset in bytes.  If the file has
     *          no program header table, this member holds zero.
     */
-    printf("  Start of program headers:          ");
-    printf("%ld (bytes into file)\n", file_header->e_phoff);
+    fprintf(out, "  Start of program headers:          ");
+    fprintf(out, "%ld (bytes into file)\n", file_header->e_phoff);
 
     /*
     * e_shoff: This member holds the section header table's file offset in bytes.  If the file  has
     *          no section header table, this member holds zero.
     */
-    printf("  Start of section headers:          ");
-    printf("%ld (bytes into file)\n", file_header->e_shoff);
+    fprintf(out, "  Start of section headers:          ");
+    fprintf(out, "%ld (bytes into file)\n", file_header->e_shoff);
 
     /*
     * e_flags: This  member  holds  processor-specific  flags associated with the file.  Flag names
     *          take the form EF_`machine_flag'.  Currently no flags have been defined.
     */
-    printf("  Flags:                             ");
-    printf("0x%x\n", file_header->e_flags);
+    fprintf(out, "  Flags:                             ");
+    fprintf(out, "0x%x\n", file_header->e_flags);
 
     /*
     * e_ehsize: This member holds the ELF header's size in bytes.
     */
-    printf("  Size of this header:               ");
-    printf("%d (bytes)\n", file_header->e_ehsize);
+    fprintf(out, "  Size of this header:               ");
+    fprintf(out, "%d (bytes)\n", file_header->e_ehsize);
 
     /*
     * e_phentsize: This member holds the size in bytes of one entry in the file's program header table;
     *              all entries are the same size.
 
     */
-    printf("  Size of program headers:           ");
-    printf("%d (bytes)\n", file_header->e_phentsize);
+    fprintf(out, "  Size of program headers:           ");
+    fprintf(out, "%d (bytes)\n", file_header->e_phentsize);
 
     /*
     * e_phnum: This member holds the number of entries in the program header table.  Thus the product
@@ -414,16 +739,16 @@ void ELF_reader::show_file_header() const
     *          section header table.  Otherwise, the sh_info member of the initial  entry  contains
     *          the value zero.
     */
-    printf("  Number of program headers:         ");
-    printf("%d\n", file_header->e_phnum < PN_XNUM ? file_header->e_phnum : 
+    fprintf(out, "  Number of program headers:         ");
+    fprintf(out, "%d\n", file_header->e_phnum < PN_XNUM ? file_header->e_phnum : 
                    ((Elf64_Shdr *)(&mmap_program_[file_header->e_shoff]))->sh_info);
 
     /*
     * e_shentsize: This member holds a sections header's size in bytes.  A section header is one  entry
     *              in the section header table; all entries are the same size.
     */
-    printf("  Size of section headers:           ");
-    printf("%d (bytes)\n", file_header->e_shentsize);
+    fprintf(out, "  Size of section headers:           ");
+    fprintf(out, "%d (bytes)\n", file_header->e_shentsize);
 
     /*
     * e_shnum: This member holds the number of entries in the section header table.  Thus the prod‐
@@ -436,9 +761,9 @@ void ELF_reader::show_file_header() const
     *          section header table.  Otherwise, the sh_size member of the  initial  entry  in  the
     *          section header table holds the value zero.
     */
-    printf("  Number of section headers:         ");
+    fprintf(out, "  Number of section headers:         ");
     auto shnum = reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_size;
-    printf("%lu\n", shnum == 0 ? static_cast<decltype(shnum)>(file_header->e_shnum) : shnum);
+    fprintf(out, "%lu\n", shnum == 0 ? static_cast<decltype(shnum)>(file_header->e_shnum) : shnum);
 
     /*
     * e_shstrndx: This  member  holds  the section header table index of the entry associated with the
@@ -451,35 +776,37 @@ void ELF_reader::show_file_header() const
     *             entry in section header table.  Otherwise, the sh_link member of the  initial  entry
     *             in section header table contains the value zero.
     */
-    printf("  Section header string table index: ");
+    fprintf(out, "  Section header string table index: ");
     switch (file_header->e_shstrndx)
     {
     case SHN_UNDEF:
-        printf("undefined value\n");
+        fprintf(out, "undefined value\n");
         break;
     case SHN_XINDEX:
-        printf("%u\n", reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_link);
+        fprintf(out, "%u\n", reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_link);
         break;
     default:
-        printf("%u\n", file_header->e_shstrndx);
+        fprintf(out, "%u\n", file_header->e_shstrndx);
         break;
     }
 }
 
-void ELF_reader::show_section_headers() const
+void ELF_reader::show_section_headers(std::FILE *out) const
 {
+    if (mmap_program_ == nullptr)
+    {
+        return;
+    }
+
     const Elf64_Ehdr *file_header;
-    const Elf64_Shdr *section_table;
-    const char *section_string_table;
-    size_t section_string_table_index;
     Elf64_Xword section_number;
 
     file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
-    section_table = reinterpret_cast<Elf64_Shdr *>(mmap_program_ + file_header->e_shoff);
-    section_string_table_index = file_header->e_shstrndx == SHN_XINDEX ?
-         reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_link :
-         file_header->e_shstrndx;
-    section_string_table = reinterpret_cast<char *>(&mmap_program_[section_table[section_string_table_index].sh_offset]);
+    if (file_header->e_shoff == 0)
+    {
+        fprintf(out, "\nThere are no sections in this file.\n");
+        return;
+    }
 
     section_number = reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_size;
     if (section_number == 0)
@@ -487,391 +814,1100 @@ void ELF_reader::show_section_headers() const
         section_number = file_header->e_shnum;
     }
 
-    printf("There are %ld section header%s, starting at offset 0x%lx:\n\n", section_number, 
+    fprintf(out, "There are %ld section header%s, starting at offset 0x%lx:\n\n", section_number, 
            section_number > 1 ? "s" : "", file_header->e_shoff);
-    printf("Section Headers:\n"
+    fprintf(out, "Section Headers:\n"
            "  [Nr] Name              Type             Address           Offset\n"
            "       Size              EntSize          Flags  Link  Info  Align\n");
     for (decltype(section_number) i = 0; i < section_number; ++i)
     {
-        printf("  [%2lu] ", i);
+        show_section_header(i, out);
+    }
+    fprintf(out, "Key to Flags:\n"
+           "  W (write), A (alloc), X (execute), M (merge), S (strings), l (large)\n"
+           "  I (info), L (link order), G (group), T (TLS), E (exclude), x (unknown)\n"
+           "  C (compressed), R (retain), O (extra OS processing required)\n"
+           "  o (OS specific), p (processor specific)\n");
 
-        /*
-        * sh_name: This member specifies the name of the section.  Its value is an index into  the
-        * section header string table section, giving the location of a null-terminated string.
-        */
-        printf("%-16.16s  ", section_string_table+section_table[i].sh_name);
+}
 
-        /*
-        * sh_type: This member categorizes the section's contents and semantics.
-        * 
-        */
-        switch (section_table[i].sh_type)
-        {
-        // Section header table entry unused
-        case SHT_NULL:
-            printf("NULL             ");
-            break;
-
-        // Program data
-        case SHT_PROGBITS:
-            printf("PROGBITS         ");
-            break;
-
-        // Symbol table
-        case SHT_SYMTAB:
-            printf("SYMTAB           ");
-            break;
-
-        // String table
-        case SHT_STRTAB:
-            printf("STRTAB           ");
-            break;
-
-        // Relocation entries with addends
-        case SHT_RELA:
-            printf("RELA             ");
-            break;
-
-        // Symbol hash table
-        case SHT_HASH:
-            printf("HASH             ");
-            break;
-
-        // Dynamic linking information
-        case SHT_DYNAMIC:
-            printf("DYNSYM           ");
-            break;
-
-        // Notes
-        case SHT_NOTE:
-            printf("NOTE             ");
-            break;
-
-        // Program space with no data (bss)
-        case SHT_NOBITS:
-            printf("NOBITS           ");
-            break;
-
-        // Relocation entries, no addends
-        case SHT_REL:
-            printf("REL              ");
-            break;
-
-        // Reserved
-        case SHT_SHLIB:
-            printf("SHLIB            ");
-            break;
-
-        // Dynamic linker symbol table
-        case SHT_DYNSYM:
-            printf("DYNSYM           ");
-            break;
-
-        // Array of constructors
-        case SHT_INIT_ARRAY:
-            printf("INIT_ARRAY       ");
-            break;
-
-        // Array of destructors
-        case SHT_FINI_ARRAY:
-            printf("FINIT_ARRAY       ");
-            break;
-
-        // Array of pre-constructors
-        case SHT_PREINIT_ARRAY:
-            printf("PREINIT_ARRAY    ");
-            break;
-
-        // Section group
-        case SHT_GROUP:
-            printf("GROUP            ");
-            break;
-
-        // Extended section indeces
-        case SHT_SYMTAB_SHNDX:
-            printf("SYMTAB_SHNDX     ");
-            break;
-
-        // Object attributes
-        case SHT_GNU_ATTRIBUTES:
-            printf("GNU_ATTRIBUTES   ");
-            break;
-
-        // GNU-style hash table
-        case SHT_GNU_HASH:
-            printf("GNU_HASH         ");
-            break;
-
-        // Prelink library list
-        case SHT_GNU_LIBLIST:
-            printf("GNU_LIBLIST      ");
-            break;
-
-        // Checksum for DSO content
-        case SHT_CHECKSUM:
-            printf("CHECKSUM         ");
-            break;
-
-        // Version definition section
-        case SHT_GNU_verdef:
-            printf("VERDEF           ");
-            break;
-
-        // Version needs section
-        case SHT_GNU_verneed:
-            printf("VERNEED          ");
-            break;
-
-        // Version symbol table
-        case SHT_GNU_versym:
-            printf("VERSYM           ");
-            break;
+// Print the two-line row of section i as it appears in show_section_headers().
+void ELF_reader::show_section_header(std::size_t i, std::FILE *out) const
+{
+    if (section_header(i) == nullptr)
+    {
+        return;
+    }
+    const Elf64_Shdr *section_table = section_header(0);
 
-        default:
-            printf("Unknown          ");
-            break;
-        }
+    fprintf(out, "  [%2lu] ", i);
 
-        /*
-        * sh_addr: If  this  section  appears  in  the  memory image of a process, this member holds the
-        *          address at which the section's first byte should reside.  Otherwise, the member  con‐
-        *          tains zero.
-        */
-        printf("%016lx  ", section_table[i].sh_addr);
+    /*
+    * sh_name: This member specifies the name of the section.  Its value is an index into  the
+    * section header string table section, giving the location of a null-terminated string.
+    */
+    fprintf(out, "%-16.16s  ", section_name(i));
 
-        /*
-        * sh_offset: This member's value holds the byte offset from the beginning of the file to the first
-        *            byte in the section.  One section type, SHT_NOBITS, occupies no space  in  the  file,
-        *            and its sh_offset member locates the conceptual placement in the file.
-        */
-        printf("%08lx\n", section_table[i].sh_offset);
+    fprintf(out, "%s", section_rows_[i].type);
 
-        /*
-        * sh_size: This  member  holds  the  section's  size  in  bytes.   Unless  the  section  type is
-        *          SHT_NOBITS, the section occupies sh_size bytes  in  the  file.   A  section  of  type
-        *          SHT_NOBITS may have a nonzero size, but it occupies no space in the file.
-        */
-        printf("       %016lx  ", section_table[i].sh_size);
+    /*
+    * sh_addr: If  this  section  appears  in  the  memory image of a process, this member holds the
+    *          address at which the section's first byte should reside.  Otherwise, the member  con‐
+    *          tains zero.
+    */
+    fprintf(out, "%016lx  ", section_table[i].sh_addr);
 
-        /*
-        * sh_entsize:
-                 Some  sections hold a table of fixed-sized entries, such as a symbol table.  For such
-                 a section, this member gives the size in bytes for each entry.  This member  contains
-                 zero if the section does not hold a table of fixed-size entries.
+    /*
+    * sh_offset: This member's value holds the byte offset from the beginning of the file to the first
+    *            byte in the section.  One section type, SHT_NOBITS, occupies no space  in  the  file,
+    *            and its sh_offset member locates the conceptual placement in the file.
+    */
+    fprintf(out, "%08lx\n", section_table[i].sh_offset);
 
-        */
-        printf("%016lx ", section_table[i].sh_entsize);
+    /*
+    * sh_size: This  member  holds  the  section's  size  in  bytes.   Unless  the  section  type is
+    *          SHT_NOBITS, the section occupies sh_size bytes  in  the  file.   A  section  of  type
+    *          SHT_NOBITS may have a nonzero size, but it occupies no space in the file.
+    */
+    fprintf(out, "       %016lx  ", section_table[i].sh_size);
 
-        /*
-        * sh_flags: Sections support one-bit flags that describe miscellaneous attributes.  If a flag bit
-        *           is set in sh_flags, the attribute is "on" for the section.  Otherwise, the  attribute
-        *           is "off" or does not apply.  Undefined attributes are set to zero.
-        */
-        std::string flags;
-        if (section_table[i].sh_flags & SHF_WRITE)
-            flags.push_back('W');
-        if (section_table[i].sh_flags & SHF_ALLOC)
-            flags.push_back('A');
-        if (section_table[i].sh_flags & SHF_EXECINSTR)
-            flags.push_back('X');
-        if (section_table[i].sh_flags & SHF_MERGE)
-            flags.push_back('M');
-        if (section_table[i].sh_flags & SHF_STRINGS)
-            flags.push_back('S');
-        if (section_table[i].sh_flags & SHF_INFO_LINK)
-            flags.push_back('I');
-        if (section_table[i].sh_flags & SHF_LINK_ORDER)
-            flags.push_back('L');
-        if (section_table[i].sh_flags & SHF_OS_NONCONFORMING)
-            flags.push_back('O');
-        if (section_table[i].sh_flags & SHF_GROUP)
-            flags.push_back('G');
-        if (section_table[i].sh_flags & SHF_TLS)
-            flags.push_back('T');
-        if (section_table[i].sh_flags & SHF_COMPRESSED)
-            flags.push_back('l');
-        if (section_table[i].sh_flags & SHF_MASKOS)
-            flags.push_back('o');
-        if (section_table[i].sh_flags & SHF_MASKPROC)
-            flags.push_back('p');
-        if (section_table[i].sh_flags & SHF_ORDERED)
-            flags.push_back('x');
-        if (section_table[i].sh_flags & SHF_EXCLUDE)
-            flags.push_back('E');
-
-        std::sort(flags.begin(), flags.end());
-        printf("%5s  ", flags.c_str());
-        printf("%4d  ", section_table[i].sh_link);
-        printf("%4d  ", section_table[i].sh_info);
-        printf("%4lu\n", section_table[i].sh_addralign);
-    }
-    printf("Key to Flags:\n"
-           "  W (write), A (alloc), X (execute), M (merge), S (strings), l (large)\n"
-           "  I (info), L (link order), G (group), T (TLS), E (exclude), x (unknown)\n"
-           "  O (extra OS processing required) o (OS specific), p (processor specific)\n");
+    /*
+    * sh_entsize:
+             Some  sections hold a table of fixed-sized entries, such as a symbol table.  For such
+             a section, this member gives the size in bytes for each entry.  This member  contains
+             zero if the section does not hold a table of fixed-size entries.
 
+    */
+    fprintf(out, "%016lx ", section_table[i].sh_entsize);
+
+    /*
+    * sh_flags: Sections support one-bit flags that describe miscellaneous attributes.  If a flag bit
+    *           is set in sh_flags, the attribute is "on" for the section.  Otherwise, the  attribute
+    *           is "off" or does not apply.  Undefined attributes are set to zero.
+    */
+    fprintf(out, "%5s  ", section_rows_[i].flags);
+    fprintf(out, "%4d  ", section_table[i].sh_link);
+    fprintf(out, "%4d  ", section_table[i].sh_info);
+    fprintf(out, "%4lu\n", section_table[i].sh_addralign);
 }
 
-void ELF_reader::show_symbols() const
+void ELF_reader::show_symbols(std::FILE *out) const
 {
-    const Elf64_Ehdr *file_header;
-    const Elf64_Shdr *section_table;
-    const Elf64_Sym  *symbol_table;
-    const char *symbol_string_table;
-    const char *section_string_table;
-    Elf64_Xword section_number;
-    std::size_t symbol_entry_number;
+    show_symbols(Symbol_filter(), out);
+}
 
-    file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
-    section_table = reinterpret_cast<Elf64_Shdr *>(mmap_program_ + file_header->e_shoff);
-    section_string_table = reinterpret_cast<char *>(mmap_program_ + section_table[file_header->e_shstrndx].sh_offset);
-    section_number = reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_size;
-    if (section_number == 0)
+void ELF_reader::show_symbols(const Symbol_filter& filter, std::FILE *out) const
+{
+    for (std::size_t i = 0, section_count = section_number(); i < section_count; ++i)
     {
-        section_number = file_header->e_shnum;
+        show_symbol_table(i, filter, out);
     }
+}
 
-    for (decltype(section_number) i = 0; i < section_number; ++i)
-    {
-        if (section_table[i].sh_type == SHT_SYMTAB || section_table[i].sh_type == SHT_DYNSYM)
-        {
-            symbol_table = reinterpret_cast<Elf64_Sym *>(&mmap_program_[section_table[i].sh_offset]);
-            symbol_entry_number = section_table[i].sh_size / section_table[i].sh_entsize;
-            symbol_string_table = reinterpret_cast<char *>(&mmap_program_[section_table[i+1].sh_offset]);
-
-            printf("\nSymbol table '%s' contain %lu %s:\n", &section_string_table[section_table[i].sh_name],
-                   symbol_entry_number, symbol_entry_number == 0 ? "entry" : "entries");
-            printf("   Num:    Value          Size Type    Bind   Vis      Ndx Name\n");
-            for (decltype(symbol_entry_number) i = 0; i < symbol_entry_number; ++i)
-            {
-                printf("%6lu: %016lx %5lu ", i, symbol_table[i].st_value, symbol_table[i].st_size);
-                switch (ELF64_ST_TYPE(symbol_table[i].st_info))
-                {
-                case STT_NOTYPE:
-                    printf("NOTYPE  ");
-                    break;
-                case STT_OBJECT:
-                    printf("OBJECT  ");
-                    break;
-                case STT_FUNC:
-                    printf("FUNC    ");
-                    break;
-                case STT_SECTION:
-                    printf("SECTION ");
-                    break;
-                case STT_FILE:
-                    printf("FILE    ");
-                    break;
-                case STT_COMMON:
-                    printf("COMMON  ");
-                    break;
-                case STT_TLS:
-                    printf("TLS     ");
-                    break;
-                default:
-                    printf("Unknown ");
-                    break;
-                }
+// Print symbol table section_index; other sections are ignored.
+void ELF_reader::show_symbol_table(std::size_t section_index, const Symbol_filter& filter, std::FILE *out) const
+{
+    const Elf64_Shdr *section;
+    const Elf64_Sym  *symbol_table;
+    std::size_t symbol_entry_number;
 
-                switch (ELF64_ST_BIND(symbol_table[i].st_info))
-                {
-                case STB_LOCAL:
-                    printf("LOCAL  ");
-                    break;
-                case STB_GLOBAL:
-                    printf("GLOBAL ");
-                    break;
-                case STB_WEAK:
-                    printf("WEAK   ");
-                    break;
-                default:
-                    printf("Unknown");
-                }
+    section = section_header(section_index);
+    if (section == nullptr || (section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM) ||
+        section->sh_entsize == 0)
+    {
+        return;
+    }
 
-                switch (ELF64_ST_VISIBILITY(symbol_table[i].st_other))
-                {
-                case STV_DEFAULT:
-                    printf("DEFAULT  ");
-                    break;
-                case STV_INTERNAL:
-                    printf("INTERNAL ");
-                    break;
-                case STV_HIDDEN:
-                    printf("HIDDEN   ");
-                    break;
-                case STV_PROTECTED:
-                    printf("PROTECTED");
-                    break;
-                default:
-                    printf("Unknown  ");
-                    break;
-                }
+    symbol_table = reinterpret_cast<const Elf64_Sym *>(section_data(section_index));
+    symbol_entry_number = section->sh_size / section->sh_entsize;
 
-                switch (symbol_table[i].st_shndx)
-                {
-                case SHN_ABS:
-                    printf("ABS ");
-                    break;
-                case SHN_COMMON:
-                    printf("COM ");
-                    break;
-                case SHN_UNDEF:
-                    printf("UND ");
-                    break;
-                default:
-                    printf("%3d ", symbol_table[i].st_shndx);
-                    break;
-                }
+    fprintf(out, "\nSymbol table '%s' contains %lu %s:\n", section_name(section_index),
+            symbol_entry_number, symbol_entry_number == 1 ? "entry" : "entries");
 
-                printf("%.25s\n", &symbol_string_table[symbol_table[i].st_name]);
-            }
+    if (filter.empty())
+    {
+        fprintf(out, "   Num:    Value          Size Type    Bind   Vis      Ndx Name\n");
+        for (std::size_t j = 0; j < symbol_entry_number; ++j)
+        {
+            print_symbol(out, j, symbol_table[j], section->sh_link);
         }
+        return;
+    }
+
+    std::vector<std::uint32_t> indices = select_symbols(section_index, filter);
+    fprintf(out, "%lu of them match the filter:\n", indices.size());
+    fprintf(out, "   Num:    Value          Size Type    Bind   Vis      Ndx Name\n");
+    for (std::uint32_t index : indices)
+    {
+        print_symbol(out, index, symbol_table[index], section->sh_link);
     }
 }
 
-void ELF_reader::load_memory_map()
+std::vector<std::uint32_t> ELF_reader::select_symbols(std::size_t section_index, const Symbol_filter& filter) const
 {
-    void *mmap_res;
-    struct stat st;
+    std::vector<std::uint32_t> indices;
+    const Elf64_Shdr *section = section_header(section_index);
+    Symbol_predicate predicate;
 
-    if ((fd_ = open(file_path_.c_str(), O_RDONLY)) == -1)
+    if (section == nullptr || (section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM) ||
+        section->sh_entsize == 0)
     {
-        ERROR_EXIT("open");
+        return indices;
     }
 
-    if (fstat(fd_, &st) == -1)
+    predicate.type_mask = filter.type_mask;
+    predicate.bind_mask = filter.bind_mask;
+    predicate.any_section = filter.section.empty();
+    predicate.section_index = SHN_UNDEF;
+    predicate.address_low = filter.address_low;
+    predicate.address_span = filter.address_high - filter.address_low;
+    if (!predicate.any_section && !resolve_section(filter.section, predicate.section_index))
     {
-        ERROR_EXIT("fstat");
+        return indices;
     }
 
-    program_length_ = static_cast<std::size_t>(st.st_size);
+    const Elf64_Sym *symbol_table = reinterpret_cast<const Elf64_Sym *>(section_data(section_index));
+    std::size_t symbol_entry_number = section->sh_size / section->sh_entsize;
 
-    mmap_res = ::mmap(nullptr, program_length_, PROT_READ, MAP_PRIVATE, fd_, 0);
-    if (mmap_res == MAP_FAILED)
+    indices.resize(symbol_entry_number);
+    indices.resize(scan_symbols(symbol_table, symbol_entry_number, predicate, indices.data()));
+
+    // Names are only looked at for the symbols that survived the fixed-field checks.  Without
+    // string table data every name reads as empty, and is matched as such.
+    const char *symbol_string_table = reinterpret_cast<const char *>(section_data(section->sh_link));
+    if (filter.name_pattern.empty())
     {
-        ERROR_EXIT("mmap");
+        return indices;
     }
 
-    mmap_program_ = static_cast<std::uint8_t *>(mmap_res);
+    Name_matcher match(filter.name_pattern);
+    std::string prefix = match.prefix();
+    std::size_t string_table_size = section_header(section->sh_link)->sh_size;
+
+    /*
+    * When many symbols are left, one sequential vector scan of the string table for the
+    * literal prefix is cheaper than a random access per symbol; the prefix test then becomes
+    * a bit lookup and only names that pass it are read.
+    */
+    if (!prefix.empty() && symbol_string_table != nullptr && indices.size() * PREFIX_SCAN_RATIO >= string_table_size)
+    {
+        std::vector<std::uint64_t> starts((string_table_size + 63) / 64, 0);
+        mark_prefix(symbol_string_table, symbol_string_table + string_table_size,
+                    prefix.data(), prefix.size(), starts.data());
+        indices.erase(std::remove_if(indices.begin(), indices.end(),
+            [&](std::uint32_t index) {
+                Elf64_Word name = symbol_table[index].st_name;
+                return name >= string_table_size || !(starts[name >> 6] >> (name & 63) & 1) ||
+                       !match.match_rest(string_at(section->sh_link, name));
+            }),
+            indices.end());
+        return indices;
+    }
+
+    indices.erase(std::remove_if(indices.begin(), indices.end(),
+        [&](std::uint32_t index) { return !match(string_at(section->sh_link, symbol_table[index].st_name)); }),
+        indices.end());
+    return indices;
 }
 
-void ELF_reader::close_memory_map()
+void ELF_reader::show_symbol_histogram(std::FILE *out) const
 {
-    if (fd_ == -1)
+    const Elf64_Shdr *section;
+    const Elf64_Shdr *string_section;
+    std::size_t symbol_entry_number;
+
+    if (mmap_program_ == nullptr)
     {
         return;
     }
 
-    if (::munmap(static_cast<void *>(mmap_program_), program_length_) == -1)
+    for (std::size_t i = 0, section_count = section_number(); i < section_count; ++i)
     {
-        ERROR_EXIT("munmap");
+        section = section_header(i);
+        if ((section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM) || section->sh_entsize == 0)
+        {
+            continue;
+        }
+
+        Symbol_histogram histogram;
+        symbol_entry_number = section->sh_size / section->sh_entsize;
+        histogram_symbols(reinterpret_cast<const Elf64_Sym *>(section_data(i)), symbol_entry_number, histogram);
+
+        fprintf(out, "\nHistogram of symbol table '%s' (%lu entries", section_name(i), symbol_entry_number);
+        string_section = section_header(section->sh_link);
+        if (string_section != nullptr && string_section->sh_type == SHT_STRTAB)
+        {
+            const char *strings = reinterpret_cast<const char *>(section_data(section->sh_link));
+            fprintf(out, ", %lu strings in '%s'", count_strings(strings, strings + string_section->sh_size),
+                    section_name(section->sh_link));
+        }
+        fprintf(out, "):\n");
+
+        fprintf(out, "  Type      Count\n");
+        for (unsigned type = 0; type < 16; ++type)
+        {
+            if (histogram.type[type] != 0)
+            {
+                fprintf(out, "  %-8s %6lu\n", symbol_type_name(type), histogram.type[type]);
+            }
+        }
+
+        fprintf(out, "  Bind      Count\n");
+        for (unsigned bind = 0; bind < 16; ++bind)
+        {
+            if (histogram.bind[bind] != 0)
+            {
+                fprintf(out, "  %-8s %6lu\n", symbol_bind_name(bind), histogram.bind[bind]);
+            }
+        }
+
+        fprintf(out, "  Ndx Section            Count\n");
+        for (std::size_t ndx = 0; ndx < histogram.section.size(); ++ndx)
+        {
+            if (histogram.section[ndx] == 0)
+            {
+                continue;
+            }
+            switch (ndx)
+            {
+            case SHN_UNDEF:
+                fprintf(out, "  UND %-16.16s", "");
+                break;
+            case SHN_ABS:
+                fprintf(out, "  ABS %-16.16s", "");
+                break;
+            case SHN_COMMON:
+                fprintf(out, "  COM %-16.16s", "");
+                break;
+            default:
+                fprintf(out, "  %3lu %-16.16s", ndx, section_name(ndx));
+                break;
+            }
+            fprintf(out, " %7lu\n", histogram.section[ndx]);
+        }
     }
+}
 
-    if (::close(fd_) == -1)
+void ELF_reader::print_symbol(std::FILE *out, std::size_t index, const Elf64_Sym& symbol,
+                              std::size_t string_section) const
+{
+    fprintf(out, "%6lu: %016lx %5lu ", index, symbol.st_value, symbol.st_size);
+    switch (ELF64_ST_TYPE(symbol.st_info))
     {
-        ERROR_EXIT("close");
-    }
+    case STT_NOTYPE:
+        fprintf(out, "NOTYPE  ");
+        break;
+    case STT_OBJECT:
+        fprintf(out, "OBJECT  ");
+        break;
+    case STT_FUNC:
+        fprintf(out, "FUNC    ");
+        break;
+    case STT_SECTION:
+        fprintf(out, "SECTION ");
+        break;
+    case STT_FILE:
+        fprintf(out, "FILE    ");
+        break;
+    case STT_COMMON:
+        fprintf(out, "COMMON  ");
+        break;
+    case STT_TLS:
+        fprintf(out, "TLS     ");
+        break;
+    case STT_GNU_IFUNC:
+        fprintf(out, "IFUNC   ");
+        break;
+    default:
+        fprintf(out, "Unknown ");
+        break;
+    }
+
+    switch (ELF64_ST_BIND(symbol.st_info))
+    {
+    case STB_LOCAL:
+        fprintf(out, "LOCAL  ");
+        break;
+    case STB_GLOBAL:
+        fprintf(out, "GLOBAL ");
+        break;
+    case STB_WEAK:
+        fprintf(out, "WEAK   ");
+        break;
+    case STB_GNU_UNIQUE:
+        fprintf(out, "UNIQUE ");
+        break;
+    default:
+        fprintf(out, "Unknown ");
+    }
+
+    switch (ELF64_ST_VISIBILITY(symbol.st_other))
+    {
+    case STV_DEFAULT:
+        fprintf(out, "DEFAULT  ");
+        break;
+    case STV_INTERNAL:
+        fprintf(out, "INTERNAL ");
+        break;
+    case STV_HIDDEN:
+        fprintf(out, "HIDDEN   ");
+        break;
+    case STV_PROTECTED:
+        fprintf(out, "PROTECTED");
+        break;
+    default:
+        fprintf(out, "Unknown  ");
+        break;
+    }
+
+    switch (symbol.st_shndx)
+    {
+    case SHN_ABS:
+        fprintf(out, "ABS ");
+        break;
+    case SHN_COMMON:
+        fprintf(out, "COM ");
+        break;
+    case SHN_UNDEF:
+        fprintf(out, "UND ");
+        break;
+    default:
+        fprintf(out, "%3d ", symbol.st_shndx);
+        break;
+    }
+
+    std::size_t length;
+    const char *name = string_at(string_section, symbol.st_name, length);
+    fwrite(name, 1, std::min(length, SYMBOL_NAME_WIDTH), out);
+    fputc('\n', out);
+}
+
+/*
+* Attribute the bytes of the file to sections, symbols and source files.
+*
+* The section table and one symbol table (.symtab if present, else .dynsym) are each read
+* once, front to back.  Memory stays bounded by the number of sections, top_number and the
+* number of STT_FILE entries: the largest symbols are kept in a min-heap of top_number
+* entries instead of sorting the table.  Local symbols are charged to the STT_FILE entry
+* that precedes them; global symbols carry no file and are reported together.  Aliases
+* (several symbols over the same bytes) are each counted.
+*/
+void ELF_reader::show_size_report(std::size_t top_number, std::FILE *out) const
+{
+    typedef std::pair<Elf64_Xword, std::uint32_t> Sized_symbol;    // st_size, index
+
+    struct File_size
+    {
+        Elf64_Xword bytes;
+        std::size_t symbols;
+    };
+
+    struct Name_less
+    {
+        bool operator()(const char *a, const char *b) const { return std::strcmp(a, b) < 0; }
+    };
+
+    // Keyed by the names in the string table itself; the nodes come from a local arena.
+    typedef std::map<const char *, File_size, Name_less,
+                     Arena_allocator<std::pair<const char *const, File_size>>> File_map;
+
+    if (mmap_program_ == nullptr)
+    {
+        return;
+    }
+
+    std::size_t section_count = section_number();
+    std::size_t symbol_section = SHN_UNDEF;
+    for (std::size_t i = 1; i < section_count; ++i)
+    {
+        const Elf64_Shdr *section = section_header(i);
+        if (section->sh_entsize != 0 &&
+            (section->sh_type == SHT_SYMTAB || (section->sh_type == SHT_DYNSYM && symbol_section == SHN_UNDEF)))
+        {
+            symbol_section = i;
+        }
+    }
+
+    std::vector<Elf64_Xword> section_symbol_bytes(section_count, 0);
+    std::vector<std::size_t> section_symbols(section_count, 0);
+    std::vector<Sized_symbol> largest;
+    Arena arena;
+    File_map files{Name_less(), File_map::allocator_type(arena)};
+    std::size_t symbol_string_section = SHN_UNDEF;
+    const Elf64_Sym *symbol_table = nullptr;
+    std::size_t symbol_entry_number = 0;
+
+    if (symbol_section != SHN_UNDEF)
+    {
+        const Elf64_Shdr *section = section_header(symbol_section);
+        symbol_table = reinterpret_cast<const Elf64_Sym *>(section_data(symbol_section));
+        symbol_entry_number = section->sh_size / section->sh_entsize;
+        largest.reserve(std::min(top_number, symbol_entry_number));
+        symbol_string_section = section->sh_link;
+
+        File_size *current_file = nullptr;
+        File_size *global_file = &files["(global symbols)"];
+        for (std::size_t i = 0; i < symbol_entry_number; ++i)
+        {
+            const Elf64_Sym& symbol = symbol_table[i];
+            unsigned type = ELF64_ST_TYPE(symbol.st_info);
+
+            if (type == STT_FILE)
+            {
+                current_file = &files[string_at(symbol_string_section, symbol.st_name)];
+                continue;
+            }
+            if (type == STT_SECTION || symbol.st_size == 0 || symbol.st_shndx == SHN_UNDEF ||
+                symbol.st_shndx >= section_count)
+            {
+                continue;
+            }
+
+            section_symbol_bytes[symbol.st_shndx] += symbol.st_size;
+            ++section_symbols[symbol.st_shndx];
+
+            File_size *file = ELF64_ST_BIND(symbol.st_info) == STB_LOCAL && current_file != nullptr ?
+                              current_file : global_file;
+            file->bytes += symbol.st_size;
+            ++file->symbols;
+
+            if (top_number == 0)
+            {
+                continue;
+            }
+            if (largest.size() < top_number)
+            {
+                largest.emplace_back(symbol.st_size, static_cast<std::uint32_t>(i));
+                std::push_heap(largest.begin(), largest.end(), std::greater<Sized_symbol>());
+            }
+            else if (symbol.st_size > largest.front().first)
+            {
+                std::pop_heap(largest.begin(), largest.end(), std::greater<Sized_symbol>());
+                largest.back() = Sized_symbol(symbol.st_size, static_cast<std::uint32_t>(i));
+                std::push_heap(largest.begin(), largest.end(), std::greater<Sized_symbol>());
+            }
+        }
+    }
+
+    fprintf(out, "Size report for %s (%lu bytes):\n\n", file_path_.c_str(), program_length_);
+    fprintf(out, "  [Nr] Name                   File size   Memory size  Symbol bytes  Symbols    %%File\n");
+    Elf64_Xword file_bytes = 0, memory_bytes = 0;
+    for (std::size_t i = 1; i < section_count; ++i)
+    {
+        const Elf64_Shdr *section = section_header(i);
+        Elf64_Xword in_file = section->sh_type == SHT_NOBITS ? 0 : section->sh_size;
+        Elf64_Xword in_memory = section->sh_flags & SHF_ALLOC ? section->sh_size : 0;
+        file_bytes += in_file;
+        memory_bytes += in_memory;
+        fprintf(out, "  [%2lu] %-20.20s %11lu  %12lu  %12lu  %7lu  %6.2f%%\n", i, section_name(i),
+                in_file, in_memory, section_symbol_bytes[i], section_symbols[i],
+                program_length_ == 0 ? 0.0 : 100.0 * static_cast<double>(in_file) / static_cast<double>(program_length_));
+    }
+    fprintf(out, "       %-20s %11lu  %12lu\n", "Total", file_bytes, memory_bytes);
+    fprintf(out, "       %-20s %11lu\n", "Headers and padding",
+            program_length_ > file_bytes ? program_length_ - file_bytes : 0);
+
+    if (symbol_section == SHN_UNDEF)
+    {
+        fprintf(out, "\nThere is no symbol table in this file.\n");
+        return;
+    }
+
+    std::sort_heap(largest.begin(), largest.end(), std::greater<Sized_symbol>());
+    fprintf(out, "\nTop %lu symbols by size in '%s':\n", largest.size(), section_name(symbol_section));
+    fprintf(out, "   Num:       Size Type    Bind   Ndx Section          Name\n");
+    for (const Sized_symbol& entry : largest)
+    {
+        const Elf64_Sym& symbol = symbol_table[entry.second];
+        fprintf(out, "%6u: %10lu %-7s %-6s %3u %-16.16s %s\n", entry.second, symbol.st_size,
+                symbol_type_name(ELF64_ST_TYPE(symbol.st_info)), symbol_bind_name(ELF64_ST_BIND(symbol.st_info)),
+                symbol.st_shndx, section_name(symbol.st_shndx), string_at(symbol_string_section, symbol.st_name));
+    }
+
+    std::vector<std::pair<const char *, const File_size *>> by_size;
+    by_size.reserve(files.size());
+    for (const auto& file : files)
+    {
+        if (file.second.symbols != 0)
+        {
+            by_size.emplace_back(file.first, &file.second);
+        }
+    }
+    std::sort(by_size.begin(), by_size.end(), [](const std::pair<const char *, const File_size *>& a,
+                                                 const std::pair<const char *, const File_size *>& b) {
+        return a.second->bytes != b.second->bytes ? a.second->bytes > b.second->bytes :
+                                                    std::strcmp(a.first, b.first) < 0;
+    });
+
+    fprintf(out, "\nSymbol bytes per source file (STT_FILE):\n");
+    fprintf(out, "         Bytes  Symbols  File\n");
+    for (const auto& file : by_size)
+    {
+        fprintf(out, "  %12lu  %7lu  %s\n", file.second->bytes, file.second->symbols,
+                *file.first == '\0' ? "(unnamed)" : file.first);
+    }
+}
+
+const Elf64_Ehdr *ELF_reader::file_header() const
+{
+    return reinterpret_cast<const Elf64_Ehdr *>(mmap_program_);
+}
+
+std::size_t ELF_reader::section_number() const
+{
+    const Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
+
+    if (mmap_program_ == nullptr || file_header->e_shoff == 0)
+    {
+        return 0;
+    }
+
+    Elf64_Xword section_number = reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_size;
+    return section_number == 0 ? file_header->e_shnum : section_number;
+}
+
+const Elf64_Shdr *ELF_reader::section_header(std::size_t index) const
+{
+    if (index >= section_number())
+    {
+        return nullptr;
+    }
+    const Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
+    return reinterpret_cast<Elf64_Shdr *>(mmap_program_ + file_header->e_shoff) + index;
+}
+
+const char *ELF_reader::section_name(std::size_t index) const
+{
+    const Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
+    const Elf64_Shdr *section = section_header(index);
+
+    if (section == nullptr)
+    {
+        return "";
+    }
+
+    std::size_t section_string_table_index = file_header->e_shstrndx == SHN_XINDEX ?
+        section_header(0)->sh_link : file_header->e_shstrndx;
+    return string_at(section_string_table_index, section->sh_name);
+}
+
+const char *ELF_reader::string_at(std::size_t section_index, std::size_t offset) const
+{
+    std::size_t length;
+    return string_at(section_index, offset, length);
+}
+
+const char *ELF_reader::string_at(std::size_t section_index, std::size_t offset, std::size_t& length) const
+{
+    const char *strings = reinterpret_cast<const char *>(section_data(section_index));
+    length = 0;
+    if (strings == nullptr || offset >= section_header(section_index)->sh_size)
+    {
+        return "";
+    }
+
+    const char *end = strings + section_header(section_index)->sh_size;
+    const char *terminator = find_terminator(strings + offset, end);
+    if (terminator == end)
+    {
+        return "";
+    }
+    length = static_cast<std::size_t>(terminator - (strings + offset));
+    return strings + offset;
+}
+
+// The contents of a section, or nullptr if it has none in the file.
+const std::uint8_t *ELF_reader::section_data(std::size_t index) const
+{
+    const Elf64_Shdr *section = section_header(index);
+
+    if (section == nullptr || section->sh_type == SHT_NOBITS || index == SHN_UNDEF)
+    {
+        return nullptr;
+    }
+    return mmap_program_ + section->sh_offset;
+}
+
+// The index of the first section called name, or SHN_UNDEF if there is none.
+std::size_t ELF_reader::find_section(const std::string& name) const
+{
+    for (std::size_t i = 1, section_count = section_number(); i < section_count; ++i)
+    {
+        if (name == section_name(i))
+        {
+            return i;
+        }
+    }
+    return SHN_UNDEF;
+}
+
+bool ELF_reader::lookup_section(const std::string& section, std::size_t& index) const
+{
+    char *end;
+    unsigned long number = std::strtoul(section.c_str(), &end, 10);
+    if (!section.empty() && *end == '\0')
+    {
+        index = number;
+        return number < section_number();
+    }
+
+    index = find_section(section);
+    return index != SHN_UNDEF;
+}
+
+/*
+* Turn the section criterion of a Symbol_filter into the st_shndx value it selects: the
+* pseudo sections UND, ABS and COM, a decimal section index, or a section name.
+*/
+bool ELF_reader::resolve_section(const std::string& section, std::uint16_t& index) const
+{
+    if (section == "UND")
+    {
+        index = SHN_UNDEF;
+        return true;
+    }
+    if (section == "ABS")
+    {
+        index = SHN_ABS;
+        return true;
+    }
+    if (section == "COM")
+    {
+        index = SHN_COMMON;
+        return true;
+    }
+
+    char *end;
+    unsigned long number = std::strtoul(section.c_str(), &end, 10);
+    if (!section.empty() && *end == '\0')
+    {
+        if (number >= SHN_LORESERVE)
+        {
+            return false;
+        }
+        index = static_cast<std::uint16_t>(number);
+        return true;
+    }
+
+    std::size_t found = find_section(section);
+    if (found == SHN_UNDEF || found >= SHN_LORESERVE)
+    {
+        return false;
+    }
+    index = static_cast<std::uint16_t>(found);
+    return true;
+}
+
+void ELF_reader::show_build_id(std::FILE *out) const
+{
+    if (mmap_program_ == nullptr)
+    {
+        return;
+    }
+
+    const Elf64_Ehdr *file_header;
+    const Elf64_Shdr *section_table;
+    Elf64_Xword section_number;
+
+    file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
+    if (file_header->e_shoff == 0)
+    {
+        return;
+    }
+    section_table = reinterpret_cast<Elf64_Shdr *>(mmap_program_ + file_header->e_shoff);
+    section_number = reinterpret_cast<Elf64_Shdr *>(&mmap_program_[file_header->e_shoff])->sh_size;
+    if (section_number == 0)
+    {
+        section_number = file_header->e_shnum;
+    }
+
+    for (decltype(section_number) i = 0; i < section_number; ++i)
+    {
+        if (section_table[i].sh_type != SHT_NOTE)
+        {
+            continue;
+        }
+
+        /*
+        * A note section is a sequence of Elf64_Nhdr entries.  Each header is followed by the
+        * owner name and the descriptor, both padded to a 4-byte boundary.
+        */
+        const std::uint8_t *note = &mmap_program_[section_table[i].sh_offset];
+        const std::uint8_t *note_end = note + section_table[i].sh_size;
+        while (note + sizeof(Elf64_Nhdr) <= note_end)
+        {
+            const Elf64_Nhdr *note_header = reinterpret_cast<const Elf64_Nhdr *>(note);
+            const char *name = reinterpret_cast<const char *>(note + sizeof(Elf64_Nhdr));
+            const std::uint8_t *desc = note + sizeof(Elf64_Nhdr) + ((note_header->n_namesz + 3) & ~3u);
+
+            if (note_header->n_type == NT_GNU_BUILD_ID && note_header->n_namesz == sizeof(ELF_NOTE_GNU) &&
+                std::memcmp(name, ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)) == 0 &&
+                desc + note_header->n_descsz <= note_end)
+            {
+                fprintf(out, "Build ID: ");
+                for (Elf64_Word j = 0; j < note_header->n_descsz; ++j)
+                {
+                    fprintf(out, "%02x", desc[j]);
+                }
+                fprintf(out, "\n");
+                return;
+            }
+            note = desc + ((note_header->n_descsz + 3) & ~3u);
+        }
+    }
+    fprintf(out, "There is no build ID in this file.\n");
+}
+
+/*
+* Lines are formatted DUMP_BATCH_LINES at a time into one buffer: the addresses in place,
+* the bytes by format_hex_lines(), so that a section of hundreds of megabytes costs a write
+* per batch rather than a printf per byte.
+*/
+void ELF_reader::show_hex_dump(std::size_t section_index, std::uint64_t start, std::uint64_t length,
+                               std::FILE *out) const
+{
+    const Elf64_Shdr *section = section_header(section_index);
+    const std::uint8_t *data = section_data(section_index);
+
+    if (section == nullptr)
+    {
+        return;
+    }
+    if (data == nullptr || section->sh_size == 0)
+    {
+        fprintf(out, "Section '%s' has no data to dump.\n", section_name(section_index));
+        return;
+    }
+
+    start = std::min<std::uint64_t>(start, section->sh_size);
+    length = std::min<std::uint64_t>(length, section->sh_size - start);
+    data += start;
+
+    fprintf(out, "\nHex dump of section '%s':\n", section_name(section_index));
+
+    std::vector<char> buffer(DUMP_BATCH_LINES * DUMP_LINE_SPACE);
+    std::uint64_t address = section->sh_addr + start;
+    std::uint64_t full_lines = length / HEX_LINE_BYTES;
+
+    for (std::uint64_t line = 0; line < full_lines; )
+    {
+        std::size_t batch = static_cast<std::size_t>(std::min<std::uint64_t>(full_lines - line, DUMP_BATCH_LINES));
+        char *p = buffer.data();
+
+        // A batch never crosses into a longer address, so every line in it has the same layout.
+        std::size_t digits = address_digits(address);
+        if (digits < 16)
+        {
+            std::uint64_t boundary = std::uint64_t(1) << (4 * digits);
+            batch = static_cast<std::size_t>(
+                std::min<std::uint64_t>(batch, (boundary - address + HEX_LINE_BYTES - 1) / HEX_LINE_BYTES));
+        }
+        std::size_t stride = 4 + digits + 1 + HEX_LINE_LENGTH + 1;
+
+        for (std::size_t i = 0; i < batch; ++i, address += HEX_LINE_BYTES)
+        {
+            char *q = p + i * stride;
+            q[0] = q[1] = ' ';
+            q[2] = '0';
+            q[3] = 'x';
+            format_address(q + 4, address, digits);
+            q[4 + digits] = ' ';
+            q[stride - 1] = '\n';
+        }
+        format_hex_lines(data + line * HEX_LINE_BYTES, batch, p + 4 + digits + 1, stride);
+        fwrite(p, 1, batch * stride, out);
+        line += batch;
+    }
+
+    std::size_t rest = static_cast<std::size_t>(length % HEX_LINE_BYTES);
+    if (rest != 0)
+    {
+        std::uint8_t last[HEX_LINE_BYTES] = {0};
+        char text[HEX_LINE_LENGTH];
+        std::memcpy(last, data + full_lines * HEX_LINE_BYTES, rest);
+        format_hex_lines(last, 1, text, HEX_LINE_LENGTH);
+
+        // Blank the digits of the missing bytes and keep the text of the present ones.
+        for (std::size_t j = rest; j < HEX_LINE_BYTES; ++j)
+        {
+            text[j / 4 * 9 + j % 4 * 2] = text[j / 4 * 9 + j % 4 * 2 + 1] = ' ';
+        }
+        char line[DUMP_LINE_SPACE];
+        char *p = line;
+        *p++ = ' ';
+        *p++ = ' ';
+        *p++ = '0';
+        *p++ = 'x';
+        p = format_address(p, address, address_digits(address));
+        *p++ = ' ';
+        std::memcpy(p, text, HEX_TEXT_OFFSET + rest);
+        p += HEX_TEXT_OFFSET + rest;
+        *p++ = '\n';
+        fwrite(line, 1, static_cast<std::size_t>(p - line), out);
+    }
+    fprintf(out, "\n");
+}
+
+/*
+* Every maximal run of printable characters is one string, shown with its offset in the
+* section.  Runs are found with printable_run_end(), which tests 16 or 32 bytes at a time,
+* and written in batches like the hex dump.
+*/
+void ELF_reader::show_string_dump(std::size_t section_index, std::uint64_t start, std::uint64_t length,
+                                  std::FILE *out) const
+{
+    const Elf64_Shdr *section = section_header(section_index);
+    const char *data = reinterpret_cast<const char *>(section_data(section_index));
+
+    if (section == nullptr)
+    {
+        return;
+    }
+    if (data == nullptr || section->sh_size == 0)
+    {
+        fprintf(out, "Section '%s' has no data to dump.\n", section_name(section_index));
+        return;
+    }
+
+    start = std::min<std::uint64_t>(start, section->sh_size);
+    length = std::min<std::uint64_t>(length, section->sh_size - start);
+
+    fprintf(out, "\nString dump of section '%s':\n", section_name(section_index));
+
+    // Short runs are gathered in one buffer; a run too long for it is written on its own.
+    std::vector<char> buffer(DUMP_BATCH_LINES * DUMP_LINE_SPACE);
+    char *q = buffer.data();
+    char *buffer_end = buffer.data() + buffer.size();
+    const char *end = data + start + length;
+
+    for (const char *p = printable_run_end(data + start, end, false); p != end; )
+    {
+        const char *run_end = printable_run_end(p, end, true);
+        std::size_t run_length = static_cast<std::size_t>(run_end - p);
+        std::uint64_t offset = static_cast<std::uint64_t>(p - data);
+
+        // "  [", the offset right aligned in six columns or more, "]  ", the run and a newline.
+        std::size_t digits = 1;
+        while (digits < 16 && (offset >> (4 * digits)) != 0)
+        {
+            ++digits;
+        }
+        std::size_t pad = digits < 6 ? 6 - digits : 0;
+        if (static_cast<std::size_t>(buffer_end - q) < 3 + pad + digits + 3 + run_length + 1)
+        {
+            fwrite(buffer.data(), 1, static_cast<std::size_t>(q - buffer.data()), out);
+            q = buffer.data();
+        }
+
+        *q++ = ' ';
+        *q++ = ' ';
+        *q++ = '[';
+        q = std::fill_n(q, pad, ' ');
+        q = format_address(q, offset, digits);
+        *q++ = ']';
+        *q++ = ' ';
+        *q++ = ' ';
+        if (static_cast<std::size_t>(buffer_end - q) < run_length + 1)
+        {
+            fwrite(buffer.data(), 1, static_cast<std::size_t>(q - buffer.data()), out);
+            fwrite(p, 1, run_length, out);
+            q = buffer.data();
+        }
+        else
+        {
+            q = std::copy(p, run_end, q);
+        }
+        *q++ = '\n';
+
+        p = printable_run_end(run_end, end, false);
+    }
+    fwrite(buffer.data(), 1, static_cast<std::size_t>(q - buffer.data()), out);
+    fprintf(out, "\n");
+}
+
+std::error_code ELF_reader::load_memory_map()
+{
+    void *mmap_res;
+    struct stat st;
+    std::error_code error;
+
+    if ((fd_ = open(file_path_.c_str(), O_RDONLY | O_CLOEXEC)) == -1)
+    {
+        error.assign(errno, std::system_category());
+        initialize_members(std::move(file_path_));
+        return error;
+    }
+
+    if (fstat(fd_, &st) == -1)
+    {
+        error.assign(errno, std::system_category());
+        ::close(fd_);
+        initialize_members(std::move(file_path_));
+        return error;
+    }
+
+    if (static_cast<std::size_t>(st.st_size) < sizeof(Elf64_Ehdr))
+    {
+        ::close(fd_);
+        initialize_members(std::move(file_path_));
+        return S_ISREG(st.st_mode) ? make_error_code(Error::truncated)
+                                   : std::make_error_code(std::errc::invalid_argument);
+    }
+
+    program_length_ = static_cast<std::size_t>(st.st_size);
+    device_ = st.st_dev;
+    inode_ = st.st_ino;
+    modify_time_ = st.st_mtim;
+
+    mmap_res = ::mmap(nullptr, program_length_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mmap_res == MAP_FAILED)
+    {
+        error.assign(errno, std::system_category());
+        ::close(fd_);
+        initialize_members(std::move(file_path_));
+        return error;
+    }
+
+    mmap_program_ = static_cast<std::uint8_t *>(mmap_res);
+
+    if ((error = check_headers()))
+    {
+        close_memory_map();
+    }
+    else
+    {
+        decode_sections();
+    }
+    return error;
+}
+
+/*
+* Reject files the show_* functions cannot walk safely: they index the mapping with the
+* header fields directly, so every table they touch must lie inside the file.
+*/
+std::error_code ELF_reader::check_headers() const
+{
+    const Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(mmap_program_);
+
+    if (file_header->e_ident[EI_MAG0] != ELFMAG0 || file_header->e_ident[EI_MAG1] != ELFMAG1 ||
+        file_header->e_ident[EI_MAG2] != ELFMAG2 || file_header->e_ident[EI_MAG3] != ELFMAG3)
+    {
+        return Error::not_elf;
+    }
+
+    if (file_header->e_ident[EI_CLASS] != ELFCLASS64)
+    {
+        return Error::unsupported_class;
+    }
+
+    if (file_header->e_shoff == 0)
+    {
+        return std::error_code();
+    }
+
+    if (file_header->e_shoff > program_length_ ||
+        program_length_ - file_header->e_shoff < sizeof(Elf64_Shdr))
+    {
+        return Error::truncated;
+    }
+
+    const Elf64_Shdr *section_table = reinterpret_cast<Elf64_Shdr *>(mmap_program_ + file_header->e_shoff);
+    Elf64_Xword section_number = section_table[0].sh_size == 0 ? file_header->e_shnum : section_table[0].sh_size;
+    if (section_number > (program_length_ - file_header->e_shoff) / sizeof(Elf64_Shdr))
+    {
+        return Error::truncated;
+    }
+
+    for (Elf64_Xword i = 0; i < section_number; ++i)
+    {
+        if (section_table[i].sh_type != SHT_NOBITS &&
+            (section_table[i].sh_offset > program_length_ ||
+             section_table[i].sh_size > program_length_ - section_table[i].sh_offset))
+        {
+            return Error::truncated;
+        }
+    }
+
+    // Symbols are read as an array of Elf64_Sym and their names from the linked table; section 0
+    // has no data, whatever its header says.
+    for (Elf64_Xword i = 0; i < section_number; ++i)
+    {
+        if ((section_table[i].sh_type == SHT_SYMTAB || section_table[i].sh_type == SHT_DYNSYM) &&
+            (i == 0 || section_table[i].sh_entsize != sizeof(Elf64_Sym) || section_table[i].sh_link >= section_number ||
+             section_table[section_table[i].sh_link].sh_type != SHT_STRTAB))
+        {
+            return Error::bad_symbol_table;
+        }
+    }
+    return std::error_code();
+}
+
+void ELF_reader::decode_sections()
+{
+    std::size_t section_count = section_number();
+    Section_row *rows = arena_.allocate_array<Section_row>(section_count);
+    unsigned char osabi = file_header()->e_ident[EI_OSABI];
+    bool gnu_retain = osabi == ELFOSABI_GNU || osabi == ELFOSABI_FREEBSD;
+
+    for (std::size_t i = 0; i < section_count; ++i)
+    {
+        const Elf64_Shdr *section = section_header(i);
+        char *flag = rows[i].flags;
+
+        rows[i].type = section_type_text(section->sh_type);
+        Elf64_Xword other = section->sh_flags;
+        for (const Section_flag& entry : section_flags)
+        {
+            if (section->sh_flags & entry.flag)
+            {
+                *flag++ = entry.letter;
+                other &= ~entry.flag;
+            }
+        }
+
+        // Bits that only have a meaning for some systems, then those shown by the range they fall in.
+        if (gnu_retain && (other & SHF_GNU_RETAIN))
+        {
+            *flag++ = 'R';
+            other &= ~SHF_GNU_RETAIN;
+        }
+        if (file_header()->e_machine == EM_X86_64 && (other & SHF_X86_64_LARGE))
+        {
+            *flag++ = 'l';
+            other &= ~SHF_X86_64_LARGE;
+        }
+        if (other & SHF_MASKOS)
+            *flag++ = 'o';
+        if (other & SHF_MASKPROC)
+            *flag++ = 'p';
+        if (other & ~Elf64_Xword(SHF_MASKOS | SHF_MASKPROC))
+            *flag++ = 'x';
+        *flag = '\0';
+    }
+    section_rows_ = rows;
+}
+
+std::error_code ELF_reader::close_memory_map()
+{
+    std::error_code error;
+
+    if (mmap_program_ == nullptr)
+    {
+        return error;
+    }
+
+    if (::munmap(static_cast<void *>(mmap_program_), program_length_) == -1)
+    {
+        error.assign(errno, std::system_category());
+    }
+
+    if (fd_ != -1 && ::close(fd_) == -1 && !error)
+    {
+        error.assign(errno, std::system_category());
+    }
+
+    initialize_members(std::move(file_path_));
+    return error;
 }
 
 void ELF_reader::initialize_members(std::string file_path, int fd,
@@ -881,6 +1917,8 @@ void ELF_reader::initialize_members(std::string file_path, int fd,
     fd_ = fd;
     program_length_ = program_length;
     mmap_program_ = mmap_program;
+    arena_.reset();
+    section_rows_ = nullptr;
 }
 
 } // namespace elf_parser
\ No newline at end of file
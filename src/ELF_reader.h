@@ -2,11 +2,50 @@
 #define ELF_PARSER_H
 
 #include <cstdint>
+#include <cstdio>
 #include <string>
+#include <system_error>
+#include <vector>
+#include <elf.h>
+#include <time.h>
+#include <sys/types.h>
+#include "Arena.h"
+#include "Region_loader.h"
+#include "Sparse_image.h"
+#include "Symbol_filter.h"
 
 namespace ELF
 {
 
+/*
+* Reasons a file can be rejected besides a failing system call.  System call failures are
+* reported with std::system_category and the errno value.
+*/
+enum class Error
+{
+    not_elf = 1,
+    unsupported_class,
+    truncated,
+    bad_symbol_table,
+};
+
+const std::error_category& elf_category() noexcept;
+std::error_code make_error_code(Error error) noexcept;
+
+// Number of largest symbols show_size_report() lists when none is given, and the most it may
+// be asked for by the command line or a server request.
+const std::size_t SIZE_REPORT_TOP = 20;
+const std::size_t SIZE_REPORT_MAX_TOP = 10000;
+
+/*
+* A reader owns the read-only mapping of one file.  Loading never terminates the process: on
+* failure the reader is left empty, error() tells why, and the show_* functions print nothing.
+*
+* What is derived from the file, such as the type and flags text of every section, is decoded
+* once by the load into an arena owned by the reader, and released with it by the next load
+* or the destructor.  Const member functions only read the mapping and that model, so one
+* loaded reader may be shared by any number of threads.
+*/
 class ELF_reader
 {
 public:
@@ -18,15 +57,71 @@ public:
     ELF_reader& operator=(ELF_reader&& object) noexcept;
     ~ELF_reader();
 
-    void load_file(const std::string& file_path);
+    std::error_code load_file(const std::string& file_path);
+
+    /*
+    * Read a file from fd, which may be a pipe, keeping only the parts (a set of Load_part
+    * bits) that will be shown.  Sections outside them read as zeros.  fd is left open.
+    */
+    std::error_code load_stream(int fd, const std::string& name, unsigned parts = load_everything);
+
+    /*
+    * Read the parts of a regular file that loader was set up for instead of mapping it all.
+    * Faster than load_file() for very large files; sections outside the parts read as zeros.
+    */
+    std::error_code load_regions(const std::string& file_path, Region_loader& loader);
+    std::error_code error() const { return error_; }
+    bool is_loaded() const { return mmap_program_ != nullptr; }
+    const std::string& file_path() const { return file_path_; }
+
+    void show_file_header(std::FILE *out = stdout) const;
+    void show_section_headers(std::FILE *out = stdout) const;
+    void show_section_header(std::size_t index, std::FILE *out = stdout) const;
+    void show_symbols(std::FILE *out = stdout) const;
+    void show_symbols(const Symbol_filter& filter, std::FILE *out = stdout) const;
+    void show_symbol_table(std::size_t section_index, const Symbol_filter& filter, std::FILE *out = stdout) const;
+    void show_build_id(std::FILE *out = stdout) const;
+    void show_symbol_histogram(std::FILE *out = stdout) const;
+    void show_size_report(std::size_t top_number, std::FILE *out = stdout) const;
+
+    /*
+    * Dump the bytes [start, start + length) of a section, clipped to the section, as hex
+    * (readelf -x) or as its runs of printable characters (readelf -p).  Only the pages of
+    * the range are read.
+    */
+    void show_hex_dump(std::size_t section_index, std::uint64_t start = 0, std::uint64_t length = UINT64_MAX,
+                       std::FILE *out = stdout) const;
+    void show_string_dump(std::size_t section_index, std::uint64_t start = 0, std::uint64_t length = UINT64_MAX,
+                          std::FILE *out = stdout) const;
 
-    void show_file_header() const;
-    void show_section_headers() const;
-    void show_symbols() const;
+    const Elf64_Ehdr *file_header() const;
+    std::size_t section_number() const;
+    const Elf64_Shdr *section_header(std::size_t index) const;
+    const char *section_name(std::size_t index) const;
+
+    /*
+    * The string at offset in string table section_index.  "" when the section has no data,
+    * when offset is at or past its sh_size, or when the string is not terminated inside it.
+    * The second form also stores the string's length.
+    */
+    const char *string_at(std::size_t section_index, std::size_t offset) const;
+    const char *string_at(std::size_t section_index, std::size_t offset, std::size_t& length) const;
+    const std::uint8_t *section_data(std::size_t index) const;
+    std::size_t find_section(const std::string& name) const;
+
+    // Find a section by decimal index or by name.
+    bool lookup_section(const std::string& section, std::size_t& index) const;
+
+    // Indices of the entries of symbol table section_index that pass filter, in table order.
+    std::vector<std::uint32_t> select_symbols(std::size_t section_index, const Symbol_filter& filter) const;
 
 private:
-    void load_memory_map();
-    void close_memory_map();
+    std::error_code load_memory_map();
+    std::error_code close_memory_map();
+    std::error_code check_headers() const;
+    void decode_sections();
+    bool resolve_section(const std::string& section, std::uint16_t& index) const;
+    void print_symbol(std::FILE *out, std::size_t index, const Elf64_Sym& symbol, std::size_t string_section) const;
     void initialize_members(std::string file_path = std::string(),
                             int fd = -1,
                             std::size_t program_length = 0,
@@ -36,8 +131,30 @@ private:
     int fd_;
     std::size_t program_length_;
     std::uint8_t *mmap_program_;
+    std::error_code error_;
+    dev_t device_;
+    ino_t inode_;
+    struct timespec modify_time_;
+
+    // One entry per section, decoded into arena_ after a successful load.
+    struct Section_row
+    {
+        const char *type;       // padded to the Type column
+        char flags[20];         // sh_flags letters, then o, p and x for the bits without one
+    };
+
+    Arena arena_;
+    const Section_row *section_rows_;
 };
 
 } // namespace ELF
 
+namespace std
+{
+
+template <>
+struct is_error_code_enum<ELF::Error> : true_type { };
+
+} // namespace std
+
 #endif // ELF_PARSER_H
\ No newline at end of file
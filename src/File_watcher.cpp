@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "File_watcher.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+// Quiet time after the last event before the file is read again, in milliseconds.
+const int SETTLE_TIME = 200;
+
+const std::uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY;
+
+inline std::uint64_t mix(std::uint64_t hash, std::uint64_t word)
+{
+    hash ^= word;
+    hash *= 0x9e3779b97f4a7c15ull;
+    return hash ^ (hash >> 29);
+}
+
+} // namespace
+
+/*
+* Four independent lanes of 8-byte words keep the multiplies from forming one dependency
+* chain, so hashing runs close to memory speed.
+*/
+std::uint64_t checksum(const std::uint8_t *data, std::size_t length)
+{
+    std::uint64_t lane[4] = {length, 0x243f6a8885a308d3ull, 0x13198a2e03707344ull, 0xa4093822299f31d0ull};
+    std::uint64_t word[4];
+    std::size_t i = 0;
+
+    for (; i + sizeof(word) <= length; i += sizeof(word))
+    {
+        std::memcpy(word, data + i, sizeof(word));
+        for (int j = 0; j < 4; ++j)
+        {
+            lane[j] = mix(lane[j], word[j]);
+        }
+    }
+
+    std::uint64_t tail;
+    for (; i + sizeof(tail) <= length; i += sizeof(tail))
+    {
+        std::memcpy(&tail, data + i, sizeof(tail));
+        lane[0] = mix(lane[0], tail);
+    }
+    if (i < length)
+    {
+        tail = 0;
+        std::memcpy(&tail, data + i, length - i);
+        lane[0] = mix(lane[0], tail);
+    }
+
+    return mix(mix(mix(lane[0], lane[1]), lane[2]), lane[3]);
+}
+
+File_watcher::File_watcher(const std::string& file_path, const Options& options, std::FILE *out,
+                           std::FILE *errors)
+    : file_path_(file_path), options_(options), out_(out), errors_(errors), loaded_(false),
+    file_header_checksum_(0)
+{
+    std::size_t slash = file_path_.rfind('/');
+    if (slash == std::string::npos)
+    {
+        directory_ = ".";
+        file_name_ = file_path_;
+    }
+    else
+    {
+        directory_ = slash == 0 ? "/" : file_path_.substr(0, slash);
+        file_name_ = file_path_.substr(slash + 1);
+    }
+}
+
+int File_watcher::run()
+{
+    int inotify_fd = ::inotify_init1(IN_CLOEXEC);
+    if (inotify_fd == -1)
+    {
+        return -1;
+    }
+    if (::inotify_add_watch(inotify_fd, directory_.c_str(), WATCH_EVENTS) == -1)
+    {
+        int saved_errno = errno;
+        ::close(inotify_fd);
+        errno = saved_errno;
+        return -1;
+    }
+
+    reload(true, true);
+
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    bool overflowed = false;
+    for (;;)
+    {
+        struct pollfd poll_fd = {inotify_fd, POLLIN, 0};
+        int ready = ::poll(&poll_fd, 1, changed ? SETTLE_TIME : -1);
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        if (ready == 0)
+        {
+            changed = false;
+            reload(false, overflowed);
+            overflowed = false;
+            continue;
+        }
+
+        ssize_t length = ::read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+        {
+            if (length == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        for (char *p = buffer; p < buffer + length; )
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                // Events for the file may be among the lost ones: assume it changed.
+                changed = overflowed = true;
+            }
+            else if (event->len != 0 && file_name_ == event->name)
+            {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    int saved_errno = errno;
+    ::close(inotify_fd);
+    errno = saved_errno;
+    return -1;
+}
+
+/*
+* Load the file again and print what changed, or everything when full_report is set or the
+* previous load failed.  A full report drops the current reader first, so nothing of the
+* old load is reused even if the file looks unchanged.
+*/
+void File_watcher::reload(bool first, bool full_report)
+{
+    if (full_report)
+    {
+        reader_ = ELF_reader();
+    }
+    std::error_code error = reader_.load_file(file_path_);
+    if (error)
+    {
+        // A half written file is normal while the linker runs; wait for the next event.
+        fflush(out_);
+        fprintf(errors_, "readelf: Error: '%s': %s\n", file_path_.c_str(), error.message().c_str());
+        fflush(errors_);
+        loaded_ = false;
+        return;
+    }
+
+    std::vector<Section_state> snapshot = take_snapshot();
+    std::uint64_t file_header_checksum = checksum(reinterpret_cast<const std::uint8_t *>(reader_.file_header()),
+                                                  sizeof(Elf64_Ehdr));
+
+    if (full_report || !loaded_)
+    {
+        if (!first)
+        {
+            fprintf(out_, "\n--- %s reloaded ---\n", file_path_.c_str());
+        }
+        if (options_.file_header)
+            reader_.show_file_header(out_);
+        if (options_.section_headers)
+            reader_.show_section_headers(out_);
+        if (options_.symbols)
+            reader_.show_symbols(options_.symbol_filter, out_);
+    }
+    else
+    {
+        report_changes(snapshot, file_header_checksum);
+    }
+    fflush(out_);
+
+    loaded_ = true;
+    snapshot_ = std::move(snapshot);
+    file_header_checksum_ = file_header_checksum;
+}
+
+std::vector<File_watcher::Section_state> File_watcher::take_snapshot() const
+{
+    std::vector<Section_state> snapshot;
+    std::map<std::string, unsigned> repeats;
+    std::size_t section_count = reader_.section_number();
+
+    snapshot.reserve(section_count);
+    for (std::size_t i = 0; i < section_count; ++i)
+    {
+        const Elf64_Shdr *section = reader_.section_header(i);
+        const std::uint8_t *data = reader_.section_data(i);
+
+        std::string key = reader_.section_name(i);
+        unsigned repeat = repeats[key]++;
+        if (repeat != 0)
+        {
+            key += "#" + std::to_string(repeat);
+        }
+        snapshot.push_back(Section_state{key, *section, data == nullptr ? 0 : checksum(data, section->sh_size)});
+    }
+    return snapshot;
+}
+
+/*
+* sh_offset and sh_name are left out: a section whose bytes only moved in the file, or
+* whose name moved in .shstrtab, has not changed.
+*/
+bool File_watcher::same_header(const Elf64_Shdr& a, const Elf64_Shdr& b)
+{
+    return a.sh_type == b.sh_type && a.sh_flags == b.sh_flags && a.sh_addr == b.sh_addr &&
+           a.sh_size == b.sh_size && a.sh_link == b.sh_link && a.sh_info == b.sh_info &&
+           a.sh_addralign == b.sh_addralign && a.sh_entsize == b.sh_entsize;
+}
+
+void File_watcher::report_changes(const std::vector<Section_state>& snapshot, std::uint64_t file_header_checksum)
+{
+    std::map<std::string, const Section_state *> previous;
+    for (const Section_state& state : snapshot_)
+    {
+        previous.emplace(state.key, &state);
+    }
+
+    std::vector<bool> differs(snapshot.size(), false);
+    std::size_t added = 0;
+    for (std::size_t i = 0; i < snapshot.size(); ++i)
+    {
+        auto it = previous.find(snapshot[i].key);
+        if (it == previous.end())
+        {
+            differs[i] = true;
+            ++added;
+            continue;
+        }
+        differs[i] = !same_header(it->second->header, snapshot[i].header) ||
+                     it->second->checksum != snapshot[i].checksum;
+        previous.erase(it);
+    }
+
+    // A symbol table prints names from the table its sh_link names, so it changes with it.
+    for (std::size_t i = 0; i < snapshot.size(); ++i)
+    {
+        const Elf64_Shdr& header = snapshot[i].header;
+        if ((header.sh_type == SHT_SYMTAB || header.sh_type == SHT_DYNSYM) && header.sh_link < snapshot.size() &&
+            differs[header.sh_link])
+        {
+            differs[i] = true;
+        }
+    }
+
+    std::vector<std::size_t> changed;
+    for (std::size_t i = 0; i < snapshot.size(); ++i)
+    {
+        if (differs[i])
+        {
+            changed.push_back(i);
+        }
+    }
+
+    fprintf(out_, "\n--- %s changed: %lu of %lu sections differ (%lu added, %lu removed) ---\n",
+            file_path_.c_str(), changed.size(), snapshot.size(), added, previous.size());
+
+    if (options_.file_header && file_header_checksum != file_header_checksum_)
+    {
+        reader_.show_file_header(out_);
+    }
+
+    if (options_.section_headers && !changed.empty())
+    {
+        fprintf(out_, "Section Headers:\n"
+                "  [Nr] Name              Type             Address           Offset\n"
+                "       Size              EntSize          Flags  Link  Info  Align\n");
+        for (std::size_t i : changed)
+        {
+            reader_.show_section_header(i, out_);
+        }
+    }
+    for (const auto& removed : previous)
+    {
+        fprintf(out_, "  removed: %s\n", removed.first.c_str());
+    }
+
+    if (options_.symbols)
+    {
+        for (std::size_t i : changed)
+        {
+            reader_.show_symbol_table(i, options_.symbol_filter, out_);
+        }
+    }
+}
+
+} // namespace ELF
@@ -0,0 +1,76 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include "ELF_reader.h"
+#include "Symbol_filter.h"
+
+namespace ELF
+{
+
+/*
+* Re-reports a binary every time it is rebuilt, limited to what changed.
+*
+* The directory holding the file is watched with inotify, so both linkers that rewrite the
+* output in place and linkers that rename a temporary over it are seen.  After the writes
+* settle the file is reloaded and every section is checksummed; sections are matched with
+* the previous load by name, and only those whose header or contents differ are printed
+* again.  Symbol tables that changed, or whose string table changed, are decoded again when
+* symbols were asked for.  If the kernel drops events because its queue overflowed, the
+* file is read from scratch and printed in full.  Load errors go to errors, not out.
+*/
+class File_watcher
+{
+public:
+    struct Options
+    {
+        bool file_header;
+        bool section_headers;
+        bool symbols;
+        Symbol_filter symbol_filter;
+    };
+
+    File_watcher(const std::string& file_path, const Options& options, std::FILE *out = stdout,
+                 std::FILE *errors = stderr);
+    File_watcher(const File_watcher& object) = delete;
+    File_watcher& operator=(const File_watcher& object) = delete;
+
+    // Runs until the process is interrupted.  Returns -1 with errno set if inotify fails.
+    int run();
+
+private:
+    struct Section_state
+    {
+        std::string key;            // name, plus "#n" for the n-th repeat of a name
+        Elf64_Shdr header;
+        std::uint64_t checksum;
+    };
+
+    void reload(bool first, bool full_report);
+    std::vector<Section_state> take_snapshot() const;
+    void report_changes(const std::vector<Section_state>& snapshot, std::uint64_t file_header_checksum);
+    static bool same_header(const Elf64_Shdr& a, const Elf64_Shdr& b);
+
+    std::string file_path_;
+    std::string file_name_;
+    std::string directory_;
+    Options options_;
+    std::FILE *out_;
+    std::FILE *errors_;
+
+    ELF_reader reader_;
+    bool loaded_;
+    std::vector<Section_state> snapshot_;
+    std::uint64_t file_header_checksum_;
+};
+
+// A 64-bit checksum of [data, data + length), used to tell changed sections apart.
+std::uint64_t checksum(const std::uint8_t *data, std::size_t length);
+
+} // namespace ELF
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,549 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "Query_server.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+// epoll_event.data.u64 of the server's own descriptors; clients are numbered after these.
+const std::uint64_t LISTEN_ID = 0;
+const std::uint64_t EVENT_ID  = 1;
+const std::uint64_t SIGNAL_ID = 2;
+
+const std::size_t MAX_REQUEST_LENGTH = 4096;
+const int MAX_EVENTS = 64;
+
+/*
+* A client stops being read once this many of its requests are waiting, and its requests
+* stop being handed to the workers while this much of its output is unsent.
+*/
+const std::size_t MAX_PENDING_REQUESTS = 64;
+const std::size_t MAX_QUEUED_OUTPUT = 1 << 20;
+
+bool add_to_epoll(int epoll_fd, int fd, std::uint32_t events, std::uint64_t id)
+{
+    struct epoll_event event;
+    event.events = events;
+    event.data.u64 = id;
+    return ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+} // namespace
+
+Query_server::Query_server(const std::string& socket_path, std::size_t cache_capacity, unsigned worker_number)
+    : socket_path_(socket_path), worker_number_(worker_number == 0 ? 1 : worker_number),
+    cache_(cache_capacity), listen_fd_(-1), epoll_fd_(-1), event_fd_(-1), signal_fd_(-1),
+    next_client_id_(SIGNAL_ID + 1), stopping_(false) { }
+
+Query_server::~Query_server()
+{
+    close_sockets();
+}
+
+int Query_server::run()
+{
+    if (!open_sockets())
+    {
+        int saved_errno = errno;
+        close_sockets();
+        errno = saved_errno;
+        return -1;
+    }
+
+    // Workers inherit the blocked signal mask set up in open_sockets().
+    for (unsigned i = 0; i < worker_number_; ++i)
+    {
+        workers_.emplace_back(&Query_server::worker_loop, this);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    bool running = true;
+    while (running)
+    {
+        int event_number = ::epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (event_number == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < event_number; ++i)
+        {
+            std::uint64_t id = events[i].data.u64;
+            if (id == LISTEN_ID)
+            {
+                accept_clients();
+            }
+            else if (id == EVENT_ID)
+            {
+                collect_results();
+            }
+            else if (id == SIGNAL_ID)
+            {
+                running = false;
+            }
+            else
+            {
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                {
+                    read_client(id);
+                }
+                if ((events[i].events & EPOLLOUT) && clients_.count(id))
+                {
+                    write_client(id);
+                }
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(job_mutex_);
+        stopping_ = true;
+    }
+    job_ready_.notify_all();
+    for (auto& worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+
+    close_sockets();
+    return 0;
+}
+
+bool Query_server::open_sockets()
+{
+    struct sockaddr_un address;
+    sigset_t signals;
+
+    if (socket_path_.size() >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGPIPE);
+    if (::pthread_sigmask(SIG_BLOCK, &signals, nullptr) != 0)
+    {
+        return false;
+    }
+    sigdelset(&signals, SIGPIPE);
+    if ((signal_fd_ = ::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)
+    {
+        return false;
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path_.c_str());
+
+    // Replace the socket a previous server left behind, but never anything else.
+    struct stat st;
+    if (::lstat(socket_path_.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            ::close(fd);
+            errno = EADDRINUSE;
+            return false;
+        }
+        ::unlink(socket_path_.c_str());
+    }
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1)
+    {
+        int saved_errno = errno;
+        ::close(fd);
+        errno = saved_errno;
+        return false;
+    }
+
+    // From here on close_sockets() removes the socket file.
+    listen_fd_ = fd;
+    if (::listen(listen_fd_, SOMAXCONN) == -1)
+    {
+        return false;
+    }
+
+    if ((event_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1 ||
+        (epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC)) == -1)
+    {
+        return false;
+    }
+
+    return add_to_epoll(epoll_fd_, listen_fd_, EPOLLIN, LISTEN_ID) &&
+           add_to_epoll(epoll_fd_, event_fd_, EPOLLIN, EVENT_ID) &&
+           add_to_epoll(epoll_fd_, signal_fd_, EPOLLIN, SIGNAL_ID);
+}
+
+void Query_server::close_sockets()
+{
+    for (auto& client : clients_)
+    {
+        ::close(client.second.fd);
+    }
+    clients_.clear();
+
+    if (listen_fd_ != -1)
+    {
+        ::close(listen_fd_);
+        ::unlink(socket_path_.c_str());
+        listen_fd_ = -1;
+    }
+    for (int *fd : {&epoll_fd_, &event_fd_, &signal_fd_})
+    {
+        if (*fd != -1)
+        {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void Query_server::accept_clients()
+{
+    for (;;)
+    {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                perror("accept4");
+            }
+            return;
+        }
+
+        std::uint64_t id = next_client_id_++;
+        if (!add_to_epoll(epoll_fd_, fd, EPOLLIN | EPOLLRDHUP, id))
+        {
+            perror("epoll_ctl");
+            ::close(fd);
+            continue;
+        }
+        clients_.emplace(id, Client{fd, false, false, EPOLLIN | EPOLLRDHUP, std::string(), std::string(), {}});
+    }
+}
+
+void Query_server::read_client(std::uint64_t client_id)
+{
+    auto it = clients_.find(client_id);
+    if (it == clients_.end())
+    {
+        return;
+    }
+    Client& client = it->second;
+
+    char buffer[4096];
+    while (!client.input_closed && client.pending.size() < MAX_PENDING_REQUESTS)
+    {
+        ssize_t length = ::read(client.fd, buffer, sizeof(buffer));
+        if (length == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (length == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (length <= 0)
+        {
+            client.input_closed = true;
+            break;
+        }
+
+        client.input.append(buffer, static_cast<std::size_t>(length));
+        take_requests(client);
+    }
+
+    dispatch(client_id);
+    update_events(client_id);
+}
+
+/*
+* Move complete lines of input to the pending requests while there is room for them.  A line
+* longer than MAX_REQUEST_LENGTH ends the input with an empty request, answered as malformed.
+*/
+void Query_server::take_requests(Client& client)
+{
+    std::size_t start = 0, end;
+    while (client.pending.size() < MAX_PENDING_REQUESTS &&
+           (end = client.input.find('\n', start)) != std::string::npos)
+    {
+        client.pending.emplace_back(client.input, start, end - start);
+        start = end + 1;
+    }
+    client.input.erase(0, start);
+
+    if (client.pending.size() < MAX_PENDING_REQUESTS && client.input.size() > MAX_REQUEST_LENGTH)
+    {
+        client.input.clear();
+        client.pending.emplace_back();
+        client.input_closed = true;
+    }
+}
+
+void Query_server::write_client(std::uint64_t client_id)
+{
+    Client& client = clients_.at(client_id);
+
+    while (!client.output.empty())
+    {
+        ssize_t length = ::write(client.fd, client.output.data(), client.output.size());
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                close_client(client_id);
+                return;
+            }
+            break;
+        }
+        client.output.erase(0, static_cast<std::size_t>(length));
+    }
+    dispatch(client_id);
+    update_events(client_id);
+}
+
+/*
+* Hand the next request of a client to the workers.  Only one request per client is in
+* flight at a time so that answers are written back in the order they were asked, and none
+* while the client is slow to read what it already asked for.
+*/
+void Query_server::dispatch(std::uint64_t client_id)
+{
+    Client& client = clients_.at(client_id);
+    if (client.busy || client.pending.empty() || client.output.size() >= MAX_QUEUED_OUTPUT)
+    {
+        return;
+    }
+
+    client.busy = true;
+    {
+        std::lock_guard<std::mutex> lock(job_mutex_);
+        jobs_.push_back(Job{client_id, std::move(client.pending.front())});
+    }
+    client.pending.pop_front();
+    take_requests(client);
+    job_ready_.notify_one();
+}
+
+void Query_server::collect_results()
+{
+    std::uint64_t counter;
+    while (::read(event_fd_, &counter, sizeof(counter)) == sizeof(counter))
+    {
+    }
+
+    std::deque<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        results.swap(results_);
+    }
+
+    for (auto& result : results)
+    {
+        auto it = clients_.find(result.client_id);
+        if (it == clients_.end())
+        {
+            continue;   // the client hung up while its request was being answered
+        }
+        it->second.busy = false;
+        it->second.output += result.response;
+        write_client(result.client_id);
+    }
+}
+
+void Query_server::close_client(std::uint64_t client_id)
+{
+    auto it = clients_.find(client_id);
+    if (it == clients_.end())
+    {
+        return;
+    }
+    if (it->second.armed_events != 0)
+    {
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    }
+    ::close(it->second.fd);
+    clients_.erase(it);
+}
+
+/*
+* Register exactly the events the client can act on: input while it may still send and has
+* room for more requests, output while some is queued.  A client that wants neither, such as
+* one that has shut down its end while a request is with the workers, is taken out of the
+* epoll set so its level-triggered hang-up does not wake the loop again and again.  Drop
+* the connection once the peer has stopped sending and everything it asked for has been
+* delivered.
+*/
+void Query_server::update_events(std::uint64_t client_id)
+{
+    auto it = clients_.find(client_id);
+    if (it == clients_.end())
+    {
+        return;
+    }
+    Client& client = it->second;
+
+    if (client.input_closed && !client.busy && client.pending.empty() && client.output.empty())
+    {
+        close_client(client_id);
+        return;
+    }
+
+    std::uint32_t wanted = 0;
+    if (!client.input_closed && client.pending.size() < MAX_PENDING_REQUESTS)
+    {
+        wanted |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (!client.output.empty())
+    {
+        wanted |= EPOLLOUT;
+    }
+    if (wanted == client.armed_events)
+    {
+        return;
+    }
+
+    struct epoll_event event;
+    event.events = wanted;
+    event.data.u64 = client_id;
+    int operation = wanted == 0 ? EPOLL_CTL_DEL : client.armed_events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (::epoll_ctl(epoll_fd_, operation, client.fd, &event) == -1)
+    {
+        perror("epoll_ctl");
+        close_client(client_id);
+        return;
+    }
+    client.armed_events = wanted;
+}
+
+void Query_server::worker_loop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(job_mutex_);
+            job_ready_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (stopping_)
+            {
+                return;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        Result result{job.client_id, answer(job.request)};
+        {
+            std::lock_guard<std::mutex> lock(result_mutex_);
+            results_.push_back(std::move(result));
+        }
+
+        std::uint64_t one = 1;
+        if (::write(event_fd_, &one, sizeof(one)) == -1 && errno != EAGAIN)
+        {
+            perror("write eventfd");
+        }
+    }
+}
+
+std::string Query_server::answer(const std::string& request)
+{
+    std::size_t separator = request.find(' ');
+    if (request.empty() || separator == std::string::npos || separator + 1 == request.size())
+    {
+        return "ERR malformed request\n";
+    }
+
+    std::string command = request.substr(0, separator);
+    std::string file_path = request.substr(separator + 1);
+
+    // size-report [N] PATH: a first word of digits is the number of symbols to list.
+    std::size_t top_number = SIZE_REPORT_TOP;
+    std::size_t digits = file_path.find_first_not_of("0123456789");
+    if (command == "size-report" && digits != 0 && digits != std::string::npos && file_path[digits] == ' ')
+    {
+        if (digits > 5 || (top_number = std::strtoul(file_path.c_str(), nullptr, 10)) > SIZE_REPORT_MAX_TOP)
+        {
+            return "ERR symbol count must be at most " + std::to_string(SIZE_REPORT_MAX_TOP) + "\n";
+        }
+        file_path.erase(0, digits + 1);
+        if (file_path.empty())
+        {
+            return "ERR malformed request\n";
+        }
+    }
+
+    std::function<void(const ELF_reader&, std::FILE *)> show;
+    if (command == "header")
+        show = [](const ELF_reader& reader, std::FILE *out) { reader.show_file_header(out); };
+    else if (command == "sections")
+        show = [](const ELF_reader& reader, std::FILE *out) { reader.show_section_headers(out); };
+    else if (command == "symbols")
+        show = [](const ELF_reader& reader, std::FILE *out) { reader.show_symbols(out); };
+    else if (command == "build-id")
+        show = [](const ELF_reader& reader, std::FILE *out) { reader.show_build_id(out); };
+    else if (command == "histogram")
+        show = [](const ELF_reader& reader, std::FILE *out) { reader.show_symbol_histogram(out); };
+    else if (command == "size-report")
+        show = [top_number](const ELF_reader& reader, std::FILE *out) { reader.show_size_report(top_number, out); };
+    else
+        return "ERR unknown command '" + command + "'\n";
+
+    std::error_code error;
+    std::shared_ptr<const ELF_reader> reader = cache_.acquire(file_path, error);
+    if (!reader)
+    {
+        return "ERR " + error.message() + "\n";
+    }
+
+    char *body = nullptr;
+    std::size_t body_length = 0;
+    std::FILE *out = ::open_memstream(&body, &body_length);
+    if (out == nullptr)
+    {
+        return "ERR " + std::system_category().message(errno) + "\n";
+    }
+    show(*reader, out);
+    std::fclose(out);
+
+    std::string response = "OK " + std::to_string(body_length) + "\n";
+    response.append(body, body_length);
+    std::free(body);
+    return response;
+}
+
+} // namespace ELF
@@ -0,0 +1,111 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Reader_cache.h"
+
+namespace ELF
+{
+
+/*
+* Serves ELF metadata over a Unix domain socket.
+*
+* Clients send one request per line:
+*
+*     header PATH | sections PATH | symbols PATH | build-id PATH | histogram PATH |
+*     size-report [N] PATH
+*
+* and receive either "OK <length>\n" followed by exactly <length> bytes of the same text
+* the command line tool prints, or a single "ERR <message>\n" line.  A connection may send
+* any number of requests; the answers come back in request order.
+*
+* N, the number of largest symbols the size report lists, defaults to 20 and may be at most
+* SIZE_REPORT_MAX_TOP.  A path whose first word is a number needs a directory part ("./10 x")
+* after size-report.
+*
+* One thread runs an epoll loop that owns every socket.  Requests are handed to a pool of
+* worker threads which look the file up in a shared Reader_cache and format the answer; the
+* finished response is passed back to the event loop through an eventfd.
+*/
+class Query_server
+{
+public:
+    Query_server(const std::string& socket_path, std::size_t cache_capacity, unsigned worker_number);
+    Query_server(const Query_server& object) = delete;
+    Query_server& operator=(const Query_server& object) = delete;
+    ~Query_server();
+
+    // Runs until SIGINT or SIGTERM.  Returns 0 on a clean shutdown, -1 with errno set otherwise.
+    int run();
+
+private:
+    struct Client
+    {
+        int fd;
+        bool busy;          // a request of this client is with the workers
+        bool input_closed;
+        std::uint32_t armed_events;     // the mask registered with epoll, 0 when not registered
+        std::string input;
+        std::string output;
+        std::deque<std::string> pending;    // at most MAX_PENDING_REQUESTS
+    };
+
+    struct Job
+    {
+        std::uint64_t client_id;
+        std::string request;
+    };
+
+    struct Result
+    {
+        std::uint64_t client_id;
+        std::string response;
+    };
+
+    bool open_sockets();
+    void close_sockets();
+    void accept_clients();
+    void read_client(std::uint64_t client_id);
+    void take_requests(Client& client);
+    void write_client(std::uint64_t client_id);
+    void dispatch(std::uint64_t client_id);
+    void collect_results();
+    void close_client(std::uint64_t client_id);
+    void update_events(std::uint64_t client_id);
+
+    void worker_loop();
+    std::string answer(const std::string& request);
+
+    std::string socket_path_;
+    unsigned worker_number_;
+    Reader_cache cache_;
+
+    int listen_fd_;
+    int epoll_fd_;
+    int event_fd_;
+    int signal_fd_;
+
+    std::uint64_t next_client_id_;
+    std::unordered_map<std::uint64_t, Client> clients_;
+
+    std::vector<std::thread> workers_;
+    std::mutex job_mutex_;
+    std::condition_variable job_ready_;
+    std::deque<Job> jobs_;
+    bool stopping_;
+
+    std::mutex result_mutex_;
+    std::deque<Result> results_;
+};
+
+} // namespace ELF
+
+#endif // QUERY_SERVER_H
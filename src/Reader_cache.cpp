@@ -0,0 +1,70 @@
+#include <cerrno>
+#include <sys/stat.h>
+#include "Reader_cache.h"
+
+namespace ELF
+{
+
+Reader_cache::Reader_cache(std::size_t capacity)
+    : capacity_(capacity == 0 ? 1 : capacity) { }
+
+std::shared_ptr<const ELF_reader> Reader_cache::acquire(const std::string& file_path, std::error_code& error)
+{
+    struct stat st;
+
+    if (::stat(file_path.c_str(), &st) == -1)
+    {
+        error.assign(errno, std::system_category());
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(file_path);
+        if (it != index_.end())
+        {
+            const Entry& entry = *it->second;
+            if (entry.device == st.st_dev && entry.inode == st.st_ino && entry.length == st.st_size &&
+                entry.modify_time.tv_sec == st.st_mtim.tv_sec &&
+                entry.modify_time.tv_nsec == st.st_mtim.tv_nsec)
+            {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return entry.reader;
+            }
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    // Map outside the lock so a cold file does not stall lookups of cached ones.
+    auto reader = std::make_shared<const ELF_reader>(file_path);
+    if ((error = reader->error()))
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(file_path);
+    if (it != index_.end())
+    {
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    entries_.push_front(Entry{file_path, st.st_dev, st.st_ino, st.st_size, st.st_mtim, reader});
+    index_.emplace(file_path, entries_.begin());
+
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().file_path);
+        entries_.pop_back();
+    }
+    return reader;
+}
+
+std::size_t Reader_cache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+} // namespace ELF
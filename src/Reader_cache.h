@@ -0,0 +1,58 @@
+#ifndef READER_CACHE_H
+#define READER_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <sys/types.h>
+#include "ELF_reader.h"
+
+namespace ELF
+{
+
+/*
+* A bounded LRU of opened ELF_reader objects keyed by path.
+*
+* A cached entry is only reused while the device, inode, size and modification time of the
+* path still match the values seen when it was mapped, so a rebuilt binary is remapped on the
+* next lookup.  Readers are handed out as shared_ptr: an entry evicted while a query is still
+* using it stays mapped until that query drops its reference.
+*/
+class Reader_cache
+{
+public:
+    explicit Reader_cache(std::size_t capacity);
+    Reader_cache(const Reader_cache& object) = delete;
+    Reader_cache& operator=(const Reader_cache& object) = delete;
+
+    // Returns nullptr and sets error if the path cannot be loaded.
+    std::shared_ptr<const ELF_reader> acquire(const std::string& file_path, std::error_code& error);
+
+    std::size_t size() const;
+
+private:
+    struct Entry
+    {
+        std::string file_path;
+        dev_t device;
+        ino_t inode;
+        off_t length;
+        struct timespec modify_time;
+        std::shared_ptr<const ELF_reader> reader;
+    };
+
+    using Entry_list = std::list<Entry>;
+
+    std::size_t capacity_;
+    mutable std::mutex mutex_;
+    Entry_list entries_;    // most recently used first
+    std::unordered_map<std::string, Entry_list::iterator> index_;
+};
+
+} // namespace ELF
+
+#endif // READER_CACHE_H
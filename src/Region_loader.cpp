@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <linux/io_uring.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "ELF_reader.h"
+#include "Region_loader.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+// Bytes per read request: one transparent huge page.
+const std::size_t READ_CHUNK = 2 << 20;
+
+// Read requests kept in flight.
+const unsigned QUEUE_DEPTH = 64;
+
+/*
+* The submission and completion rings of one io_uring instance, driven with the raw system
+* calls so that liburing is not needed.  Only one thread uses a ring, so the shared indices
+* need no more than acquire and release ordering against the kernel.
+*/
+class Ring
+{
+public:
+    explicit Ring(unsigned entries);
+    Ring(const Ring& object) = delete;
+    Ring& operator=(const Ring& object) = delete;
+    ~Ring();
+
+    bool valid() const { return fd_ != -1; }
+
+    // Free submission entries.
+    unsigned space() const
+    {
+        return entries_ - (*sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE));
+    }
+
+    void prepare_read(int fd, void *buffer, std::uint32_t length, std::uint64_t offset, std::uint64_t user_data);
+
+    // Submit the prepared requests and wait for at least wait completions.  -1 with errno on failure.
+    int submit(unsigned wait);
+
+    // Wait for at least wait completions without submitting anything.  -1 with errno on failure.
+    int wait(unsigned wait);
+
+    // Prepared requests the kernel has not taken yet.
+    unsigned unsubmitted() const { return unsubmitted_; }
+
+    // Take one completion; false if there is none.
+    bool complete(std::uint64_t& user_data, std::int32_t& result);
+
+private:
+    void close_ring();
+
+    int fd_;
+    unsigned entries_;
+    unsigned unsubmitted_;
+
+    void *sq_ring_;
+    std::size_t sq_ring_size_;
+    void *cq_ring_;
+    std::size_t cq_ring_size_;
+    struct io_uring_sqe *sqes_;
+    std::size_t sqes_size_;
+
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned sq_mask_;
+    unsigned *sq_array_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe *cqes_;
+};
+
+Ring::Ring(unsigned entries)
+    : fd_(-1), entries_(0), unsubmitted_(0), sq_ring_(MAP_FAILED), sq_ring_size_(0), cq_ring_(MAP_FAILED),
+    cq_ring_size_(0), sqes_(static_cast<struct io_uring_sqe *>(MAP_FAILED)), sqes_size_(0)
+{
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ == -1)
+    {
+        return;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      IORING_OFF_SQ_RING);
+    if (sq_ring_ != MAP_FAILED && (params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        cq_ring_ = sq_ring_;
+    }
+    else if (sq_ring_ != MAP_FAILED)
+    {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          IORING_OFF_CQ_RING);
+    }
+    if (cq_ring_ != MAP_FAILED)
+    {
+        sqes_ = static_cast<struct io_uring_sqe *>(::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                                          MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    }
+    if (sqes_ == MAP_FAILED)
+    {
+        close_ring();
+        return;
+    }
+
+    std::uint8_t *sq = static_cast<std::uint8_t *>(sq_ring_);
+    std::uint8_t *cq = static_cast<std::uint8_t *>(cq_ring_);
+    entries_ = params.sq_entries;
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+Ring::~Ring()
+{
+    close_ring();
+}
+
+void Ring::close_ring()
+{
+    if (fd_ == -1)
+    {
+        return;
+    }
+    if (sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+    {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED)
+    {
+        ::munmap(sq_ring_, sq_ring_size_);
+    }
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void Ring::prepare_read(int fd, void *buffer, std::uint32_t length, std::uint64_t offset, std::uint64_t user_data)
+{
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted_;
+}
+
+int Ring::submit(unsigned wait)
+{
+    int submitted = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, unsubmitted_, wait,
+                                               IORING_ENTER_GETEVENTS, nullptr, 0));
+    if (submitted != -1)
+    {
+        unsubmitted_ -= static_cast<unsigned>(submitted);
+    }
+    return submitted;
+}
+
+int Ring::wait(unsigned wait)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd_, 0, wait, IORING_ENTER_GETEVENTS, nullptr, 0));
+}
+
+bool Ring::complete(std::uint64_t& user_data, std::int32_t& result)
+{
+    unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
+    const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    user_data = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+} // namespace
+
+Region_loader::Region_loader(unsigned parts, Method method)
+    : parts_(parts), method_(method), bytes_read_(0) { }
+
+Region_loader::Method Region_loader::default_method()
+{
+    const char *request = std::getenv("READELF_IO");
+    return request != nullptr && std::strcmp(request, "pread") == 0 ? Method::pread : Method::io_uring;
+}
+
+const char *Region_loader::method_name(Method method)
+{
+    return method == Method::io_uring ? "io_uring" : "pread";
+}
+
+std::error_code Region_loader::load(int fd, std::size_t file_length, Sparse_image& image)
+{
+    std::error_code error;
+
+    bytes_read_ = 0;
+    if (!image.resize(file_length))
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    image.advise_huge_pages();
+
+    if ((error = read_header(fd, file_length, image.data())))
+    {
+        return error;
+    }
+
+    // Requests of at most READ_CHUNK bytes, in file order, none past the end of the file.
+    std::deque<File_region> pieces;
+    for (const File_region& region : needed_regions(image.data(), parts_))
+    {
+        std::uint64_t end = std::min<std::uint64_t>(region.offset + region.length, file_length);
+        for (std::uint64_t offset = region.offset; offset < end; offset += READ_CHUNK)
+        {
+            pieces.push_back(File_region{offset, std::min<std::uint64_t>(end - offset, READ_CHUNK)});
+        }
+    }
+
+    if (method_ == Method::io_uring && (error = read_with_ring(fd, pieces, image.data())))
+    {
+        return error;
+    }
+    return read_with_pread(fd, pieces, image.data());
+}
+
+/*
+* The ELF header and the section table decide what else is read, so they are read first,
+* one after the other, and checked enough to be walked.
+*/
+std::error_code Region_loader::read_header(int fd, std::size_t file_length, std::uint8_t *image)
+{
+    std::error_code error;
+
+    if ((error = pread_fully(fd, image, sizeof(Elf64_Ehdr), 0)))
+    {
+        return error;
+    }
+
+    const Elf64_Ehdr *file_header = reinterpret_cast<const Elf64_Ehdr *>(image);
+    if (!std::equal(ELFMAG, ELFMAG + SELFMAG, file_header->e_ident))
+    {
+        return Error::not_elf;
+    }
+    if (file_header->e_ident[EI_CLASS] != ELFCLASS64)
+    {
+        return Error::unsupported_class;
+    }
+    if (file_header->e_shoff == 0)
+    {
+        return error;
+    }
+    if (file_header->e_shoff > file_length || file_length - file_header->e_shoff < sizeof(Elf64_Shdr))
+    {
+        return Error::truncated;
+    }
+
+    std::uint8_t *table = image + file_header->e_shoff;
+    if ((error = pread_fully(fd, table, sizeof(Elf64_Shdr), file_header->e_shoff)))
+    {
+        return error;
+    }
+
+    Elf64_Xword section_number = reinterpret_cast<const Elf64_Shdr *>(table)->sh_size;
+    if (section_number == 0)
+    {
+        section_number = file_header->e_shnum;
+    }
+    if (section_number == 0)
+    {
+        return error;
+    }
+    if (section_number > (file_length - file_header->e_shoff) / sizeof(Elf64_Shdr))
+    {
+        return Error::truncated;
+    }
+    return pread_fully(fd, table + sizeof(Elf64_Shdr), (section_number - 1) * sizeof(Elf64_Shdr),
+                       file_header->e_shoff + sizeof(Elf64_Shdr));
+}
+
+/*
+* Keep QUEUE_DEPTH reads in flight.  Short reads are queued again for the rest; a kernel
+* whose io_uring lacks IORING_OP_READ fails the first requests with EINVAL, and whatever is
+* left then goes to pread.  If submitting fails, the requests the kernel already took still
+* write into image, so they are waited for before the error is returned.
+*/
+std::error_code Region_loader::read_with_ring(int fd, std::deque<File_region>& pieces, std::uint8_t *image)
+{
+    Ring ring(QUEUE_DEPTH);
+    if (!ring.valid())
+    {
+        method_ = Method::pread;
+        return std::error_code();
+    }
+
+    std::error_code error;
+    std::vector<File_region> slots(QUEUE_DEPTH);
+    std::vector<unsigned> free_slots;
+    for (unsigned i = 0; i < QUEUE_DEPTH; ++i)
+    {
+        free_slots.push_back(QUEUE_DEPTH - 1 - i);
+    }
+    unsigned in_flight = 0;
+    bool stop = false;
+    bool draining = false;
+
+    while (in_flight != 0 || (!stop && !pieces.empty()))
+    {
+        while (!stop && !pieces.empty() && !free_slots.empty() && ring.space() != 0)
+        {
+            unsigned slot = free_slots.back();
+            free_slots.pop_back();
+            slots[slot] = pieces.front();
+            pieces.pop_front();
+
+            ring.prepare_read(fd, image + slots[slot].offset, static_cast<std::uint32_t>(slots[slot].length),
+                              slots[slot].offset, slot);
+            ++in_flight;
+        }
+
+        if ((draining ? ring.wait(1) : ring.submit(1)) == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            if (draining)
+            {
+                // Nothing can be waited for any more.
+                break;
+            }
+            if (!error)
+            {
+                error.assign(errno, std::system_category());
+            }
+            stop = draining = true;
+            // Requests the kernel never took will not complete.
+            in_flight -= ring.unsubmitted();
+        }
+
+        std::uint64_t slot;
+        std::int32_t result;
+        while (ring.complete(slot, result))
+        {
+            File_region piece = slots[slot];
+            free_slots.push_back(static_cast<unsigned>(slot));
+            --in_flight;
+
+            if (result == -EAGAIN || result == -EINTR)
+            {
+                pieces.push_front(piece);
+            }
+            else if (result == -EINVAL || result == -EOPNOTSUPP)
+            {
+                pieces.push_front(piece);
+                method_ = Method::pread;
+                stop = true;
+            }
+            else if (result < 0)
+            {
+                error.assign(-result, std::system_category());
+                stop = true;
+            }
+            else if (result == 0)
+            {
+                error = Error::truncated;
+                stop = true;
+            }
+            else
+            {
+                bytes_read_ += static_cast<std::uint64_t>(result);
+                if (static_cast<std::uint64_t>(result) < piece.length)
+                {
+                    pieces.push_front(File_region{piece.offset + result, piece.length - result});
+                }
+            }
+        }
+    }
+    return error;
+}
+
+std::error_code Region_loader::read_with_pread(int fd, std::deque<File_region>& pieces, std::uint8_t *image)
+{
+    std::error_code error;
+
+    for (; !pieces.empty(); pieces.pop_front())
+    {
+        const File_region& piece = pieces.front();
+        if ((error = pread_fully(fd, image + piece.offset, piece.length, piece.offset)))
+        {
+            break;
+        }
+    }
+    return error;
+}
+
+std::error_code Region_loader::pread_fully(int fd, std::uint8_t *buffer, std::size_t length, std::uint64_t offset)
+{
+    while (length != 0)
+    {
+        ssize_t count = ::pread(fd, buffer, length, static_cast<off_t>(offset));
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return std::error_code(errno, std::system_category());
+        }
+        if (count == 0)
+        {
+            return Error::truncated;
+        }
+        buffer += count;
+        length -= static_cast<std::size_t>(count);
+        offset += static_cast<std::uint64_t>(count);
+        bytes_read_ += static_cast<std::uint64_t>(count);
+    }
+    return std::error_code();
+}
+
+} // namespace ELF
@@ -0,0 +1,59 @@
+#ifndef REGION_LOADER_H
+#define REGION_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <system_error>
+#include "Sparse_image.h"
+
+namespace ELF
+{
+
+/*
+* Loads the hot regions of a regular file into a Sparse_image instead of mapping it.
+*
+* For multi-gigabyte binaries most of the file is debug info nobody looks at, and the cost
+* of a mapping is the 4 KiB page fault taken for every page of the tables that is touched.
+* This loader reads the ELF header and section table, works out which sections the caller
+* wants (see Load_part), and reads them in large batched requests into an image that asks
+* for transparent huge pages.  The batch goes through io_uring when the kernel offers it and
+* through pread(2) otherwise; READELF_IO=pread in the environment forces the latter.
+*/
+class Region_loader
+{
+public:
+    enum class Method
+    {
+        io_uring,
+        pread,
+    };
+
+    explicit Region_loader(unsigned parts, Method method = default_method());
+    Region_loader(const Region_loader& object) = delete;
+    Region_loader& operator=(const Region_loader& object) = delete;
+
+    // Fill image from fd, a regular file of file_length bytes.
+    std::error_code load(int fd, std::size_t file_length, Sparse_image& image);
+
+    // The method the last load used; io_uring falls back to pread if the ring cannot be set up.
+    Method method() const { return method_; }
+    std::uint64_t bytes_read() const { return bytes_read_; }
+
+    static Method default_method();
+    static const char *method_name(Method method);
+
+private:
+    std::error_code read_header(int fd, std::size_t file_length, std::uint8_t *image);
+    std::error_code read_with_ring(int fd, std::deque<File_region>& pieces, std::uint8_t *image);
+    std::error_code read_with_pread(int fd, std::deque<File_region>& pieces, std::uint8_t *image);
+    std::error_code pread_fully(int fd, std::uint8_t *buffer, std::size_t length, std::uint64_t offset);
+
+    unsigned parts_;
+    Method method_;
+    std::uint64_t bytes_read_;
+};
+
+} // namespace ELF
+
+#endif // REGION_LOADER_H
@@ -0,0 +1,687 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Simd_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define READELF_X86 1
+#endif
+
+namespace ELF
+{
+
+namespace
+{
+
+// Byte offset of the 32-bit word holding st_info, st_other and st_shndx.
+const std::size_t SYMBOL_WORD_OFFSET = offsetof(Elf64_Sym, st_info);
+
+inline std::uint32_t symbol_word(const Elf64_Sym& symbol)
+{
+    std::uint32_t word;
+    std::memcpy(&word, reinterpret_cast<const char *>(&symbol) + SYMBOL_WORD_OFFSET, sizeof(word));
+    return word;
+}
+
+inline void set_bit(std::uint64_t *bitmap, std::size_t position)
+{
+    bitmap[position >> 6] |= std::uint64_t(1) << (position & 63);
+}
+
+inline unsigned count_trailing_zeros(std::uint32_t value)
+{
+    return static_cast<unsigned>(__builtin_ctz(value));
+}
+
+/*
+* Scalar versions.  They also finish the tail that is too short for a vector.
+*/
+
+std::size_t scan_symbols_scalar(const Elf64_Sym *symbol_table, std::size_t number,
+                                const Symbol_predicate& predicate, std::uint32_t *indices)
+{
+    std::uint32_t any_section = predicate.any_section ? 1 : 0;
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < number; ++i)
+    {
+        std::uint32_t info = symbol_table[i].st_info;
+        std::uint32_t ok = (predicate.type_mask >> (info & 0xf)) & (predicate.bind_mask >> (info >> 4));
+        ok &= any_section | static_cast<std::uint32_t>(symbol_table[i].st_shndx == predicate.section_index);
+        ok &= static_cast<std::uint32_t>(symbol_table[i].st_value - predicate.address_low <= predicate.address_span);
+        indices[count] = static_cast<std::uint32_t>(i);
+        count += ok & 1;
+    }
+    return count;
+}
+
+/*
+* Four interleaved st_info tables keep consecutive symbols of the same kind from serialising
+* on one counter; they are folded into the type and bind bins at the end.
+*/
+struct Info_counter
+{
+    std::uint64_t count[4][256];
+
+    Info_counter()
+    {
+        std::memset(count, 0, sizeof(count));
+    }
+
+    void add(std::size_t lane, std::uint32_t word, Symbol_histogram& histogram)
+    {
+        ++count[lane & 3][word & 0xff];
+        ++histogram.section[word >> 16];
+    }
+
+    void fold(Symbol_histogram& histogram) const
+    {
+        for (unsigned info = 0; info < 256; ++info)
+        {
+            std::uint64_t total = count[0][info] + count[1][info] + count[2][info] + count[3][info];
+            histogram.type[info & 0xf] += total;
+            histogram.bind[info >> 4] += total;
+        }
+    }
+};
+
+void histogram_symbols_scalar(const Elf64_Sym *symbol_table, std::size_t number, Symbol_histogram& histogram)
+{
+    Info_counter counter;
+    for (std::size_t i = 0; i < number; ++i)
+    {
+        counter.add(i, symbol_word(symbol_table[i]), histogram);
+    }
+    counter.fold(histogram);
+}
+
+const char *find_terminator_scalar(const char *begin, const char *end)
+{
+    const void *found = std::memchr(begin, '\0', static_cast<std::size_t>(end - begin));
+    return found == nullptr ? end : static_cast<const char *>(found);
+}
+
+std::size_t count_strings_scalar(const char *begin, const char *end)
+{
+    return static_cast<std::size_t>(std::count(begin, end, '\0'));
+}
+
+void mark_prefix_scalar(const char *begin, const char *end, const char *prefix, std::size_t length,
+                        std::uint64_t *bitmap)
+{
+    for (const char *p = begin; static_cast<std::size_t>(end - p) >= length; ++p)
+    {
+        if (*p == prefix[0] && std::memcmp(p, prefix, length) == 0)
+        {
+            set_bit(bitmap, static_cast<std::size_t>(p - begin));
+        }
+    }
+}
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+inline bool is_printable(unsigned char c)
+{
+    return c >= 0x20 && c < 0x7f;
+}
+
+void format_hex_lines_scalar(const std::uint8_t *data, std::size_t lines, char *out, std::size_t stride)
+{
+    for (std::size_t line = 0; line < lines; ++line, data += HEX_LINE_BYTES, out += stride)
+    {
+        char *hex = out;
+        for (std::size_t j = 0; j < HEX_LINE_BYTES; ++j)
+        {
+            *hex++ = HEX_DIGITS[data[j] >> 4];
+            *hex++ = HEX_DIGITS[data[j] & 0xf];
+            if ((j & 3) == 3)
+            {
+                *hex++ = ' ';
+            }
+            out[HEX_TEXT_OFFSET + j] = is_printable(data[j]) ? static_cast<char>(data[j]) : '.';
+        }
+    }
+}
+
+const char *printable_run_end_scalar(const char *begin, const char *end, bool printable)
+{
+    return std::find_if(begin, end, [printable](char c) { return is_printable(c) != printable; });
+}
+
+#ifdef READELF_X86
+
+/*
+* SSE2 versions.  SSE2 has no gathers and no variable shifts, so four symbol words are loaded
+* one by one and 1 << type is built in the float exponent instead.
+*/
+
+inline __m128i power_of_two_sse2(__m128i exponent)
+{
+    __m128i biased = _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23);
+    return _mm_cvttps_epi32(_mm_castsi128_ps(biased));
+}
+
+// Signed a > b on 64-bit lanes, from 32-bit compares.
+inline __m128i compare_greater_64_sse2(__m128i a, __m128i b)
+{
+    const __m128i low_sign = _mm_set_epi32(0, static_cast<int>(0x80000000u), 0, static_cast<int>(0x80000000u));
+    __m128i greater = _mm_cmpgt_epi32(a, b);
+    __m128i equal = _mm_cmpeq_epi32(a, b);
+    __m128i low_greater = _mm_cmpgt_epi32(_mm_xor_si128(a, low_sign), _mm_xor_si128(b, low_sign));
+    __m128i result = _mm_or_si128(greater, _mm_and_si128(equal, _mm_shuffle_epi32(low_greater, _MM_SHUFFLE(2, 2, 0, 0))));
+    return _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+std::size_t scan_symbols_sse2(const Elf64_Sym *symbol_table, std::size_t number,
+                              const Symbol_predicate& predicate, std::uint32_t *indices)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i type_mask = _mm_set1_epi32(static_cast<int>(predicate.type_mask));
+    const __m128i bind_mask = _mm_set1_epi32(static_cast<int>(predicate.bind_mask));
+    const __m128i section = _mm_set1_epi32(predicate.section_index);
+    const __m128i any_section = _mm_set1_epi32(predicate.any_section ? -1 : 0);
+    const __m128i sign = _mm_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+    const __m128i low = _mm_set1_epi64x(static_cast<long long>(predicate.address_low));
+    const __m128i span = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(predicate.address_span)), sign);
+    const bool check_address = predicate.address_span != ~Elf64_Addr(0);
+    std::size_t count = 0, i = 0;
+
+    for (; i + 4 <= number; i += 4)
+    {
+        const Elf64_Sym *symbol = symbol_table + i;
+        __m128i word = _mm_setr_epi32(static_cast<int>(symbol_word(symbol[0])), static_cast<int>(symbol_word(symbol[1])),
+                                      static_cast<int>(symbol_word(symbol[2])), static_cast<int>(symbol_word(symbol[3])));
+        __m128i info = _mm_and_si128(word, _mm_set1_epi32(0xff));
+        __m128i type = power_of_two_sse2(_mm_and_si128(info, _mm_set1_epi32(0xf)));
+        __m128i bind = power_of_two_sse2(_mm_srli_epi32(info, 4));
+        __m128i shndx = _mm_srli_epi32(word, 16);
+
+        __m128i fail = _mm_or_si128(_mm_cmpeq_epi32(_mm_and_si128(type, type_mask), zero),
+                                    _mm_cmpeq_epi32(_mm_and_si128(bind, bind_mask), zero));
+        fail = _mm_or_si128(fail, _mm_andnot_si128(_mm_or_si128(any_section, _mm_cmpeq_epi32(shndx, section)),
+                                                   _mm_set1_epi32(-1)));
+        unsigned failed = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(fail)));
+
+        if (check_address)
+        {
+            __m128i value01 = _mm_set_epi64x(static_cast<long long>(symbol[1].st_value), static_cast<long long>(symbol[0].st_value));
+            __m128i value23 = _mm_set_epi64x(static_cast<long long>(symbol[3].st_value), static_cast<long long>(symbol[2].st_value));
+            __m128i above01 = compare_greater_64_sse2(_mm_xor_si128(_mm_sub_epi64(value01, low), sign), span);
+            __m128i above23 = compare_greater_64_sse2(_mm_xor_si128(_mm_sub_epi64(value23, low), sign), span);
+            failed |= static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(above01)));
+            failed |= static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(above23))) << 2;
+        }
+
+        unsigned passed = ~failed;
+        for (unsigned lane = 0; lane < 4; ++lane)
+        {
+            indices[count] = static_cast<std::uint32_t>(i + lane);
+            count += (passed >> lane) & 1;
+        }
+    }
+
+    std::size_t tail = scan_symbols_scalar(symbol_table + i, number - i, predicate, indices + count);
+    for (std::size_t j = count; j < count + tail; ++j)
+    {
+        indices[j] += static_cast<std::uint32_t>(i);
+    }
+    return count + tail;
+}
+
+const char *find_terminator_sse2(const char *begin, const char *end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const char *p = begin;
+
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)));
+        if (mask != 0)
+        {
+            return p + count_trailing_zeros(mask);
+        }
+    }
+    return find_terminator_scalar(p, end);
+}
+
+std::size_t count_strings_sse2(const char *begin, const char *end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const char *p = begin;
+    std::size_t count = 0;
+
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        count += static_cast<std::size_t>(__builtin_popcount(
+            static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero)))));
+    }
+    return count + count_strings_scalar(p, end);
+}
+
+/*
+* Candidates are the positions where both the first and the last byte of the prefix match;
+* only those are compared in full.
+*/
+void mark_prefix_sse2(const char *begin, const char *end, const char *prefix, std::size_t length,
+                      std::uint64_t *bitmap)
+{
+    const __m128i first = _mm_set1_epi8(prefix[0]);
+    const __m128i last = _mm_set1_epi8(prefix[length - 1]);
+    const char *p = begin;
+
+    for (; static_cast<std::size_t>(end - p) >= 16 + length - 1; p += 16)
+    {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + length - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+        while (mask != 0)
+        {
+            unsigned lane = count_trailing_zeros(mask);
+            if (std::memcmp(p + lane, prefix, length) == 0)
+            {
+                set_bit(bitmap, static_cast<std::size_t>(p + lane - begin));
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    for (; static_cast<std::size_t>(end - p) >= length; ++p)
+    {
+        if (*p == prefix[0] && std::memcmp(p, prefix, length) == 0)
+        {
+            set_bit(bitmap, static_cast<std::size_t>(p - begin));
+        }
+    }
+}
+
+inline __m128i printable_sse2(__m128i bytes)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7f)));
+}
+
+/*
+* Lay out one line from the digits of the high and low nibbles of its 16 bytes: interleaving
+* them gives the digits in order, stored in four groups of eight with a space after each.
+*/
+inline void store_hex_line(__m128i bytes, __m128i high, __m128i low, char *out)
+{
+    __m128i first = _mm_unpacklo_epi8(high, low);
+    __m128i second = _mm_unpackhi_epi8(high, low);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), first);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 9), _mm_srli_si128(first, 8));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 18), second);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 27), _mm_srli_si128(second, 8));
+    out[8] = out[17] = out[26] = out[35] = ' ';
+
+    __m128i printable = printable_sse2(bytes);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + HEX_TEXT_OFFSET),
+                     _mm_or_si128(_mm_and_si128(printable, bytes), _mm_andnot_si128(printable, _mm_set1_epi8('.'))));
+}
+
+// Without pshufb a nibble n becomes '0' + n, plus the distance from '9' + 1 to 'a' when n > 9.
+inline __m128i hex_digits_sse2(__m128i nibbles)
+{
+    __m128i gap = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), gap);
+}
+
+void format_hex_lines_sse2(const std::uint8_t *data, std::size_t lines, char *out, std::size_t stride)
+{
+    const __m128i nibble = _mm_set1_epi8(0xf);
+
+    for (std::size_t line = 0; line < lines; ++line, data += HEX_LINE_BYTES, out += stride)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        __m128i high = hex_digits_sse2(_mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+        __m128i low = hex_digits_sse2(_mm_and_si128(bytes, nibble));
+        store_hex_line(bytes, high, low, out);
+    }
+}
+
+const char *printable_run_end_sse2(const char *begin, const char *end, bool printable)
+{
+    const unsigned flip = printable ? 0xffff : 0;
+    const char *p = begin;
+
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(printable_sse2(bytes))) ^ flip;
+        if (mask != 0)
+        {
+            return p + count_trailing_zeros(mask);
+        }
+    }
+    return printable_run_end_scalar(p, end, printable);
+}
+
+/*
+* AVX2 versions.  One gather of the 32-bit word at offset 4 of eight symbols brings in
+* st_info and st_shndx together, and variable shifts test the type and bind masks directly.
+*/
+
+__attribute__((target("avx2")))
+std::size_t scan_symbols_avx2(const Elf64_Sym *symbol_table, std::size_t number,
+                              const Symbol_predicate& predicate, std::uint32_t *indices)
+{
+    const int stride = sizeof(Elf64_Sym) / sizeof(int);
+    const __m256i word_index = _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride,
+                                                 4 * stride, 5 * stride, 6 * stride, 7 * stride);
+    const __m128i value_index = _mm_setr_epi32(0, stride / 2, stride, 3 * stride / 2);
+    const __m256i type_mask = _mm256_set1_epi32(static_cast<int>(predicate.type_mask));
+    const __m256i bind_mask = _mm256_set1_epi32(static_cast<int>(predicate.bind_mask));
+    const __m256i section = _mm256_set1_epi32(predicate.section_index);
+    const __m256i any_section = _mm256_set1_epi32(predicate.any_section ? -1 : 0);
+    const __m256i sign = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+    const __m256i low = _mm256_set1_epi64x(static_cast<long long>(predicate.address_low));
+    const __m256i span = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(predicate.address_span)), sign);
+    const bool check_address = predicate.address_span != ~Elf64_Addr(0);
+    std::size_t count = 0, i = 0;
+
+    for (; i + 8 <= number; i += 8)
+    {
+        const char *base = reinterpret_cast<const char *>(symbol_table + i);
+        __m256i word = _mm256_i32gather_epi32(reinterpret_cast<const int *>(base + SYMBOL_WORD_OFFSET), word_index, 4);
+        __m256i info = _mm256_and_si256(word, _mm256_set1_epi32(0xff));
+        __m256i type = _mm256_and_si256(info, _mm256_set1_epi32(0xf));
+        __m256i bind = _mm256_srli_epi32(info, 4);
+        __m256i shndx = _mm256_srli_epi32(word, 16);
+
+        __m256i ok = _mm256_and_si256(_mm256_srlv_epi32(type_mask, type), _mm256_srlv_epi32(bind_mask, bind));
+        ok = _mm256_and_si256(_mm256_slli_epi32(ok, 31),
+                              _mm256_or_si256(any_section, _mm256_cmpeq_epi32(shndx, section)));
+        unsigned passed = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(ok)));
+
+        if (check_address)
+        {
+            const long long *value = reinterpret_cast<const long long *>(base + offsetof(Elf64_Sym, st_value));
+            __m256i value0 = _mm256_i32gather_epi64(value, value_index, 8);
+            __m256i value1 = _mm256_i32gather_epi64(value + 2 * stride, value_index, 8);
+            __m256i above0 = _mm256_cmpgt_epi64(_mm256_xor_si256(_mm256_sub_epi64(value0, low), sign), span);
+            __m256i above1 = _mm256_cmpgt_epi64(_mm256_xor_si256(_mm256_sub_epi64(value1, low), sign), span);
+            unsigned above = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(above0))) |
+                             static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(above1))) << 4;
+            passed &= ~above;
+        }
+
+        for (unsigned lane = 0; lane < 8; ++lane)
+        {
+            indices[count] = static_cast<std::uint32_t>(i + lane);
+            count += (passed >> lane) & 1;
+        }
+    }
+
+    std::size_t tail = scan_symbols_scalar(symbol_table + i, number - i, predicate, indices + count);
+    for (std::size_t j = count; j < count + tail; ++j)
+    {
+        indices[j] += static_cast<std::uint32_t>(i);
+    }
+    return count + tail;
+}
+
+__attribute__((target("avx2")))
+void histogram_symbols_avx2(const Elf64_Sym *symbol_table, std::size_t number, Symbol_histogram& histogram)
+{
+    const int stride = sizeof(Elf64_Sym) / sizeof(int);
+    const __m256i word_index = _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride,
+                                                 4 * stride, 5 * stride, 6 * stride, 7 * stride);
+    alignas(32) std::uint32_t words[8];
+    Info_counter counter;
+    std::size_t i = 0;
+
+    for (; i + 8 <= number; i += 8)
+    {
+        const char *base = reinterpret_cast<const char *>(symbol_table + i);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(words),
+            _mm256_i32gather_epi32(reinterpret_cast<const int *>(base + SYMBOL_WORD_OFFSET), word_index, 4));
+        for (unsigned lane = 0; lane < 8; ++lane)
+        {
+            counter.add(lane, words[lane], histogram);
+        }
+    }
+    for (; i < number; ++i)
+    {
+        counter.add(i, symbol_word(symbol_table[i]), histogram);
+    }
+    counter.fold(histogram);
+}
+
+__attribute__((target("avx2")))
+const char *find_terminator_avx2(const char *begin, const char *end)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const char *p = begin;
+
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero)));
+        if (mask != 0)
+        {
+            return p + count_trailing_zeros(mask);
+        }
+    }
+    return find_terminator_sse2(p, end);
+}
+
+__attribute__((target("avx2,popcnt")))
+std::size_t count_strings_avx2(const char *begin, const char *end)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const char *p = begin;
+    std::size_t count = 0;
+
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        count += static_cast<std::size_t>(__builtin_popcount(
+            static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, zero)))));
+    }
+    return count + count_strings_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+void mark_prefix_avx2(const char *begin, const char *end, const char *prefix, std::size_t length,
+                      std::uint64_t *bitmap)
+{
+    const __m256i first = _mm256_set1_epi8(prefix[0]);
+    const __m256i last = _mm256_set1_epi8(prefix[length - 1]);
+    const char *p = begin;
+
+    for (; static_cast<std::size_t>(end - p) >= 32 + length - 1; p += 32)
+    {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + length - 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last))));
+        while (mask != 0)
+        {
+            unsigned lane = count_trailing_zeros(mask);
+            if (std::memcmp(p + lane, prefix, length) == 0)
+            {
+                set_bit(bitmap, static_cast<std::size_t>(p + lane - begin));
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    for (; static_cast<std::size_t>(end - p) >= length; ++p)
+    {
+        if (*p == prefix[0] && std::memcmp(p, prefix, length) == 0)
+        {
+            set_bit(bitmap, static_cast<std::size_t>(p - begin));
+        }
+    }
+}
+
+/*
+* A hex line is only 16 bytes, so the AVX2 level formats it with SSSE3's pshufb, looking the
+* digit of each nibble up in a 16-entry table.
+*/
+__attribute__((target("avx2")))
+void format_hex_lines_avx2(const std::uint8_t *data, std::size_t lines, char *out, std::size_t stride)
+{
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i *>(HEX_DIGITS));
+    const __m128i nibble = _mm_set1_epi8(0xf);
+
+    for (std::size_t line = 0; line < lines; ++line, data += HEX_LINE_BYTES, out += stride)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, nibble));
+        store_hex_line(bytes, high, low, out);
+    }
+}
+
+__attribute__((target("avx2")))
+const char *printable_run_end_avx2(const char *begin, const char *end, bool printable)
+{
+    const __m256i space = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const unsigned flip = printable ? ~0u : 0;
+    const char *p = begin;
+
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i is_printable = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, space), _mm256_cmpgt_epi8(del, bytes));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(is_printable)) ^ flip;
+        if (mask != 0)
+        {
+            return p + count_trailing_zeros(mask);
+        }
+    }
+    return printable_run_end_sse2(p, end, printable);
+}
+
+#endif // READELF_X86
+
+struct Kernels
+{
+    Simd_level level;
+    std::size_t (*scan_symbols)(const Elf64_Sym *, std::size_t, const Symbol_predicate&, std::uint32_t *);
+    void (*histogram_symbols)(const Elf64_Sym *, std::size_t, Symbol_histogram&);
+    const char *(*find_terminator)(const char *, const char *);
+    std::size_t (*count_strings)(const char *, const char *);
+    void (*mark_prefix)(const char *, const char *, const char *, std::size_t, std::uint64_t *);
+    void (*format_hex_lines)(const std::uint8_t *, std::size_t, char *, std::size_t);
+    const char *(*printable_run_end)(const char *, const char *, bool);
+};
+
+Kernels choose_kernels()
+{
+    Simd_level level = Simd_level::scalar;
+#ifdef READELF_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        level = Simd_level::avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        level = Simd_level::sse2;
+#endif
+
+    const char *request = std::getenv("READELF_SIMD");
+    if (request != nullptr)
+    {
+        if (std::strcmp(request, "scalar") == 0)
+            level = Simd_level::scalar;
+        else if (std::strcmp(request, "sse2") == 0 && level > Simd_level::sse2)
+            level = Simd_level::sse2;
+    }
+
+    switch (level)
+    {
+#ifdef READELF_X86
+    case Simd_level::avx2:
+        return Kernels{level, scan_symbols_avx2, histogram_symbols_avx2, find_terminator_avx2,
+                       count_strings_avx2, mark_prefix_avx2, format_hex_lines_avx2, printable_run_end_avx2};
+    case Simd_level::sse2:
+        return Kernels{level, scan_symbols_sse2, histogram_symbols_scalar, find_terminator_sse2,
+                       count_strings_sse2, mark_prefix_sse2, format_hex_lines_sse2, printable_run_end_sse2};
+#endif
+    default:
+        return Kernels{Simd_level::scalar, scan_symbols_scalar, histogram_symbols_scalar,
+                       find_terminator_scalar, count_strings_scalar, mark_prefix_scalar,
+                       format_hex_lines_scalar, printable_run_end_scalar};
+    }
+}
+
+const Kernels& kernels()
+{
+    static const Kernels chosen = choose_kernels();
+    return chosen;
+}
+
+} // namespace
+
+Simd_level simd_level()
+{
+    return kernels().level;
+}
+
+const char *simd_level_name(Simd_level level)
+{
+    switch (level)
+    {
+    case Simd_level::avx2:
+        return "avx2";
+    case Simd_level::sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+Symbol_histogram::Symbol_histogram()
+    : section(65536, 0)
+{
+    std::memset(type, 0, sizeof(type));
+    std::memset(bind, 0, sizeof(bind));
+}
+
+std::size_t scan_symbols(const Elf64_Sym *symbol_table, std::size_t number,
+                         const Symbol_predicate& predicate, std::uint32_t *indices)
+{
+    return kernels().scan_symbols(symbol_table, number, predicate, indices);
+}
+
+void histogram_symbols(const Elf64_Sym *symbol_table, std::size_t number, Symbol_histogram& histogram)
+{
+    kernels().histogram_symbols(symbol_table, number, histogram);
+}
+
+const char *find_terminator(const char *begin, const char *end)
+{
+    return kernels().find_terminator(begin, end);
+}
+
+std::size_t count_strings(const char *begin, const char *end)
+{
+    return kernels().count_strings(begin, end);
+}
+
+void mark_prefix(const char *begin, const char *end, const char *prefix, std::size_t length,
+                 std::uint64_t *bitmap)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    kernels().mark_prefix(begin, end, prefix, length, bitmap);
+}
+
+void format_hex_lines(const std::uint8_t *data, std::size_t lines, char *out, std::size_t stride)
+{
+    kernels().format_hex_lines(data, lines, out, stride);
+}
+
+const char *printable_run_end(const char *begin, const char *end, bool printable)
+{
+    return kernels().printable_run_end(begin, end, printable);
+}
+
+} // namespace ELF
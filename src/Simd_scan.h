@@ -0,0 +1,86 @@
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <elf.h>
+#include "Symbol_filter.h"
+
+namespace ELF
+{
+
+/*
+* Bulk kernels over symbol arrays and string tables.
+*
+* Every kernel has a scalar version and, on x86, SSE2 and AVX2 versions compiled with
+* function target attributes.  The best level the CPU supports is picked once, on first
+* use; setting READELF_SIMD=scalar|sse2|avx2 in the environment caps it, which is how the
+* versions are compared against each other.
+*/
+enum class Simd_level
+{
+    scalar,
+    sse2,
+    avx2,
+};
+
+Simd_level simd_level();
+const char *simd_level_name(Simd_level level);
+
+struct Symbol_histogram
+{
+    std::uint64_t type[16];                 // by ELF64_ST_TYPE(st_info)
+    std::uint64_t bind[16];                 // by ELF64_ST_BIND(st_info)
+    std::vector<std::uint64_t> section;     // by st_shndx, 65536 entries
+
+    Symbol_histogram();
+};
+
+/*
+* Store the indices of the symbols in [0, number) that pass the fixed-field checks into
+* indices, which must have room for number entries, and return how many there are.  Only
+* st_info, st_shndx and st_value are read; names are left to the caller.
+*/
+std::size_t scan_symbols(const Elf64_Sym *symbol_table, std::size_t number,
+                         const Symbol_predicate& predicate, std::uint32_t *indices);
+
+// Add the symbols in [0, number) to histogram.
+void histogram_symbols(const Elf64_Sym *symbol_table, std::size_t number, Symbol_histogram& histogram);
+
+// The first NUL in [begin, end), or end if there is none.
+const char *find_terminator(const char *begin, const char *end);
+
+// The number of NUL terminated strings in [begin, end).
+std::size_t count_strings(const char *begin, const char *end);
+
+/*
+* Set bit (p - begin) of bitmap for every position p in [begin, end) at which the length
+* bytes of prefix start.  bitmap must hold (end - begin + 63) / 64 zeroed words.  Symbol
+* names may point into the middle of a string table entry, so every position counts, not
+* just the ones after a NUL.
+*/
+void mark_prefix(const char *begin, const char *end, const char *prefix, std::size_t length,
+                 std::uint64_t *bitmap);
+
+// Bytes shown per hex dump line, and where their text column starts in a formatted line.
+const std::size_t HEX_LINE_BYTES = 16;
+const std::size_t HEX_TEXT_OFFSET = 36;
+const std::size_t HEX_LINE_LENGTH = HEX_TEXT_OFFSET + HEX_LINE_BYTES;
+
+/*
+* Format lines * HEX_LINE_BYTES bytes of data the way readelf -x shows them, one line every
+* stride bytes of out: four groups of eight hex digits, each followed by a space, then the
+* bytes as text with '.' for anything unprintable.  HEX_LINE_LENGTH characters per line.
+*/
+void format_hex_lines(const std::uint8_t *data, std::size_t lines, char *out, std::size_t stride);
+
+/*
+* The first byte in [begin, end) that is not printable ASCII (space to '~') when printable is
+* true, or that is printable when it is false; end if there is none.
+*/
+const char *printable_run_end(const char *begin, const char *end, bool printable);
+
+} // namespace ELF
+
+#endif // SIMD_SCAN_H
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "Sparse_image.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+std::size_t page_size()
+{
+    static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+void add_section(std::vector<File_region>& regions, const Elf64_Shdr *section_table,
+                 std::size_t section_number, std::size_t index)
+{
+    if (index == SHN_UNDEF || index >= section_number || section_table[index].sh_type == SHT_NOBITS ||
+        section_table[index].sh_size == 0)
+    {
+        return;
+    }
+    regions.push_back(File_region{section_table[index].sh_offset, section_table[index].sh_size});
+}
+
+} // namespace
+
+Sparse_image::Sparse_image()
+    : data_(nullptr), length_(0) { }
+
+Sparse_image::~Sparse_image()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(data_, length_);
+    }
+}
+
+bool Sparse_image::resize(std::size_t length)
+{
+    if (length == length_)
+    {
+        return true;
+    }
+
+    void *memory;
+    if (data_ == nullptr)
+    {
+        memory = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    else
+    {
+        memory = ::mremap(data_, length_, length, MREMAP_MAYMOVE);
+    }
+    if (memory == MAP_FAILED)
+    {
+        return false;
+    }
+
+    data_ = static_cast<std::uint8_t *>(memory);
+    length_ = length;
+    return true;
+}
+
+void Sparse_image::discard_except(std::size_t end, const std::vector<File_region>& keep)
+{
+    std::size_t mask = page_size() - 1;
+    std::size_t start = 0;
+
+    end = std::min(end, length_);
+    auto discard = [this, mask](std::size_t from, std::size_t to) {
+        from = (from + mask) & ~mask;
+        to &= ~mask;
+        if (from < to)
+        {
+            ::madvise(data_ + from, to - from, MADV_DONTNEED);
+        }
+    };
+
+    for (const File_region& region : keep)
+    {
+        if (region.offset >= end)
+        {
+            break;
+        }
+        if (region.offset > start)
+        {
+            discard(start, region.offset);
+        }
+        start = std::max<std::size_t>(start, region.offset + region.length);
+    }
+    if (start < end)
+    {
+        discard(start, end);
+    }
+}
+
+void Sparse_image::advise_huge_pages()
+{
+    if (data_ != nullptr)
+    {
+        ::madvise(data_, length_, MADV_HUGEPAGE);
+    }
+}
+
+std::uint8_t *Sparse_image::release()
+{
+    std::uint8_t *data = data_;
+    data_ = nullptr;
+    return data;
+}
+
+std::vector<File_region> needed_regions(const std::uint8_t *image, unsigned parts)
+{
+    const Elf64_Ehdr *file_header = reinterpret_cast<const Elf64_Ehdr *>(image);
+    std::vector<File_region> regions{File_region{0, sizeof(Elf64_Ehdr)}};
+
+    if (file_header->e_shoff == 0)
+    {
+        return regions;
+    }
+
+    const Elf64_Shdr *section_table = reinterpret_cast<const Elf64_Shdr *>(image + file_header->e_shoff);
+    std::size_t section_number = section_table[0].sh_size == 0 ? file_header->e_shnum : section_table[0].sh_size;
+    regions.push_back(File_region{file_header->e_shoff, section_number * sizeof(Elf64_Shdr)});
+
+    if (parts != 0)
+    {
+        add_section(regions, section_table, section_number,
+                    file_header->e_shstrndx == SHN_XINDEX ? section_table[0].sh_link : file_header->e_shstrndx);
+    }
+
+    for (std::size_t i = 1; i < section_number; ++i)
+    {
+        Elf64_Word type = section_table[i].sh_type;
+        if ((parts & load_contents) ||
+            ((parts & load_notes) && type == SHT_NOTE))
+        {
+            add_section(regions, section_table, section_number, i);
+        }
+        else if ((parts & load_symbols) && (type == SHT_SYMTAB || type == SHT_DYNSYM))
+        {
+            add_section(regions, section_table, section_number, i);
+            add_section(regions, section_table, section_number, section_table[i].sh_link);
+        }
+    }
+
+    std::sort(regions.begin(), regions.end(),
+              [](const File_region& a, const File_region& b) { return a.offset < b.offset; });
+
+    std::vector<File_region> merged;
+    for (const File_region& region : regions)
+    {
+        if (!merged.empty() && region.offset <= merged.back().offset + merged.back().length)
+        {
+            merged.back().length = std::max(merged.back().length, region.offset + region.length - merged.back().offset);
+            continue;
+        }
+        merged.push_back(region);
+    }
+    return merged;
+}
+
+std::uint64_t file_extent(const std::uint8_t *image)
+{
+    const Elf64_Ehdr *file_header = reinterpret_cast<const Elf64_Ehdr *>(image);
+    std::uint64_t extent = sizeof(Elf64_Ehdr);
+
+    if (file_header->e_shoff == 0)
+    {
+        return extent;
+    }
+
+    const Elf64_Shdr *section_table = reinterpret_cast<const Elf64_Shdr *>(image + file_header->e_shoff);
+    std::size_t section_number = section_table[0].sh_size == 0 ? file_header->e_shnum : section_table[0].sh_size;
+    extent = std::max<std::uint64_t>(extent, file_header->e_shoff + section_number * sizeof(Elf64_Shdr));
+
+    for (std::size_t i = 1; i < section_number; ++i)
+    {
+        if (section_table[i].sh_type != SHT_NOBITS)
+        {
+            extent = std::max(extent, section_table[i].sh_offset + section_table[i].sh_size);
+        }
+    }
+    return extent;
+}
+
+} // namespace ELF
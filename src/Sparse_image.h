@@ -0,0 +1,78 @@
+#ifndef SPARSE_IMAGE_H
+#define SPARSE_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <elf.h>
+
+namespace ELF
+{
+
+/*
+* Parts of a file kept by the loaders that do not map the whole file.  The ELF header and the
+* section table are always kept; with no parts nothing else is, which is enough for -h.
+*/
+enum Load_part : unsigned
+{
+    load_section_headers = 1u << 0,     // section names
+    load_symbols         = 1u << 1,     // symbol tables, their string tables and section names
+    load_notes           = 1u << 2,     // note sections
+    load_contents        = 1u << 3,     // every section with contents in the file
+    load_everything      = ~0u,
+};
+
+struct File_region
+{
+    std::uint64_t offset;
+    std::uint64_t length;
+};
+
+/*
+* Anonymous memory laid out like a file, for loaders that do not map the file itself.
+*
+* Pages are only backed once written, so an image as long as a multi-gigabyte binary costs
+* no more than the regions copied into it; the rest reads as zeros.  The ELF_reader that
+* adopts an image unmaps it like any other mapping.
+*/
+class Sparse_image
+{
+public:
+    Sparse_image();
+    Sparse_image(const Sparse_image& object) = delete;
+    Sparse_image& operator=(const Sparse_image& object) = delete;
+    ~Sparse_image();
+
+    // Grow or shrink to length bytes, keeping the contents.  Returns false with errno set.
+    bool resize(std::size_t length);
+
+    // Give back the pages below end that do not overlap a region in keep.
+    void discard_except(std::size_t end, const std::vector<File_region>& keep);
+
+    // Ask for transparent huge pages; a hint that may be ignored.
+    void advise_huge_pages();
+
+    std::uint8_t *data() const { return data_; }
+    std::size_t length() const { return length_; }
+
+    // Hand the memory over; the caller unmaps data() with length().
+    std::uint8_t *release();
+
+private:
+    std::uint8_t *data_;
+    std::size_t length_;
+};
+
+/*
+* The regions of a file a partial load must fill, sorted by offset and merged: the ELF
+* header, the section table and the sections selected by parts.
+* The section table must be inside the image already.
+*/
+std::vector<File_region> needed_regions(const std::uint8_t *image, unsigned parts);
+
+// One past the last byte of the file any header or section refers to.
+std::uint64_t file_extent(const std::uint8_t *image);
+
+} // namespace ELF
+
+#endif // SPARSE_IMAGE_H
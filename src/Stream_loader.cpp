@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <unistd.h>
+#include "ELF_reader.h"
+#include "Stream_loader.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+// Largest single read(2); pipes hand out less, files and sockets often this much.
+const std::size_t READ_SIZE = 1 << 20;
+
+} // namespace
+
+Stream_loader::Stream_loader(int fd, unsigned parts)
+    : fd_(fd), parts_(parts), position_(0) { }
+
+std::error_code Stream_loader::load(Sparse_image& image)
+{
+    std::error_code error;
+
+    if (!image.resize(sizeof(Elf64_Ehdr)))
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    if ((error = advance(image, sizeof(Elf64_Ehdr), true)))
+    {
+        bool elf = position_ >= SELFMAG && std::equal(ELFMAG, ELFMAG + SELFMAG, image.data());
+        return error == Error::truncated && !elf ? make_error_code(Error::not_elf) : error;
+    }
+
+    Elf64_Ehdr file_header = *reinterpret_cast<const Elf64_Ehdr *>(image.data());
+    if (!std::equal(ELFMAG, ELFMAG + SELFMAG, file_header.e_ident))
+    {
+        return Error::not_elf;
+    }
+    if (file_header.e_ident[EI_CLASS] != ELFCLASS64)
+    {
+        return Error::unsupported_class;
+    }
+    if (file_header.e_shoff == 0)
+    {
+        return error;
+    }
+
+    /*
+    * Nothing says which of the bytes before the section table matter until the table is
+    * read, so they are all kept unless the header is all that was asked for.
+    */
+    if (file_header.e_shoff > std::numeric_limits<std::size_t>::max() - sizeof(Elf64_Shdr))
+    {
+        return Error::truncated;
+    }
+    std::uint64_t table_offset = file_header.e_shoff;
+    if (!image.resize(table_offset + sizeof(Elf64_Shdr)))
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    if ((error = advance(image, table_offset, parts_ != 0)) ||
+        (error = advance(image, table_offset + sizeof(Elf64_Shdr), true)))
+    {
+        return error;
+    }
+
+    const Elf64_Shdr *first_section = reinterpret_cast<const Elf64_Shdr *>(image.data() + table_offset);
+    std::uint64_t section_number = first_section->sh_size == 0 ? file_header.e_shnum : first_section->sh_size;
+    if (section_number > (std::numeric_limits<std::size_t>::max() - table_offset) / sizeof(Elf64_Shdr))
+    {
+        return Error::truncated;
+    }
+    std::uint64_t table_end = table_offset + section_number * sizeof(Elf64_Shdr);
+    if (!image.resize(std::max<std::uint64_t>(table_end, image.length())))
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    if ((error = advance(image, table_end, true)))
+    {
+        return error;
+    }
+
+    if (!image.resize(std::max<std::uint64_t>(file_extent(image.data()), image.length())))
+    {
+        return std::error_code(errno, std::system_category());
+    }
+
+    std::vector<File_region> regions = needed_regions(image.data(), parts_);
+    image.discard_except(table_offset, regions);
+
+    for (const File_region& region : regions)
+    {
+        if ((error = advance(image, region.offset, false)) ||
+            (error = advance(image, region.offset + region.length, true)))
+        {
+            return error;
+        }
+    }
+    return error;
+}
+
+/*
+* Take the stream up to offset end.  Kept bytes are read straight into their place in the
+* image; the others go to a scratch buffer and are forgotten.
+*/
+std::error_code Stream_loader::advance(Sparse_image& image, std::uint64_t end, bool keep)
+{
+    if (!keep && position_ < end && scratch_.empty())
+    {
+        scratch_.resize(READ_SIZE);
+    }
+
+    while (position_ < end)
+    {
+        std::size_t length = static_cast<std::size_t>(std::min<std::uint64_t>(end - position_, READ_SIZE));
+        std::uint8_t *buffer = keep ? image.data() + position_ : scratch_.data();
+
+        ssize_t count = ::read(fd_, buffer, length);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return std::error_code(errno, std::system_category());
+        }
+        if (count == 0)
+        {
+            return Error::truncated;
+        }
+        position_ += static_cast<std::uint64_t>(count);
+    }
+    return std::error_code();
+}
+
+} // namespace ELF
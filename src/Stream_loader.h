@@ -0,0 +1,44 @@
+#ifndef STREAM_LOADER_H
+#define STREAM_LOADER_H
+
+#include <cstdint>
+#include <system_error>
+#include <vector>
+#include "Sparse_image.h"
+
+namespace ELF
+{
+
+/*
+* Reads an ELF file from a pipe or any other descriptor that cannot be mapped or seeked.
+*
+* The stream is read once, front to back, in large reads straight into a Sparse_image.  Only
+* the bytes before the section table have to be kept without knowing whether they are needed;
+* once the table has arrived the pages outside the selected sections are given back, later
+* sections are read in file order, and the bytes between them are dropped.  Reading stops
+* after the last selected section, so the rest of the stream is never consumed.
+*/
+class Stream_loader
+{
+public:
+    Stream_loader(int fd, unsigned parts);
+    Stream_loader(const Stream_loader& object) = delete;
+    Stream_loader& operator=(const Stream_loader& object) = delete;
+
+    std::error_code load(Sparse_image& image);
+
+    // Bytes taken from the stream so far.
+    std::uint64_t position() const { return position_; }
+
+private:
+    std::error_code advance(Sparse_image& image, std::uint64_t end, bool keep);
+
+    int fd_;
+    unsigned parts_;
+    std::uint64_t position_;
+    std::vector<std::uint8_t> scratch_;
+};
+
+} // namespace ELF
+
+#endif // STREAM_LOADER_H
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fnmatch.h>
+#include <limits>
+#include <strings.h>
+#include "Symbol_filter.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+struct Symbol_attribute
+{
+    const char *name;
+    unsigned value;
+};
+
+const Symbol_attribute symbol_types[] = {
+    {"NOTYPE",  STT_NOTYPE},
+    {"OBJECT",  STT_OBJECT},
+    {"FUNC",    STT_FUNC},
+    {"SECTION", STT_SECTION},
+    {"FILE",    STT_FILE},
+    {"COMMON",  STT_COMMON},
+    {"TLS",     STT_TLS},
+    {"IFUNC",   STT_GNU_IFUNC},
+};
+
+const Symbol_attribute symbol_binds[] = {
+    {"LOCAL",   STB_LOCAL},
+    {"GLOBAL",  STB_GLOBAL},
+    {"WEAK",    STB_WEAK},
+    {"UNIQUE",  STB_GNU_UNIQUE},
+};
+
+template <std::size_t N>
+bool parse_mask(const std::string& list, const Symbol_attribute (&attributes)[N], std::uint32_t& mask)
+{
+    std::uint32_t result = 0;
+    std::size_t start = 0;
+
+    while (start <= list.size())
+    {
+        std::size_t end = list.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        std::string item = list.substr(start, end - start);
+        start = end + 1;
+
+        const Symbol_attribute *found = std::find_if(std::begin(attributes), std::end(attributes),
+            [&item](const Symbol_attribute& attribute) { return ::strcasecmp(attribute.name, item.c_str()) == 0; });
+        if (found != std::end(attributes))
+        {
+            result |= 1u << found->value;
+            continue;
+        }
+
+        char *number_end;
+        unsigned long number = std::strtoul(item.c_str(), &number_end, 0);
+        if (item.empty() || *number_end != '\0' || number > 15)
+        {
+            return false;
+        }
+        result |= 1u << number;
+    }
+
+    mask = result;
+    return true;
+}
+
+} // namespace
+
+Symbol_filter::Symbol_filter()
+    : type_mask(~0u), bind_mask(~0u), address_low(0),
+    address_high(std::numeric_limits<Elf64_Addr>::max()) { }
+
+bool Symbol_filter::empty() const
+{
+    return type_mask == ~0u && bind_mask == ~0u && section.empty() && name_pattern.empty() &&
+           address_low == 0 && address_high == std::numeric_limits<Elf64_Addr>::max();
+}
+
+bool Symbol_filter::set_types(const std::string& list)
+{
+    return parse_mask(list, symbol_types, type_mask);
+}
+
+bool Symbol_filter::set_binds(const std::string& list)
+{
+    return parse_mask(list, symbol_binds, bind_mask);
+}
+
+bool Symbol_filter::set_address_range(const std::string& range)
+{
+    char *end;
+    const char *text = range.c_str();
+
+    Elf64_Addr low = std::strtoull(text, &end, 0);
+    if (end == text || *end != '-')
+    {
+        return false;
+    }
+    text = end + 1;
+    Elf64_Addr high = std::strtoull(text, &end, 0);
+    if (end == text || *end != '\0' || high < low)
+    {
+        return false;
+    }
+
+    address_low = low;
+    address_high = high;
+    return true;
+}
+
+const char *symbol_type_name(unsigned type)
+{
+    for (const Symbol_attribute& attribute : symbol_types)
+    {
+        if (attribute.value == type)
+        {
+            return attribute.name;
+        }
+    }
+    return "Unknown";
+}
+
+const char *symbol_bind_name(unsigned bind)
+{
+    for (const Symbol_attribute& attribute : symbol_binds)
+    {
+        if (attribute.value == bind)
+        {
+            return attribute.name;
+        }
+    }
+    return "Unknown";
+}
+
+Name_matcher::Name_matcher(const std::string& pattern)
+    : pattern_(pattern), prefix_length_(pattern.find_first_of("*?[\\")),
+    literal_(prefix_length_ == std::string::npos)
+{
+    if (literal_)
+    {
+        prefix_length_ = pattern_.size();
+    }
+}
+
+bool Name_matcher::operator()(const char *name) const
+{
+    return std::strncmp(name, pattern_.c_str(), prefix_length_) == 0 && match_rest(name);
+}
+
+bool Name_matcher::match_rest(const char *name) const
+{
+    if (literal_)
+    {
+        return name[prefix_length_] == '\0';
+    }
+    return ::fnmatch(pattern_.c_str(), name, 0) == 0;
+}
+
+} // namespace ELF
@@ -0,0 +1,82 @@
+#ifndef SYMBOL_FILTER_H
+#define SYMBOL_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <elf.h>
+
+namespace ELF
+{
+
+/*
+* Selects a slice of a symbol table.  Every criterion left at its default accepts all
+* symbols; a symbol is selected when it passes all of them.
+*/
+struct Symbol_filter
+{
+    std::uint32_t type_mask;    // bit n accepts ELF64_ST_TYPE(st_info) == n
+    std::uint32_t bind_mask;    // bit n accepts ELF64_ST_BIND(st_info) == n
+    std::string section;        // section name, section index, UND, ABS or COM
+    std::string name_pattern;   // fnmatch(3) glob on the symbol name
+    Elf64_Addr address_low;     // st_value range, both ends inclusive
+    Elf64_Addr address_high;
+
+    Symbol_filter();
+
+    bool empty() const;
+
+    /*
+    * Parse the command line spelling of a criterion: comma separated type or bind names as
+    * printed by show_symbols() (FUNC,OBJECT / GLOBAL,WEAK) and an address range LOW-HIGH.
+    * Return false if the text is not understood.
+    */
+    bool set_types(const std::string& list);
+    bool set_binds(const std::string& list);
+    bool set_address_range(const std::string& range);
+};
+
+/*
+* The fixed-field part of a Symbol_filter resolved against one file: the section is now an
+* index, and the address range is stored as low + span so one unsigned compare tests it.
+*/
+struct Symbol_predicate
+{
+    std::uint32_t type_mask;
+    std::uint32_t bind_mask;
+    bool any_section;
+    std::uint16_t section_index;
+    Elf64_Addr address_low;
+    Elf64_Addr address_span;
+};
+
+// Names of symbol types and bindings as accepted by Symbol_filter, or "Unknown".
+const char *symbol_type_name(unsigned type);
+const char *symbol_bind_name(unsigned bind);
+
+/*
+* Matches symbol names against a glob.  The literal prefix of the pattern is compared
+* before fnmatch(3) runs, which rejects most names without entering the matcher.
+*/
+class Name_matcher
+{
+public:
+    explicit Name_matcher(const std::string& pattern);
+
+    bool operator()(const char *name) const;
+
+    // The literal characters every match starts with.
+    std::string prefix() const { return pattern_.substr(0, prefix_length_); }
+
+    // Match a name already known to start with prefix().
+    bool match_rest(const char *name) const;
+
+private:
+    std::string pattern_;
+    std::size_t prefix_length_;
+    bool literal_;
+};
+
+} // namespace ELF
+
+#endif // SYMBOL_FILTER_H
@@ -0,0 +1,446 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Arena.h"
+#include "ELF_reader.h"
+#include "Symbol_index.h"
+
+namespace ELF
+{
+
+namespace
+{
+
+const char INDEX_MAGIC[] = "readelf-symbol-index 1\n";
+
+// Output buffer of the index writer.
+const std::size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+struct Index_entry
+{
+    const char *name;           // in the arena of the worker that found it
+    std::uint32_t file;
+    bool defined;
+};
+
+struct Worker_result
+{
+    Arena names;
+    std::vector<Index_entry> entries;
+    std::size_t elf_files = 0;
+    std::size_t failed_files = 0;
+};
+
+/*
+* Collect the regular files under root_path into files, staying on the device of root_path
+* so that /proc, /sys and other mounts inside a root file system are not entered.  Paths
+* with a tab or a newline are left out: the path is the last field of an index line.
+*/
+std::error_code walk_tree(const std::string& root_path, std::vector<std::string>& files)
+{
+    struct stat st;
+    if (root_path.find_first_of("\t\n") != std::string::npos)
+    {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+    if (::lstat(root_path.c_str(), &st) == -1)
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    if (S_ISREG(st.st_mode))
+    {
+        files.push_back(root_path);
+        return std::error_code();
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        return std::make_error_code(std::errc::not_a_directory);
+    }
+
+    dev_t device = st.st_dev;
+    std::vector<std::string> directories{root_path};
+    while (!directories.empty())
+    {
+        std::string directory = std::move(directories.back());
+        directories.pop_back();
+
+        DIR *stream = ::opendir(directory.c_str());
+        if (stream == nullptr)
+        {
+            continue;           // unreadable directories are skipped, like find(1) does
+        }
+        if (directory.back() != '/')
+        {
+            directory += '/';
+        }
+
+        struct dirent *entry;
+        while ((entry = ::readdir(stream)) != nullptr)
+        {
+            const char *name = entry->d_name;
+            if ((name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) ||
+                std::strpbrk(name, "\t\n") != nullptr)
+            {
+                continue;
+            }
+
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN || type == DT_DIR)
+            {
+                if (::fstatat(::dirfd(stream), name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+                {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+                if (type == DT_DIR && st.st_dev != device)
+                {
+                    continue;
+                }
+            }
+
+            if (type == DT_DIR)
+                directories.push_back(directory + name);
+            else if (type == DT_REG)
+                files.push_back(directory + name);
+        }
+        ::closedir(stream);
+    }
+    return std::error_code();
+}
+
+// Compare the first four bytes of a file with the ELF magic without mapping it.
+bool has_elf_magic(const std::string& file_path)
+{
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    unsigned char magic[SELFMAG];
+    ssize_t length = ::pread(fd, magic, SELFMAG, 0);
+    ::close(fd);
+    return length == SELFMAG && std::memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+/*
+* Global and weak symbols of every type but sections and source files: the definitions and
+* imports other files link against.
+*/
+Symbol_filter linked_symbols()
+{
+    Symbol_filter filter;
+    filter.type_mask &= ~(1u << STT_SECTION | 1u << STT_FILE);
+    filter.bind_mask &= ~(1u << STB_LOCAL);
+    return filter;
+}
+
+const Symbol_filter LINKED_SYMBOLS = linked_symbols();
+
+/*
+* Add the global definitions and the imports of every dynamic symbol table of reader to
+* result.  Names that could not be written as one field of an index line are left out.
+*/
+void scan_dynamic_symbols(const ELF_reader& reader, std::uint32_t file, Worker_result& result)
+{
+    for (std::size_t i = 0, section_count = reader.section_number(); i < section_count; ++i)
+    {
+        const Elf64_Shdr *section = reader.section_header(i);
+        if (section->sh_type != SHT_DYNSYM)
+        {
+            continue;
+        }
+
+        const Elf64_Sym *symbol_table = reinterpret_cast<const Elf64_Sym *>(reader.section_data(i));
+        for (std::uint32_t j : reader.select_symbols(i, LINKED_SYMBOLS))
+        {
+            std::size_t length;
+            const char *name = reader.string_at(section->sh_link, symbol_table[j].st_name, length);
+            if (length == 0 ||
+                std::any_of(name, name + length, [](char c) { return static_cast<unsigned char>(c) < ' '; }))
+            {
+                continue;
+            }
+
+            result.entries.push_back(Index_entry{result.names.copy_string(name, length), file,
+                                                 symbol_table[j].st_shndx != SHN_UNDEF});
+        }
+    }
+}
+
+/*
+* Compare the name field of the index line at line, which ends at the first tab, with name.
+* The end of either string sorts before any character, as with strcmp().
+*/
+int compare_name(const char *line, const char *end, const std::string& name)
+{
+    for (std::size_t i = 0; ; ++i, ++line)
+    {
+        bool line_ends = line == end || *line == '\t' || *line == '\n';
+        bool name_ends = i == name.size();
+        if (line_ends || name_ends)
+        {
+            return line_ends == name_ends ? 0 : line_ends ? -1 : 1;
+        }
+        unsigned char a = *line;
+        unsigned char b = name[i];
+        if (a != b)
+        {
+            return a < b ? -1 : 1;
+        }
+    }
+}
+
+} // namespace
+
+std::error_code build_symbol_index(const std::string& root_path, const std::string& index_path,
+                                   unsigned worker_number, Index_statistics& statistics)
+{
+    std::vector<std::string> files;
+    std::error_code error = walk_tree(root_path, files);
+    statistics = Index_statistics{files.size(), 0, 0, 0};
+    if (error)
+    {
+        return error;
+    }
+
+    /*
+    * Files are handed out one at a time from a shared counter; each worker keeps its own
+    * entries and copies of the names, so nothing is locked while scanning.
+    */
+    worker_number = std::max(1u, std::min<unsigned>(worker_number, files.size() == 0 ? 1 : files.size()));
+    std::vector<Worker_result> results(worker_number);
+    std::atomic<std::size_t> next_file{0};
+    auto work = [&](Worker_result& result) {
+        ELF_reader reader;
+        std::size_t file;
+        while ((file = next_file.fetch_add(1, std::memory_order_relaxed)) < files.size())
+        {
+            if (!has_elf_magic(files[file]))
+            {
+                continue;
+            }
+            ++result.elf_files;
+            if (reader.load_file(files[file]))
+            {
+                ++result.failed_files;
+                continue;
+            }
+            scan_dynamic_symbols(reader, static_cast<std::uint32_t>(file), result);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < worker_number; ++i)
+    {
+        workers.emplace_back(work, std::ref(results[i]));
+    }
+    work(results[0]);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    std::size_t entry_number = 0;
+    for (const auto& result : results)
+    {
+        entry_number += result.entries.size();
+        statistics.elf_files += result.elf_files;
+        statistics.failed_files += result.failed_files;
+    }
+    std::vector<Index_entry> entries;
+    entries.reserve(entry_number);
+    for (const auto& result : results)
+    {
+        entries.insert(entries.end(), result.entries.begin(), result.entries.end());
+    }
+
+    // Name, then definitions before imports, then path: the order of the lines in the file.
+    std::sort(entries.begin(), entries.end(), [&](const Index_entry& a, const Index_entry& b) {
+        int order = std::strcmp(a.name, b.name);
+        if (order != 0)
+            return order < 0;
+        if (a.defined != b.defined)
+            return a.defined;
+        return files[a.file] < files[b.file];
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Index_entry& a, const Index_entry& b) {
+        return a.file == b.file && a.defined == b.defined && std::strcmp(a.name, b.name) == 0;
+    }), entries.end());
+    statistics.entries = entries.size();
+
+    std::string temporary_path = index_path + ".tmp";
+    std::FILE *out = std::fopen(temporary_path.c_str(), "w");
+    if (out == nullptr)
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    std::vector<char> buffer(WRITE_BUFFER_SIZE);
+    std::setvbuf(out, buffer.data(), _IOFBF, buffer.size());
+
+    std::fputs(INDEX_MAGIC, out);
+    for (const Index_entry& entry : entries)
+    {
+        std::fputs(entry.name, out);
+        std::fputs(entry.defined ? "\tD\t" : "\tU\t", out);
+        std::fputs(files[entry.file].c_str(), out);
+        std::fputc('\n', out);
+    }
+
+    bool failed = std::ferror(out) != 0;
+    int saved_errno = errno;
+    if (std::fclose(out) != 0 && !failed)
+    {
+        failed = true;
+        saved_errno = errno;
+    }
+    if (failed || ::rename(temporary_path.c_str(), index_path.c_str()) == -1)
+    {
+        error.assign(failed ? saved_errno : errno, std::system_category());
+        ::unlink(temporary_path.c_str());
+    }
+    return error;
+}
+
+Symbol_index::Symbol_index()
+    : data_(nullptr), length_(0), body_(0) { }
+
+Symbol_index::~Symbol_index()
+{
+    close();
+}
+
+std::error_code Symbol_index::open(const std::string& index_path)
+{
+    std::error_code error;
+    struct stat st;
+
+    close();
+    int fd = ::open(index_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return std::error_code(errno, std::system_category());
+    }
+    if (::fstat(fd, &st) == -1)
+    {
+        error.assign(errno, std::system_category());
+        ::close(fd);
+        return error;
+    }
+
+    std::size_t length = static_cast<std::size_t>(st.st_size);
+    std::size_t magic_length = sizeof(INDEX_MAGIC) - 1;
+    if (length < magic_length)
+    {
+        ::close(fd);
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    void *mmap_res = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mmap_res == MAP_FAILED)
+    {
+        error.assign(errno, std::system_category());
+        ::close(fd);
+        return error;
+    }
+    ::close(fd);
+
+    data_ = static_cast<const char *>(mmap_res);
+    length_ = length;
+    body_ = magic_length;
+    if (std::memcmp(data_, INDEX_MAGIC, magic_length) != 0)
+    {
+        close();
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+    return error;
+}
+
+void Symbol_index::close()
+{
+    if (data_ != nullptr)
+    {
+        ::munmap(const_cast<char *>(data_), length_);
+    }
+    data_ = nullptr;
+    length_ = body_ = 0;
+}
+
+std::vector<Symbol_index::Entry> Symbol_index::find(const std::string& name) const
+{
+    std::vector<Entry> entries;
+    if (data_ == nullptr)
+    {
+        return entries;
+    }
+
+    /*
+    * Lower bound over the lines: low and high are always line starts.  A probe backs up from
+    * the middle byte to the start of its line, so each step reads about one line.
+    */
+    const char *end = data_ + length_;
+    const char *low = data_ + body_;
+    const char *high = end;
+    while (low < high)
+    {
+        const char *middle = low + (high - low) / 2;
+        while (middle > low && middle[-1] != '\n')
+        {
+            --middle;
+        }
+
+        if (compare_name(middle, end, name) < 0)
+        {
+            const char *line_end = static_cast<const char *>(std::memchr(middle, '\n', end - middle));
+            low = line_end == nullptr ? end : line_end + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    for (const char *line = low; line < end && compare_name(line, end, name) == 0; )
+    {
+        const char *line_end = static_cast<const char *>(std::memchr(line, '\n', end - line));
+        if (line_end == nullptr)
+        {
+            line_end = end;
+        }
+
+        // NAME \t D|U \t PATH
+        const char *kind = line + name.size() + 1;
+        if (line_end - kind > 2 && kind[1] == '\t')
+        {
+            entries.push_back(Entry{kind[0] == 'D', std::string(kind + 2, line_end)});
+        }
+        line = line_end + 1;
+    }
+    return entries;
+}
+
+void Symbol_index::show_lookup(const std::string& name, std::FILE *out) const
+{
+    std::vector<Entry> entries = find(name);
+    std::size_t defined = std::count_if(entries.begin(), entries.end(), [](const Entry& entry) {
+        return entry.defined;
+    });
+
+    fprintf(out, "\nSymbol '%s' is defined in %lu and imported by %lu %s:\n", name.c_str(), defined,
+            entries.size() - defined, entries.size() - defined == 1 ? "file" : "files");
+    for (const Entry& entry : entries)
+    {
+        fprintf(out, "  %-8s  %s\n", entry.defined ? "defines" : "imports", entry.file_path.c_str());
+    }
+}
+
+} // namespace ELF
@@ -0,0 +1,80 @@
+#ifndef SYMBOL_INDEX_H
+#define SYMBOL_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace ELF
+{
+
+/*
+* Counts reported by build_symbol_index().
+*/
+struct Index_statistics
+{
+    std::size_t files;          // regular files seen by the walk
+    std::size_t elf_files;      // files that passed the magic check
+    std::size_t failed_files;   // ELF files that could not be loaded (32-bit, truncated, ...)
+    std::size_t entries;        // lines written to the index
+};
+
+/*
+* Walk the tree under root_path without following symbolic links, and scan the .dynsym of
+* every 64-bit ELF file in it with worker_number threads.  Files are opened and their first
+* four bytes compared with the ELF magic before anything is mapped, so the rest of a root
+* file system costs one read each.
+*
+* The result is written to index_path as text, one line per (symbol, file) pair sorted by
+* symbol name:
+*
+*     NAME \t D|U \t PATH
+*
+* D marks a global or weak definition and U an undefined (imported) symbol.  The first line
+* identifies the format.  Files whose path holds a tab or a newline are not indexed, and a
+* root_path holding one is refused.  The file is written next to index_path and renamed over it, so a
+* reader never sees a partial index.
+*/
+std::error_code build_symbol_index(const std::string& root_path, const std::string& index_path,
+                                   unsigned worker_number, Index_statistics& statistics);
+
+/*
+* A mapped index written by build_symbol_index().  Lookups binary search the sorted lines in
+* place; nothing is read into memory beforehand, so opening even a large index is instant.
+*/
+class Symbol_index
+{
+public:
+    struct Entry
+    {
+        bool defined;
+        std::string file_path;
+    };
+
+    Symbol_index();
+    Symbol_index(const Symbol_index& object) = delete;
+    Symbol_index& operator=(const Symbol_index& object) = delete;
+    ~Symbol_index();
+
+    std::error_code open(const std::string& index_path);
+
+    // The files that define or import name, definitions first, each group sorted by path.
+    std::vector<Entry> find(const std::string& name) const;
+
+    // Print the result of find() for name, as readelf --lookup does.
+    void show_lookup(const std::string& name, std::FILE *out = stdout) const;
+
+private:
+    void close();
+
+    const char *data_;
+    std::size_t length_;
+    std::size_t body_;          // offset of the first entry line
+};
+
+} // namespace ELF
+
+#endif // SYMBOL_INDEX_H
@@ -1,13 +1,467 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Benchmark.h"
 #include "ELF_reader.h"
+#include "File_watcher.h"
+#include "Query_server.h"
+#include "Symbol_index.h"
 
-int main()
+namespace
+{
+
+enum Long_option
+{
+    OPTION_BUILD_ID = 256,
+    OPTION_SERVER,
+    OPTION_CACHE_SIZE,
+    OPTION_WORKERS,
+    OPTION_SYMBOL_TYPE,
+    OPTION_SYMBOL_BIND,
+    OPTION_SYMBOL_SECTION,
+    OPTION_SYMBOL_NAME,
+    OPTION_SYMBOL_ADDRESS,
+    OPTION_SYMBOL_HISTOGRAM,
+    OPTION_SIZE_REPORT,
+    OPTION_LOADER,
+    OPTION_BENCHMARK,
+    OPTION_DUMP_RANGE,
+    OPTION_BUILD_INDEX,
+    OPTION_INDEX,
+    OPTION_LOOKUP,
+};
+
+// Files at least this large are read with the region loader when --loader=auto.
+const off_t LARGE_FILE = off_t(1) << 30;
+
+enum class Loader
+{
+    automatic,
+    mmap,
+    read,
+};
+
+// Parse "L-H", both ends inclusive, into a start and a length.
+bool parse_range(const char *text, std::uint64_t& start, std::uint64_t& length)
+{
+    char *end;
+    std::uint64_t low = std::strtoull(text, &end, 0);
+    if (end == text || *end != '-')
+    {
+        return false;
+    }
+    text = end + 1;
+    std::uint64_t high = std::strtoull(text, &end, 0);
+    if (end == text || *end != '\0' || high < low)
+    {
+        return false;
+    }
+
+    start = low;
+    length = high - low == UINT64_MAX ? UINT64_MAX : high - low + 1;
+    return true;
+}
+
+// Parse a count of at most maximum, in decimal, hex or octal as strtoul reads it.
+bool parse_count(const char *text, std::size_t maximum, std::size_t& count)
+{
+    char *end;
+    errno = 0;
+    unsigned long number = std::strtoul(text, &end, 0);
+    if (end == text || *end != '\0' || errno != 0 || !std::isdigit(static_cast<unsigned char>(text[0])) ||
+        number > maximum)
+    {
+        return false;
+    }
+    count = number;
+    return true;
+}
+
+void usage(std::FILE *out)
+{
+    fprintf(out,
+            "Usage: readelf <option(s)> elf-file(s)\n"
+            "       readelf --server=SOCKET [--cache-size=N] [--workers=N]\n"
+            "       readelf [--build-index=DIR] [--index=FILE] [--lookup=SYMBOL]... [--workers=N]\n"
+            " Display information about the contents of ELF format files\n"
+            " An elf-file of - is read from standard input\n"
+            " Options are:\n"
+            "  -a --all               Equivalent to: -h -S -s\n"
+            "  -h --file-header       Display the ELF file header\n"
+            "  -S --section-headers   Display the sections' header\n"
+            "  -s --symbols           Display the symbol table\n"
+            "     --build-id          Display the GNU build ID note\n"
+            "  -x --hex-dump=S        Dump the contents of section S (name or index) as bytes\n"
+            "  -p --string-dump=S     Dump the contents of section S (name or index) as strings\n"
+            "     --dump-range=L-H    Only dump bytes L to H of the section, both inclusive\n"
+            "     --sym-type=T[,T]    Only show symbols of these types (FUNC, OBJECT, ...)\n"
+            "     --sym-bind=B[,B]    Only show symbols with these bindings (LOCAL, GLOBAL, WEAK)\n"
+            "     --sym-section=S     Only show symbols defined in section S (name, index, UND, ABS, COM)\n"
+            "     --sym-name=GLOB     Only show symbols whose name matches GLOB\n"
+            "     --sym-address=L-H   Only show symbols whose value lies in [L, H]\n"
+            "     --sym-histogram     Count symbols per type, binding and section\n"
+            "     --size-report[=N]   Bytes per section and source file, and the N largest symbols (default 20)\n"
+            "     --loader=L          Load files with mmap, read (io_uring or pread) or auto (default:\n"
+            "                         read for files of 1 GiB or more)\n"
+            "     --benchmark         Time the loaders on each file instead of printing it\n"
+            "     --server=SOCKET     Answer queries on a Unix domain socket\n"
+            "     --cache-size=N      Number of files the server keeps mapped (default 64)\n"
+            "     --workers=N         Number of server or indexing threads (default: one per CPU)\n"
+            "     --build-index=DIR   Index the dynamic symbols of every ELF file under DIR\n"
+            "     --index=FILE        The symbol index to write or read (default readelf.index)\n"
+            "     --lookup=SYMBOL     List the indexed files that define or import SYMBOL\n"
+            "  -w --watch             Print again whatever changes each time the file is rebuilt\n"
+            "  -H --help              Display this information\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
 {
     using ELF::ELF_reader;
 
-    ELF_reader s("./readelf");
+    static const struct option long_options[] = {
+        {"all",             no_argument,       nullptr, 'a'},
+        {"file-header",     no_argument,       nullptr, 'h'},
+        {"section-headers", no_argument,       nullptr, 'S'},
+        {"symbols",         no_argument,       nullptr, 's'},
+        {"build-id",        no_argument,       nullptr, OPTION_BUILD_ID},
+        {"hex-dump",        required_argument, nullptr, 'x'},
+        {"string-dump",     required_argument, nullptr, 'p'},
+        {"dump-range",      required_argument, nullptr, OPTION_DUMP_RANGE},
+        {"sym-type",        required_argument, nullptr, OPTION_SYMBOL_TYPE},
+        {"sym-bind",        required_argument, nullptr, OPTION_SYMBOL_BIND},
+        {"sym-section",     required_argument, nullptr, OPTION_SYMBOL_SECTION},
+        {"sym-name",        required_argument, nullptr, OPTION_SYMBOL_NAME},
+        {"sym-address",     required_argument, nullptr, OPTION_SYMBOL_ADDRESS},
+        {"sym-histogram",   no_argument,       nullptr, OPTION_SYMBOL_HISTOGRAM},
+        {"size-report",     optional_argument, nullptr, OPTION_SIZE_REPORT},
+        {"loader",          required_argument, nullptr, OPTION_LOADER},
+        {"benchmark",       no_argument,       nullptr, OPTION_BENCHMARK},
+        {"server",          required_argument, nullptr, OPTION_SERVER},
+        {"cache-size",      required_argument, nullptr, OPTION_CACHE_SIZE},
+        {"workers",         required_argument, nullptr, OPTION_WORKERS},
+        {"build-index",     required_argument, nullptr, OPTION_BUILD_INDEX},
+        {"index",           required_argument, nullptr, OPTION_INDEX},
+        {"lookup",          required_argument, nullptr, OPTION_LOOKUP},
+        {"watch",           no_argument,       nullptr, 'w'},
+        {"help",            no_argument,       nullptr, 'H'},
+        {nullptr,           0,                 nullptr, 0}
+    };
+
+    bool show_file_header = false;
+    bool show_section_headers = false;
+    bool show_symbols = false;
+    bool show_build_id = false;
+    bool show_symbol_histogram = false;
+    bool show_size_report = false;
+    std::size_t top_symbol_number = ELF::SIZE_REPORT_TOP;
+    ELF::Symbol_filter symbol_filter;
+    std::vector<std::pair<int, std::string>> dumps;     // ('x' or 'p', section)
+    std::uint64_t dump_start = 0;
+    std::uint64_t dump_length = UINT64_MAX;
+    Loader loader = Loader::automatic;
+    bool benchmark = false;
+    bool watch = false;
+    std::string socket_path;
+    std::size_t cache_size = 64;
+    unsigned workers = std::thread::hardware_concurrency();
+    std::string index_root;
+    std::string index_path = "readelf.index";
+    std::vector<std::string> lookups;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "ahSswHx:p:", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'a':
+            show_file_header = show_section_headers = show_symbols = true;
+            break;
+        case 'h':
+            show_file_header = true;
+            break;
+        case 'S':
+            show_section_headers = true;
+            break;
+        case 's':
+            show_symbols = true;
+            break;
+        case OPTION_BUILD_ID:
+            show_build_id = true;
+            break;
+        case 'x':
+        case 'p':
+            dumps.emplace_back(option, optarg);
+            break;
+        case OPTION_DUMP_RANGE:
+            if (!parse_range(optarg, dump_start, dump_length))
+            {
+                fprintf(stderr, "readelf: Error: invalid dump range '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPTION_SYMBOL_TYPE:
+            show_symbols = true;
+            if (!symbol_filter.set_types(optarg))
+            {
+                fprintf(stderr, "readelf: Error: invalid symbol type list '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPTION_SYMBOL_BIND:
+            show_symbols = true;
+            if (!symbol_filter.set_binds(optarg))
+            {
+                fprintf(stderr, "readelf: Error: invalid symbol binding list '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPTION_SYMBOL_SECTION:
+            show_symbols = true;
+            symbol_filter.section = optarg;
+            break;
+        case OPTION_SYMBOL_NAME:
+            show_symbols = true;
+            symbol_filter.name_pattern = optarg;
+            break;
+        case OPTION_SYMBOL_ADDRESS:
+            show_symbols = true;
+            if (!symbol_filter.set_address_range(optarg))
+            {
+                fprintf(stderr, "readelf: Error: invalid address range '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPTION_SYMBOL_HISTOGRAM:
+            show_symbol_histogram = true;
+            break;
+        case OPTION_SIZE_REPORT:
+            show_size_report = true;
+            if (optarg != nullptr && !parse_count(optarg, ELF::SIZE_REPORT_MAX_TOP, top_symbol_number))
+            {
+                fprintf(stderr, "readelf: Error: symbol count must be a number of at most %lu: '%s'\n",
+                        ELF::SIZE_REPORT_MAX_TOP, optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPTION_LOADER:
+            if (std::strcmp(optarg, "auto") == 0)
+                loader = Loader::automatic;
+            else if (std::strcmp(optarg, "mmap") == 0)
+                loader = Loader::mmap;
+            else if (std::strcmp(optarg, "read") == 0)
+                loader = Loader::read;
+            else
+            {
+                fprintf(stderr, "readelf: Error: unknown loader '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case OPTION_BENCHMARK:
+            benchmark = true;
+            break;
+        case OPTION_SERVER:
+            socket_path = optarg;
+            break;
+        case OPTION_CACHE_SIZE:
+            cache_size = std::strtoul(optarg, nullptr, 0);
+            break;
+        case OPTION_WORKERS:
+            workers = static_cast<unsigned>(std::strtoul(optarg, nullptr, 0));
+            break;
+        case OPTION_BUILD_INDEX:
+            index_root = optarg;
+            break;
+        case OPTION_INDEX:
+            index_path = optarg;
+            break;
+        case OPTION_LOOKUP:
+            lookups.push_back(optarg);
+            break;
+        case 'w':
+            watch = true;
+            break;
+        case 'H':
+            usage(stdout);
+            return EXIT_SUCCESS;
+        default:
+            usage(stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!socket_path.empty())
+    {
+        ELF::Query_server server(socket_path, cache_size, workers);
+        if (server.run() == -1)
+        {
+            perror(socket_path.c_str());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (!index_root.empty() || !lookups.empty())
+    {
+        if (!index_root.empty())
+        {
+            ELF::Index_statistics statistics;
+            std::error_code error = ELF::build_symbol_index(index_root, index_path, workers, statistics);
+            if (error)
+            {
+                fprintf(stderr, "readelf: Error: '%s': %s\n", index_root.c_str(), error.message().c_str());
+                return EXIT_FAILURE;
+            }
+            fprintf(stderr, "readelf: Indexed %lu ELF files of %lu files (%lu not readable), %lu entries in '%s'\n",
+                    statistics.elf_files, statistics.files, statistics.failed_files, statistics.entries,
+                    index_path.c_str());
+        }
+
+        ELF::Symbol_index index;
+        std::error_code error = lookups.empty() ? std::error_code() : index.open(index_path);
+        if (error)
+        {
+            fprintf(stderr, "readelf: Error: '%s': %s\n", index_path.c_str(), error.message().c_str());
+            return EXIT_FAILURE;
+        }
+        for (const auto& symbol : lookups)
+        {
+            index.show_lookup(symbol);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (watch)
+    {
+        if (argc - optind != 1)
+        {
+            fprintf(stderr, "readelf: Error: --watch takes exactly one file\n");
+            return EXIT_FAILURE;
+        }
+
+        ELF::File_watcher::Options options{show_file_header, show_section_headers, show_symbols, symbol_filter};
+        if (!(show_file_header || show_section_headers || show_symbols))
+        {
+            options.section_headers = true;
+        }
+        ELF::File_watcher watcher(argv[optind], options);
+        watcher.run();
+        perror("inotify");
+        return EXIT_FAILURE;
+    }
+
+    if (benchmark && optind != argc &&
+        !(show_file_header || show_section_headers || show_symbols || show_build_id || show_symbol_histogram ||
+          show_size_report || !dumps.empty()))
+    {
+        show_section_headers = show_symbols = true;
+    }
+
+    if (optind == argc ||
+        !(show_file_header || show_section_headers || show_symbols || show_build_id || show_symbol_histogram ||
+          show_size_report || !dumps.empty()))
+    {
+        usage(stderr);
+        return EXIT_FAILURE;
+    }
+
+    // What a loader that does not map the whole file has to keep for the options given.
+    unsigned load_parts = 0;
+    if (show_section_headers)
+        load_parts |= ELF::load_section_headers;
+    if (show_symbols || show_symbol_histogram || show_size_report)
+        load_parts |= ELF::load_symbols;
+    if (show_build_id)
+        load_parts |= ELF::load_notes;
+    if (!dumps.empty())
+        load_parts |= ELF::load_contents;
+
+    auto show = [&](const ELF_reader& reader, std::FILE *out) {
+        if (show_file_header)
+            reader.show_file_header(out);
+        if (show_section_headers)
+            reader.show_section_headers(out);
+        if (show_symbols)
+            reader.show_symbols(symbol_filter, out);
+        if (show_build_id)
+            reader.show_build_id(out);
+        if (show_symbol_histogram)
+            reader.show_symbol_histogram(out);
+        if (show_size_report)
+            reader.show_size_report(top_symbol_number, out);
+
+        for (const auto& dump : dumps)
+        {
+            std::size_t index;
+            if (!reader.lookup_section(dump.second, index))
+            {
+                fprintf(stderr, "readelf: Warning: Section '%s' was not dumped because it does not exist\n",
+                        dump.second.c_str());
+            }
+            else if (dump.first == 'x')
+                reader.show_hex_dump(index, dump_start, dump_length, out);
+            else
+                reader.show_string_dump(index, dump_start, dump_length, out);
+        }
+    };
+
+    int status = EXIT_SUCCESS;
+    for (int i = optind; i < argc; ++i)
+    {
+        if (benchmark)
+        {
+            std::error_code error = ELF::run_benchmark(argv[i], load_parts, show);
+            if (error)
+            {
+                fprintf(stderr, "readelf: Error: '%s': %s\n", argv[i], error.message().c_str());
+                status = EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        struct stat st;
+        // A dump reads whole sections with the region loader, but only the range through a mapping.
+        bool read_regions = loader == Loader::read ||
+            (loader == Loader::automatic && dumps.empty() && ::stat(argv[i], &st) == 0 && S_ISREG(st.st_mode) &&
+             st.st_size >= LARGE_FILE);
+
+        ELF_reader reader;
+        if (std::strcmp(argv[i], "-") == 0)
+        {
+            reader.load_stream(STDIN_FILENO, argv[i], load_parts);
+        }
+        else if (read_regions)
+        {
+            ELF::Region_loader region_loader(load_parts);
+            reader.load_regions(argv[i], region_loader);
+        }
+        else
+        {
+            reader.load_file(argv[i]);
+        }
+        if (reader.error())
+        {
+            fprintf(stderr, "readelf: Error: '%s': %s\n", argv[i], reader.error().message().c_str());
+            status = EXIT_FAILURE;
+            continue;
+        }
 
-    s.show_file_header();
-    s.show_section_headers();
-    s.show_symbols();
-    return 0;
-}
\ No newline at end of file
+        if (argc - optind > 1)
+        {
+            printf("\nFile: %s\n", argv[i]);
+        }
+        show(reader, stdout);
+    }
+    return status;
+}
@@ -0,0 +1,220 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+#include "Elf_builder.h"
+
+namespace ELF
+{
+namespace test
+{
+
+namespace
+{
+
+std::size_t align_up(std::size_t value, std::size_t alignment)
+{
+    return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename T>
+void append(std::vector<std::uint8_t>& bytes, const T& value)
+{
+    const std::uint8_t *begin = reinterpret_cast<const std::uint8_t *>(&value);
+    bytes.insert(bytes.end(), begin, begin + sizeof(T));
+}
+
+/*
+* A string table that stores every distinct string once.  Offset 0 is the empty string.
+*/
+class String_table
+{
+public:
+    String_table() : bytes_(1, 0) { }
+
+    Elf64_Word add(const std::string& text)
+    {
+        if (text.empty())
+        {
+            return 0;
+        }
+        auto found = offsets_.find(text);
+        if (found != offsets_.end())
+        {
+            return found->second;
+        }
+
+        Elf64_Word offset = static_cast<Elf64_Word>(bytes_.size());
+        bytes_.insert(bytes_.end(), text.begin(), text.end());
+        bytes_.push_back(0);
+        offsets_.emplace(text, offset);
+        return offset;
+    }
+
+    const std::vector<std::uint8_t>& bytes() const { return bytes_; }
+
+private:
+    std::vector<std::uint8_t> bytes_;
+    std::map<std::string, Elf64_Word> offsets_;
+};
+
+} // namespace
+
+Elf_builder::Elf_builder(Elf64_Half type)
+    : type_(type), entry_(0), extended_(false) { }
+
+std::size_t Elf_builder::add_section(const std::string& name, Elf64_Word type, Elf64_Xword flags,
+                                     std::vector<std::uint8_t> contents, Elf64_Xword alignment,
+                                     Elf64_Xword entry_size, Elf64_Word link, Elf64_Word info)
+{
+    Section section;
+    std::memset(&section.header, 0, sizeof(section.header));
+    section.header.sh_type = type;
+    section.header.sh_flags = flags;
+    section.header.sh_size = contents.size();
+    section.header.sh_link = link;
+    section.header.sh_info = info;
+    section.header.sh_addralign = alignment;
+    section.header.sh_entsize = entry_size;
+    section.name = name;
+    section.contents = std::move(contents);
+
+    sections_.push_back(std::move(section));
+    return sections_.size();
+}
+
+std::size_t Elf_builder::add_symbol_table(const std::vector<std::string>& names, std::vector<Elf64_Sym> symbols)
+{
+    String_table strings;
+    std::vector<std::uint8_t> table;
+    Elf64_Word first_global = static_cast<Elf64_Word>(symbols.size());
+
+    for (std::size_t i = 0; i < symbols.size(); ++i)
+    {
+        symbols[i].st_name = strings.add(names[i]);
+        if (ELF64_ST_BIND(symbols[i].st_info) != STB_LOCAL && first_global == symbols.size())
+        {
+            first_global = static_cast<Elf64_Word>(i);
+        }
+        append(table, symbols[i]);
+    }
+
+    // .strtab goes right after .symtab, so its index is known before it is added.
+    std::size_t symbol_table_index = add_section(".symtab", SHT_SYMTAB, 0, std::move(table), 8,
+                                                 sizeof(Elf64_Sym), 0, first_global);
+    std::size_t string_table_index = add_section(".strtab", SHT_STRTAB, 0, strings.bytes());
+    sections_[symbol_table_index - 1].header.sh_link = static_cast<Elf64_Word>(string_table_index);
+    return symbol_table_index;
+}
+
+std::vector<std::uint8_t> Elf_builder::build() const
+{
+    std::vector<Elf64_Shdr> headers(1);
+    std::memset(&headers[0], 0, sizeof(headers[0]));
+    std::vector<std::uint8_t> image(sizeof(Elf64_Ehdr), 0);
+    String_table names;
+
+    for (const Section& section : sections_)
+    {
+        Elf64_Shdr header = section.header;
+        header.sh_name = names.add(section.name);
+        if (header.sh_type == SHT_NOBITS)
+        {
+            header.sh_offset = image.size();
+        }
+        else
+        {
+            image.resize(align_up(image.size(), header.sh_addralign), 0);
+            header.sh_offset = image.size();
+            image.insert(image.end(), section.contents.begin(), section.contents.end());
+        }
+        headers.push_back(header);
+    }
+
+    Elf64_Shdr name_table;
+    std::memset(&name_table, 0, sizeof(name_table));
+    name_table.sh_name = names.add(".shstrtab");
+    name_table.sh_type = SHT_STRTAB;
+    name_table.sh_offset = image.size();
+    name_table.sh_size = names.bytes().size();
+    name_table.sh_addralign = 1;
+    image.insert(image.end(), names.bytes().begin(), names.bytes().end());
+    headers.push_back(name_table);
+
+    std::size_t section_count = headers.size();
+    std::size_t name_table_index = section_count - 1;
+    Elf64_Ehdr file_header;
+    std::memset(&file_header, 0, sizeof(file_header));
+    std::memcpy(file_header.e_ident, ELFMAG, SELFMAG);
+    file_header.e_ident[EI_CLASS] = ELFCLASS64;
+    file_header.e_ident[EI_DATA] = ELFDATA2LSB;
+    file_header.e_ident[EI_VERSION] = EV_CURRENT;
+    file_header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    file_header.e_type = type_;
+    file_header.e_machine = EM_X86_64;
+    file_header.e_version = EV_CURRENT;
+    file_header.e_entry = entry_;
+    file_header.e_ehsize = sizeof(Elf64_Ehdr);
+    file_header.e_shentsize = sizeof(Elf64_Shdr);
+
+    if (extended_ || section_count >= SHN_LORESERVE)
+    {
+        headers[0].sh_size = section_count;
+        file_header.e_shnum = 0;
+    }
+    else
+    {
+        file_header.e_shnum = static_cast<Elf64_Half>(section_count);
+    }
+    if (extended_ || name_table_index >= SHN_LORESERVE)
+    {
+        headers[0].sh_link = static_cast<Elf64_Word>(name_table_index);
+        file_header.e_shstrndx = SHN_XINDEX;
+    }
+    else
+    {
+        file_header.e_shstrndx = static_cast<Elf64_Half>(name_table_index);
+    }
+
+    image.resize(align_up(image.size(), 8), 0);
+    file_header.e_shoff = image.size();
+    for (const Elf64_Shdr& header : headers)
+    {
+        append(image, header);
+    }
+    std::memcpy(image.data(), &file_header, sizeof(file_header));
+    return image;
+}
+
+bool Elf_builder::write(const std::string& file_path) const
+{
+    return write_image(file_path, build());
+}
+
+Elf64_Shdr& section_header(std::vector<std::uint8_t>& image, std::size_t index)
+{
+    const Elf64_Ehdr *file_header = reinterpret_cast<const Elf64_Ehdr *>(image.data());
+    return reinterpret_cast<Elf64_Shdr *>(image.data() + file_header->e_shoff)[index];
+}
+
+bool write_image(const std::string& file_path, const std::vector<std::uint8_t>& image)
+{
+    std::FILE *out = std::fopen(file_path.c_str(), "wb");
+    if (out == nullptr)
+    {
+        return false;
+    }
+
+    bool written = std::fwrite(image.data(), 1, image.size(), out) == image.size();
+    int saved_errno = errno;
+    if (std::fclose(out) != 0)
+    {
+        return false;
+    }
+    errno = saved_errno;
+    return written;
+}
+
+} // namespace test
+} // namespace ELF
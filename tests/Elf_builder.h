@@ -0,0 +1,76 @@
+#ifndef ELF_BUILDER_H
+#define ELF_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <elf.h>
+
+namespace ELF
+{
+namespace test
+{
+
+/*
+* Lays out small 64-bit little-endian x86-64 ELF files for the golden tests: the header,
+* the contents of every section in the order added, the section name string table, and the
+* section header table last.  Section 0 and .shstrtab are added by the builder.
+*
+* When there are SHN_LORESERVE sections or more, or extended numbering is asked for, the
+* count and the string table index move into section 0 (sh_size and sh_link) as the gABI
+* specifies, and e_shnum is 0 and e_shstrndx SHN_XINDEX.
+*/
+class Elf_builder
+{
+public:
+    explicit Elf_builder(Elf64_Half type = ET_REL);
+
+    std::size_t add_section(const std::string& name, Elf64_Word type, Elf64_Xword flags,
+                            std::vector<std::uint8_t> contents, Elf64_Xword alignment = 1,
+                            Elf64_Xword entry_size = 0, Elf64_Word link = 0, Elf64_Word info = 0);
+
+    /*
+    * Add .symtab and its .strtab from names and symbols, which must have the same length.
+    * symbols[i].st_name is filled in from names[i]; entry 0 should be the null symbol.
+    * Returns the index of .symtab.
+    */
+    std::size_t add_symbol_table(const std::vector<std::string>& names, std::vector<Elf64_Sym> symbols);
+
+    void set_entry(Elf64_Addr entry) { entry_ = entry; }
+    void set_extended_numbering(bool extended) { extended_ = extended; }
+
+    std::size_t section_number() const { return sections_.size() + 1; }
+
+    std::vector<std::uint8_t> build() const;
+
+    // Returns false with errno set if the file cannot be written.
+    bool write(const std::string& file_path) const;
+
+private:
+    struct Section
+    {
+        Elf64_Shdr header;
+        std::string name;
+        std::vector<std::uint8_t> contents;
+    };
+
+    Elf64_Half type_;
+    Elf64_Addr entry_;
+    bool extended_;
+    std::vector<Section> sections_;     // without section 0 and .shstrtab
+};
+
+/*
+* Header index of an image made by Elf_builder::build(), for tests that damage a file after
+* it is laid out.
+*/
+Elf64_Shdr& section_header(std::vector<std::uint8_t>& image, std::size_t index);
+
+// Returns false with errno set if the file cannot be written.
+bool write_image(const std::string& file_path, const std::vector<std::uint8_t>& image);
+
+} // namespace test
+} // namespace ELF
+
+#endif // ELF_BUILDER_H
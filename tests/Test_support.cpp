@@ -0,0 +1,332 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "Test_support.h"
+
+extern char **environ;
+
+namespace ELF
+{
+namespace test
+{
+
+namespace
+{
+
+int failed_checks = 0;
+
+// Append what is ready on fd to text; returns false at end of file or on error.
+bool drain(int fd, std::string& text)
+{
+    char buffer[65536];
+    ssize_t length;
+    while ((length = ::read(fd, buffer, sizeof(buffer))) == -1 && errno == EINTR)
+    {
+    }
+    if (length <= 0)
+    {
+        return false;
+    }
+    text.append(buffer, length);
+    return true;
+}
+
+} // namespace
+
+Run_result run(const std::vector<std::string>& arguments, const std::string& input_path)
+{
+    Run_result result;
+    result.status = -1;
+    result.signal = 0;
+    result.milliseconds = 0;
+
+    int output_fds[2];
+    int error_fds[2];
+    if (::pipe2(output_fds, O_CLOEXEC) == -1)
+    {
+        return result;
+    }
+    if (::pipe2(error_fds, O_CLOEXEC) == -1)
+    {
+        ::close(output_fds[0]);
+        ::close(output_fds[1]);
+        return result;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, input_path.empty() ? "/dev/null" : input_path.c_str(),
+                                     O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, output_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, error_fds[1], STDERR_FILENO);
+
+    std::vector<char *> argv;
+    for (const std::string& argument : arguments)
+    {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int error = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(output_fds[1]);
+    ::close(error_fds[1]);
+    if (error != 0)
+    {
+        ::close(output_fds[0]);
+        ::close(error_fds[0]);
+        return result;
+    }
+
+    struct pollfd fds[2] = {{output_fds[0], POLLIN, 0}, {error_fds[0], POLLIN, 0}};
+    std::string *texts[2] = {&result.output, &result.errors};
+    int open_count = 2;
+    while (open_count > 0)
+    {
+        if (::poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < 2; ++i)
+        {
+            if (fds[i].fd != -1 && fds[i].revents != 0 && !drain(fds[i].fd, *texts[i]))
+            {
+                ::close(fds[i].fd);
+                fds[i].fd = -1;
+                --open_count;
+            }
+        }
+    }
+    for (const struct pollfd& fd : fds)
+    {
+        if (fd.fd != -1)
+        {
+            ::close(fd.fd);
+        }
+    }
+
+    int status;
+    while (::waitpid(pid, &status, 0) == -1 && errno == EINTR)
+    {
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    result.milliseconds = elapsed.count();
+    if (WIFEXITED(status))
+    {
+        result.status = WEXITSTATUS(status);
+    }
+    else if (WIFSIGNALED(status))
+    {
+        result.signal = WTERMSIG(status);
+    }
+    return result;
+}
+
+pid_t start(const std::vector<std::string>& arguments, const std::string& output_path,
+            const std::string& errors_path)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output_path.empty() ? "/dev/null" : output_path.c_str(),
+                                     O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, errors_path.empty() ? "/dev/null" : errors_path.c_str(),
+                                     O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    std::vector<char *> argv;
+    for (const std::string& argument : arguments)
+    {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    return error == 0 ? pid : -1;
+}
+
+int stop(pid_t pid, int signal)
+{
+    if (pid <= 0)
+    {
+        return -1;
+    }
+    ::kill(pid, signal);
+    int status;
+    while (::waitpid(pid, &status, 0) == -1)
+    {
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int wait_for(pid_t pid, long timeout_ms)
+{
+    for (long waited = 0; ; waited += 10)
+    {
+        int status;
+        pid_t finished = ::waitpid(pid, &status, WNOHANG);
+        if (finished == pid)
+        {
+            return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+        if (finished == -1 && errno != EINTR)
+        {
+            return -1;
+        }
+        if (waited >= timeout_ms)
+        {
+            stop(pid, SIGKILL);
+            return -1;
+        }
+        pause_for(10);
+    }
+}
+
+long cpu_milliseconds(pid_t pid)
+{
+    std::string stat = read_file("/proc/" + std::to_string(pid) + "/stat");
+    // The command name may hold spaces; the fields after it are counted from its closing ')'.
+    std::size_t name_end = stat.rfind(')');
+    if (name_end == std::string::npos)
+    {
+        return -1;
+    }
+    unsigned long user_ticks, system_ticks;
+    if (std::sscanf(stat.c_str() + name_end + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                    &user_ticks, &system_ticks) != 2)
+    {
+        return -1;
+    }
+    return static_cast<long>((user_ticks + system_ticks) * 1000 / ::sysconf(_SC_CLK_TCK));
+}
+
+void pause_for(long milliseconds)
+{
+    struct timespec duration = {milliseconds / 1000, milliseconds % 1000 * 1000000};
+    while (::nanosleep(&duration, &duration) == -1 && errno == EINTR)
+    {
+    }
+}
+
+bool check(bool condition, const char *format, ...)
+{
+    if (condition)
+    {
+        return true;
+    }
+
+    ++failed_checks;
+    va_list arguments;
+    va_start(arguments, format);
+    std::fprintf(stderr, "FAIL: ");
+    std::vfprintf(stderr, format, arguments);
+    std::fprintf(stderr, "\n");
+    va_end(arguments);
+    return false;
+}
+
+int finish(const char *test_name)
+{
+    if (failed_checks != 0)
+    {
+        std::fprintf(stderr, "%s: %d check%s failed\n", test_name, failed_checks, failed_checks == 1 ? "" : "s");
+        return 1;
+    }
+    std::printf("%s: all checks passed\n", test_name);
+    return 0;
+}
+
+std::string make_temporary_directory()
+{
+    const char *base = std::getenv("TMPDIR");
+    std::string path = std::string(base != nullptr && *base != '\0' ? base : "/tmp") + "/readelf-test-XXXXXX";
+    if (::mkdtemp(&path[0]) == nullptr)
+    {
+        std::perror("mkdtemp");
+        return std::string();
+    }
+    return path;
+}
+
+void remove_directory(const std::string& directory)
+{
+    DIR *stream = ::opendir(directory.c_str());
+    if (stream != nullptr)
+    {
+        struct dirent *entry;
+        while ((entry = ::readdir(stream)) != nullptr)
+        {
+            if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            {
+                continue;
+            }
+            std::string file_path = directory + "/" + entry->d_name;
+            struct stat st;
+            if (::lstat(file_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            {
+                remove_directory(file_path);
+            }
+            else
+            {
+                ::unlink(file_path.c_str());
+            }
+        }
+        ::closedir(stream);
+    }
+    ::rmdir(directory.c_str());
+}
+
+bool write_file(const std::string& file_path, const std::string& contents)
+{
+    std::FILE *out = std::fopen(file_path.c_str(), "wb");
+    if (out == nullptr)
+    {
+        return false;
+    }
+    bool written = std::fwrite(contents.data(), 1, contents.size(), out) == contents.size();
+    return std::fclose(out) == 0 && written;
+}
+
+std::string read_file(const std::string& file_path)
+{
+    std::string contents;
+    std::FILE *in = std::fopen(file_path.c_str(), "rb");
+    if (in == nullptr)
+    {
+        return contents;
+    }
+    char buffer[65536];
+    std::size_t length;
+    while ((length = std::fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        contents.append(buffer, length);
+    }
+    std::fclose(in);
+    return contents;
+}
+
+} // namespace test
+} // namespace ELF
@@ -0,0 +1,79 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace ELF
+{
+namespace test
+{
+
+// Exit status that tells CTest a test was skipped (SKIP_RETURN_CODE).
+const int EXIT_SKIPPED = 77;
+
+/*
+* What running a program produced.  status is the exit status, or -1 if the program could
+* not be run or was killed; signal is the signal that killed it, or 0.
+*/
+struct Run_result
+{
+    int status;
+    int signal;
+    std::string output;
+    std::string errors;
+    double milliseconds;
+};
+
+/*
+* Run arguments[0] with standard input read from input_path (/dev/null when empty) and
+* its standard output and standard error collected.  The environment is the caller's.
+*/
+Run_result run(const std::vector<std::string>& arguments, const std::string& input_path = std::string());
+
+/*
+* Start arguments[0] in the background with standard input from /dev/null and standard
+* output and standard error written to output_path and errors_path (/dev/null when empty).
+* Returns the process id, or -1.
+*/
+pid_t start(const std::vector<std::string>& arguments, const std::string& output_path = std::string(),
+            const std::string& errors_path = std::string());
+
+// Send signal to a process from start() and wait for it.  Returns its exit status, or -1.
+int stop(pid_t pid, int signal);
+
+/*
+* Wait up to timeout_ms for a process from start() to exit.  Returns its exit status, or -1
+* if it was killed, including by this function when the time runs out.
+*/
+int wait_for(pid_t pid, long timeout_ms);
+
+// Milliseconds of CPU time process pid has used, from /proc; -1 if it cannot be read.
+long cpu_milliseconds(pid_t pid);
+
+// Sleep for milliseconds.
+void pause_for(long milliseconds);
+
+/*
+* Count a failed check and print it with the printf-style message.  Returns condition so
+* callers can stop early.
+*/
+bool check(bool condition, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Print how many checks failed and return the exit status for the test: 0 or 1.
+int finish(const char *test_name);
+
+// A new empty directory under $TMPDIR or /tmp, or "" with a message if none can be made.
+std::string make_temporary_directory();
+
+// Remove directory and the files in it; subdirectories are removed recursively.
+void remove_directory(const std::string& directory);
+
+bool write_file(const std::string& file_path, const std::string& contents);
+std::string read_file(const std::string& file_path);
+
+} // namespace test
+} // namespace ELF
+
+#endif // TEST_SUPPORT_H
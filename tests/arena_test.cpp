@@ -0,0 +1,314 @@
+/*
+* Arena test: the section rows a reader decodes into its arena must print exactly what a
+* plain decode on the heap gives, whichever loader filled the reader and however often it
+* was reused or moved.
+*
+* The reference below builds the Type column and the flag letters with std::string and
+* std::map, one section at a time, and formats the two lines of a section header row
+* itself.  It is compared with show_section_header() for files with a section of every
+* type and one for every sh_flags bit, on x86-64 and another machine and for the GNU
+* OS ABI, and for this test's own binary.  Each file goes through load_file(),
+* load_regions() and load_stream() of one reader reused throughout, and of readers made by
+* moving it.  The Arena itself is checked for alignment, overlap and what reset() keeps.
+*
+* Usage: arena_test
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Arena.h"
+#include "ELF_reader.h"
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+
+const std::map<Elf64_Word, std::string> type_names = {
+    {SHT_NULL, "NULL"},                 {SHT_PROGBITS, "PROGBITS"},         {SHT_SYMTAB, "SYMTAB"},
+    {SHT_STRTAB, "STRTAB"},             {SHT_RELA, "RELA"},                 {SHT_HASH, "HASH"},
+    {SHT_DYNAMIC, "DYNAMIC"},           {SHT_NOTE, "NOTE"},                 {SHT_NOBITS, "NOBITS"},
+    {SHT_REL, "REL"},                   {SHT_SHLIB, "SHLIB"},               {SHT_DYNSYM, "DYNSYM"},
+    {SHT_INIT_ARRAY, "INIT_ARRAY"},     {SHT_FINI_ARRAY, "FINI_ARRAY"},     {SHT_PREINIT_ARRAY, "PREINIT_ARRAY"},
+    {SHT_GROUP, "GROUP"},               {SHT_SYMTAB_SHNDX, "SYMTAB_SHNDX"}, {SHT_RELR, "RELR"},
+    {SHT_GNU_ATTRIBUTES, "GNU_ATTRIBUTES"}, {SHT_GNU_HASH, "GNU_HASH"}, {SHT_GNU_LIBLIST, "GNU_LIBLIST"},
+    {SHT_CHECKSUM, "CHECKSUM"},         {SHT_GNU_verdef, "VERDEF"},         {SHT_GNU_verneed, "VERNEED"},
+    {SHT_GNU_versym, "VERSYM"},
+};
+
+const std::map<Elf64_Xword, char> flag_letters = {
+    {SHF_WRITE, 'W'},       {SHF_ALLOC, 'A'},       {SHF_EXECINSTR, 'X'},       {SHF_MERGE, 'M'},
+    {SHF_STRINGS, 'S'},     {SHF_INFO_LINK, 'I'},   {SHF_LINK_ORDER, 'L'},      {SHF_OS_NONCONFORMING, 'O'},
+    {SHF_GROUP, 'G'},       {SHF_TLS, 'T'},         {SHF_COMPRESSED, 'C'},      {SHF_EXCLUDE, 'E'},
+};
+
+const Elf64_Xword SHF_X86_64_LARGE = 0x10000000;
+
+std::string heap_type(Elf64_Word type)
+{
+    auto found = type_names.find(type);
+    std::string text = found == type_names.end() ? "Unknown" : found->second;
+    text.resize(17, ' ');
+    return text;
+}
+
+/*
+* The named flags sorted by letter, then R (GNU OS ABIs) and l (x86-64) for the bits that
+* mean something there, then o, p and x for whatever is left in the OS range, the
+* processor range and elsewhere.
+*/
+std::string heap_flags(Elf64_Xword flags, const Elf64_Ehdr& file_header)
+{
+    std::string letters;
+    for (const auto& entry : flag_letters)
+    {
+        if (flags & entry.first)
+        {
+            letters.push_back(entry.second);
+            flags &= ~entry.first;
+        }
+    }
+    std::sort(letters.begin(), letters.end());
+
+    unsigned char osabi = file_header.e_ident[EI_OSABI];
+    if ((osabi == ELFOSABI_GNU || osabi == ELFOSABI_FREEBSD) && (flags & SHF_GNU_RETAIN))
+    {
+        letters.push_back('R');
+        flags &= ~Elf64_Xword(SHF_GNU_RETAIN);
+    }
+    if (file_header.e_machine == EM_X86_64 && (flags & SHF_X86_64_LARGE))
+    {
+        letters.push_back('l');
+        flags &= ~SHF_X86_64_LARGE;
+    }
+    if (flags & SHF_MASKOS)
+        letters.push_back('o');
+    if (flags & SHF_MASKPROC)
+        letters.push_back('p');
+    if (flags & ~Elf64_Xword(SHF_MASKOS | SHF_MASKPROC))
+        letters.push_back('x');
+    return letters;
+}
+
+std::string heap_section_header(const ELF::ELF_reader& reader, std::size_t i)
+{
+    const Elf64_Shdr& section = *reader.section_header(i);
+    char line[512];
+    std::snprintf(line, sizeof(line), "  [%2lu] %-16.16s  %s%016lx  %08lx\n       %016lx  %016lx %5s  %4d  %4d  %4lu\n",
+                  i, reader.section_name(i), heap_type(section.sh_type).c_str(), section.sh_addr, section.sh_offset,
+                  section.sh_size, section.sh_entsize,
+                  heap_flags(section.sh_flags, *reader.file_header()).c_str(), section.sh_link,
+                  section.sh_info, section.sh_addralign);
+    return line;
+}
+
+std::string printed_section_header(const ELF::ELF_reader& reader, std::size_t i)
+{
+    char *text = nullptr;
+    std::size_t length = 0;
+    std::FILE *out = ::open_memstream(&text, &length);
+    if (out == nullptr)
+    {
+        return std::string();
+    }
+    reader.show_section_header(i, out);
+    std::fclose(out);
+    std::string printed(text, length);
+    std::free(text);
+    return printed;
+}
+
+// Returns the number of sections compared.
+std::size_t compare_rows(const ELF::ELF_reader& reader, const std::string& what)
+{
+    if (!check(!reader.error() && reader.is_loaded(), "%s: not loaded: %s", what.c_str(),
+               reader.error().message().c_str()))
+    {
+        return 0;
+    }
+    std::size_t differences = 0;
+    for (std::size_t i = 0; i < reader.section_number(); ++i)
+    {
+        std::string expected = heap_section_header(reader, i);
+        std::string printed = printed_section_header(reader, i);
+        if (printed != expected && differences++ < 5)
+        {
+            check(false, "%s: section %lu printed\n%s  the heap decode gives\n%s", what.c_str(), i,
+                  printed.c_str(), expected.c_str());
+        }
+    }
+    check(differences == 0, "%s: %lu of %lu sections differ from the heap decode", what.c_str(), differences,
+          reader.section_number());
+    return reader.section_number();
+}
+
+/*
+* A section of every type named in type_names and of one unknown type, then one section for
+* every bit of sh_flags.  Symbol tables get the entry size and link the reader insists on.
+*/
+std::vector<std::uint8_t> build_rows_image(Elf64_Half machine, unsigned char osabi)
+{
+    ELF::test::Elf_builder builder(ET_REL);
+    std::vector<Elf64_Sym> symbols(2);
+    std::memset(symbols.data(), 0, symbols.size() * sizeof(Elf64_Sym));
+    std::size_t symtab = builder.add_symbol_table({"", "symbol"}, symbols);
+    std::size_t strtab = symtab + 1;
+
+    std::vector<Elf64_Word> types;
+    for (const auto& entry : type_names)
+    {
+        if (entry.first != SHT_NULL && entry.first != SHT_SYMTAB && entry.first != SHT_STRTAB)
+        {
+            types.push_back(entry.first);
+        }
+    }
+    types.push_back(0x12345);
+    types.push_back(SHT_LOOS + 7);
+    for (Elf64_Word type : types)
+    {
+        bool symbol_table = type == SHT_DYNSYM;
+        builder.add_section(".type", type, 0, std::vector<std::uint8_t>(sizeof(Elf64_Sym), 0), 8,
+                            symbol_table ? sizeof(Elf64_Sym) : 0, symbol_table ? static_cast<Elf64_Word>(strtab) : 0);
+    }
+    for (unsigned bit = 0; bit < 64; ++bit)
+    {
+        builder.add_section(".flag", SHT_PROGBITS, Elf64_Xword(1) << bit, std::vector<std::uint8_t>(4, 0));
+    }
+    builder.add_section(".flags", SHT_PROGBITS, ~Elf64_Xword(0), {});
+    builder.add_section(".flags", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE | SHF_TLS | SHF_GNU_RETAIN, {});
+
+    std::vector<std::uint8_t> image = builder.build();
+    Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(image.data());
+    file_header->e_machine = machine;
+    file_header->e_ident[EI_OSABI] = osabi;
+    return image;
+}
+
+std::string own_path()
+{
+    char path[4096];
+    ssize_t length = ::readlink("/proc/self/exe", path, sizeof(path));
+    return length <= 0 || length == sizeof(path) ? std::string() : std::string(path, length);
+}
+
+void check_arena()
+{
+    ELF::Arena arena(1024);
+    std::vector<std::pair<unsigned char *, std::size_t>> pieces;
+    for (std::size_t i = 0; i < 300; ++i)
+    {
+        std::size_t size = (i * 37) % 200 + 1;
+        std::size_t alignment = std::size_t(1) << (i % 7);
+        unsigned char *piece = static_cast<unsigned char *>(arena.allocate(size, alignment));
+        check(reinterpret_cast<std::uintptr_t>(piece) % alignment == 0, "allocation %lu is not aligned to %lu", i,
+              alignment);
+        std::memset(piece, static_cast<int>(i), size);
+        pieces.emplace_back(piece, size);
+    }
+    // Larger than a block.
+    unsigned char *large = static_cast<unsigned char *>(arena.allocate(5000, 64));
+    std::memset(large, 0xee, 5000);
+
+    std::size_t overwritten = 0;
+    for (std::size_t i = 0; i < pieces.size(); ++i)
+    {
+        overwritten += std::any_of(pieces[i].first, pieces[i].first + pieces[i].second,
+                                   [i](unsigned char c) { return c != static_cast<unsigned char>(i); });
+    }
+    check(overwritten == 0, "%lu arena allocations overlap", overwritten);
+    check(std::strcmp(arena.copy_string("section\0tail", 12), "section") == 0 &&
+          std::strcmp(arena.copy_string("abc", 2), "ab") == 0, "copy_string does not stop at the length");
+
+    std::size_t capacity = arena.capacity();
+    arena.reset();
+    check(arena.capacity() > 0 && arena.capacity() <= 1024 && arena.capacity() < capacity,
+          "reset keeps %lu of %lu bytes, not the first block", arena.capacity(), capacity);
+    ELF::Arena moved(std::move(arena));
+    check(arena.capacity() == 0 && moved.allocate(16) != nullptr, "a moved arena keeps its blocks");
+}
+
+} // namespace
+
+int main()
+{
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+
+    struct Variant
+    {
+        const char *file_name;
+        Elf64_Half machine;
+        unsigned char osabi;
+    };
+    const Variant variants[] = {
+        {"x86-64.o", EM_X86_64, ELFOSABI_SYSV},
+        {"gnu.o", EM_X86_64, ELFOSABI_GNU},
+        {"aarch64.o", EM_AARCH64, ELFOSABI_SYSV},
+    };
+    std::vector<std::string> file_paths;
+    for (const Variant& variant : variants)
+    {
+        std::string file_path = directory + "/" + variant.file_name;
+        if (check(ELF::test::write_image(file_path, build_rows_image(variant.machine, variant.osabi)),
+                  "cannot write %s", file_path.c_str()))
+        {
+            file_paths.push_back(file_path);
+        }
+    }
+    std::string self_path = own_path();
+    if (check(!self_path.empty(), "cannot find the test binary"))
+    {
+        file_paths.push_back(self_path);
+    }
+
+    // One reader for every load, so each load finds the arena of the one before.
+    ELF::ELF_reader reader;
+    std::size_t compared = 0;
+    for (int round = 0; round < 2; ++round)
+    {
+        for (const std::string& file_path : file_paths)
+        {
+            reader.load_file(file_path);
+            compared += compare_rows(reader, file_path + " (mmap)");
+
+            ELF::Region_loader loader(ELF::load_section_headers);
+            reader.load_regions(file_path, loader);
+            compared += compare_rows(reader, file_path + " (" + ELF::Region_loader::method_name(loader.method()) + ")");
+
+            int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+            reader.load_stream(fd, file_path, ELF::load_section_headers);
+            if (fd != -1)
+            {
+                ::close(fd);
+            }
+            compared += compare_rows(reader, file_path + " (stream)");
+        }
+    }
+
+    ELF::ELF_reader moved(std::move(reader));
+    compared += compare_rows(moved, "move-constructed reader");
+    check(!reader.is_loaded() && printed_section_header(reader, 0).empty(), "a moved-from reader still prints");
+    ELF::ELF_reader assigned;
+    assigned.load_file(file_paths.front());
+    assigned = std::move(moved);
+    compared += compare_rows(assigned, "move-assigned reader");
+    printf("%lu section rows compared with the heap decode\n", compared);
+
+    check_arena();
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("arena_test");
+}
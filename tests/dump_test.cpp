@@ -0,0 +1,271 @@
+/*
+* Section dump test: show_hex_dump() and show_string_dump() must print what a plain
+* byte-at-a-time formatter prints, for every section of a file made to reach the edges of
+* the batched writers:
+*
+*   - sections with partial last lines and ranges that start and end inside a line;
+*   - a section whose addresses grow from 8 to 9 hex digits partway through;
+*   - a section of thousands of lines and a printable run longer than the output buffer;
+*   - empty and NOBITS sections, and ranges past the end of a section.
+*
+* The command line is also run with -x, -p and --dump-range to check that options, range
+* parsing and section lookup by name and index reach the same functions.
+*
+* Usage: dump_test READELF
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include "ELF_reader.h"
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+using ELF::test::run;
+
+// Longer than the string dump's output buffer.
+const std::size_t LONG_RUN = 100000;
+
+struct Range
+{
+    std::uint64_t start;
+    std::uint64_t length;
+};
+
+const Range ranges[] = {
+    {0, UINT64_MAX},
+    {0, 1},
+    {5, 16},
+    {16, 16},
+    {17, 300},
+    {0x3f, 0x83},
+    {1000, 2000},
+    {LONG_RUN - 10, 40},
+    {UINT64_MAX, 1},
+};
+
+bool is_printable(unsigned char c)
+{
+    return c >= ' ' && c <= '~';
+}
+
+// The sections to dump, keyed by name; returns the index of .high.
+std::size_t add_dump_sections(ELF::test::Elf_builder& builder)
+{
+    std::uint32_t state = 34;
+    auto next = [&state]() {
+        state = state * 1103515245u + 12345u;
+        return static_cast<std::uint8_t>(state >> 16);
+    };
+
+    std::vector<std::uint8_t> text(300);
+    for (std::uint8_t& byte : text)
+        byte = next();
+    builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text, 16);
+
+    const char strings[] = "\0first\0second string\0\ttabbed\x7f" "deleted\x80high\0\0spaced out \0last";
+    builder.add_section(".rodata", SHT_PROGBITS, SHF_ALLOC, std::vector<std::uint8_t>(strings, strings + sizeof(strings)));
+
+    std::vector<std::uint8_t> high(0x50);
+    for (std::uint8_t& byte : high)
+        byte = next();
+    std::size_t high_index = builder.add_section(".high", SHT_PROGBITS, SHF_ALLOC, high);
+
+    std::vector<std::uint8_t> big(LONG_RUN + 5000, 'a');
+    for (std::size_t i = 0; i < big.size(); ++i)
+    {
+        big[i] = static_cast<std::uint8_t>('a' + i % 26);
+    }
+    big[LONG_RUN] = '\0';
+    for (std::size_t i = LONG_RUN + 1; i < big.size(); i += 1 + next() % 50)
+        big[i] = next();
+    builder.add_section(".big", SHT_PROGBITS, 0, big);
+
+    builder.add_section(".empty", SHT_PROGBITS, SHF_ALLOC, {});
+    builder.add_section(".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, {}, 8);
+    return high_index;
+}
+
+std::string reference_hex_dump(const std::string& name, const Elf64_Shdr& section, const std::uint8_t *data,
+                               std::uint64_t start, std::uint64_t length)
+{
+    if (section.sh_type == SHT_NOBITS || section.sh_size == 0)
+    {
+        return "Section '" + name + "' has no data to dump.\n";
+    }
+    start = std::min<std::uint64_t>(start, section.sh_size);
+    length = std::min<std::uint64_t>(length, section.sh_size - start);
+
+    std::string text = "\nHex dump of section '" + name + "':\n";
+    char field[32];
+    for (std::uint64_t line = 0; line < length; line += 16)
+    {
+        std::uint64_t address = section.sh_addr + start + line;
+        std::snprintf(field, sizeof(field), "  0x%0*lx ", address > 0xffffffff ? 1 : 8, address);
+        text += field;
+        std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(16, length - line));
+        for (std::size_t j = 0; j < 16; ++j)
+        {
+            if (j < count)
+            {
+                std::snprintf(field, sizeof(field), "%02x", data[start + line + j]);
+                text += field;
+            }
+            else
+            {
+                text += "  ";
+            }
+            if (j % 4 == 3)
+                text += ' ';
+        }
+        for (std::size_t j = 0; j < count; ++j)
+        {
+            unsigned char c = data[start + line + j];
+            text += is_printable(c) ? static_cast<char>(c) : '.';
+        }
+        text += '\n';
+    }
+    return text + "\n";
+}
+
+std::string reference_string_dump(const std::string& name, const Elf64_Shdr& section, const std::uint8_t *data,
+                                  std::uint64_t start, std::uint64_t length)
+{
+    if (section.sh_type == SHT_NOBITS || section.sh_size == 0)
+    {
+        return "Section '" + name + "' has no data to dump.\n";
+    }
+    start = std::min<std::uint64_t>(start, section.sh_size);
+    length = std::min<std::uint64_t>(length, section.sh_size - start);
+
+    std::string text = "\nString dump of section '" + name + "':\n";
+    char field[32];
+    for (std::uint64_t i = start; i < start + length; )
+    {
+        if (!is_printable(data[i]))
+        {
+            ++i;
+            continue;
+        }
+        std::uint64_t run_start = i;
+        while (i < start + length && is_printable(data[i]))
+            ++i;
+        std::snprintf(field, sizeof(field), "  [%6lx]  ", run_start);
+        text += field;
+        text.append(reinterpret_cast<const char *>(data + run_start), i - run_start);
+        text += '\n';
+    }
+    return text + "\n";
+}
+
+template <typename Show>
+std::string printed(Show show)
+{
+    char *text = nullptr;
+    std::size_t length = 0;
+    std::FILE *out = ::open_memstream(&text, &length);
+    if (out == nullptr)
+    {
+        return std::string();
+    }
+    show(out);
+    std::fclose(out);
+    std::string result(text, length);
+    std::free(text);
+    return result;
+}
+
+// Report the first line where two dumps differ.
+void compare(const std::string& what, const std::string& got, const std::string& expected)
+{
+    if (got == expected)
+    {
+        return;
+    }
+    std::size_t at = 0;
+    while (at < got.size() && at < expected.size() && got[at] == expected[at])
+        ++at;
+    std::size_t line_start = expected.rfind('\n', at == 0 ? 0 : at - 1);
+    line_start = line_start == std::string::npos ? 0 : line_start + 1;
+    check(false, "%s differs at byte %lu:\n  got      %s\n  expected %s", what.c_str(), at,
+          got.substr(line_start, got.find('\n', line_start) - line_start).c_str(),
+          expected.substr(line_start, expected.find('\n', line_start) - line_start).c_str());
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: dump_test READELF\n");
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[1];
+
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    std::string file_path = directory + "/dump.o";
+    ELF::test::Elf_builder builder(ET_REL);
+    std::size_t high_index = add_dump_sections(builder);
+    std::vector<std::uint8_t> image = builder.build();
+    ELF::test::section_header(image, 1).sh_addr = 0x401000;
+    ELF::test::section_header(image, high_index).sh_addr = 0xffffffe8;
+    if (!check(ELF::test::write_image(file_path, image), "cannot write %s", file_path.c_str()))
+    {
+        return ELF::test::finish("dump_test");
+    }
+
+    ELF::ELF_reader reader(file_path);
+    if (!check(!reader.error(), "cannot load %s: %s", file_path.c_str(), reader.error().message().c_str()))
+    {
+        return ELF::test::finish("dump_test");
+    }
+
+    std::size_t dumps = 0;
+    for (std::size_t i = 1; i < reader.section_number(); ++i)
+    {
+        const Elf64_Shdr& section = *reader.section_header(i);
+        const std::uint8_t *data = reader.section_data(i);
+        std::string name = reader.section_name(i);
+        for (const Range& range : ranges)
+        {
+            std::string what = name + " " + std::to_string(range.start) + "+" + std::to_string(range.length);
+            compare("hex dump of " + what,
+                    printed([&](std::FILE *out) { reader.show_hex_dump(i, range.start, range.length, out); }),
+                    reference_hex_dump(name, section, data, range.start, range.length));
+            compare("string dump of " + what,
+                    printed([&](std::FILE *out) { reader.show_string_dump(i, range.start, range.length, out); }),
+                    reference_string_dump(name, section, data, range.start, range.length));
+            dumps += 2;
+        }
+    }
+    printf("%lu dumps compared with the reference\n", dumps);
+
+    // The command line: a range, a section by index, and a section that does not exist.
+    ELF::test::Run_result result = run({readelf, "-x", ".text", "--dump-range=5-20", file_path});
+    std::size_t text_index = 1;
+    check(result.status == EXIT_SUCCESS, "-x .text --dump-range=5-20 exits %d", result.status);
+    compare("readelf -x .text --dump-range=5-20", result.output,
+            reference_hex_dump(".text", *reader.section_header(text_index), reader.section_data(text_index), 5, 16));
+    result = run({readelf, "-p", "2", "--dump-range=0x1-0x20", file_path});
+    compare("readelf -p 2 --dump-range=0x1-0x20", result.output,
+            reference_string_dump(reader.section_name(2), *reader.section_header(2), reader.section_data(2), 1, 32));
+    result = run({readelf, "-x", ".nosuch", file_path});
+    check(result.output.empty() && result.errors.find("was not dumped") != std::string::npos,
+          "-x of a missing section: '%s'", result.errors.c_str());
+    result = run({readelf, "-x", ".text", "--dump-range=20-5", file_path});
+    check(result.status != EXIT_SUCCESS, "a reversed --dump-range was accepted");
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("dump_test");
+}
@@ -0,0 +1,265 @@
+/*
+* Symbol filter test: builds an object file with a few hundred symbols of every type,
+* binding and kind of section, and checks that ELF_reader::select_symbols() picks exactly
+* the symbols a plain per-symbol reference picks for each --sym-* criterion on its own, for
+* combinations of them, and for filters nothing passes.  The table is large enough for the
+* vector kernels and for the string table prefix scan of the name filter to be used; the
+* combinations leave few enough symbols that names are also matched one by one.
+*
+* Usage: filter_test
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include <fnmatch.h>
+#include "ELF_reader.h"
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::Symbol_filter;
+using ELF::test::check;
+
+const std::size_t SYMBOL_NUMBER = 700;
+
+struct Symbol_file
+{
+    std::vector<std::string> names;
+    std::vector<Elf64_Sym> symbols;
+    std::size_t text;
+    std::size_t data;
+    std::size_t bss;
+    std::size_t symbol_section;
+};
+
+// A small deterministic generator so failures reproduce.
+class Sequence
+{
+public:
+    explicit Sequence(std::uint32_t seed) : state_(seed) { }
+
+    std::uint32_t next(std::uint32_t bound)
+    {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 8) % bound;
+    }
+
+private:
+    std::uint32_t state_;
+};
+
+Elf64_Sym make_symbol(unsigned bind, unsigned type, Elf64_Section section, Elf64_Addr value, Elf64_Xword size)
+{
+    Elf64_Sym symbol;
+    std::memset(&symbol, 0, sizeof(symbol));
+    symbol.st_info = ELF64_ST_INFO(bind, type);
+    symbol.st_shndx = section;
+    symbol.st_value = value;
+    symbol.st_size = size;
+    return symbol;
+}
+
+bool write_symbol_file(const std::string& file_path, Symbol_file& file)
+{
+    static const char *const stems[] = {"foo_", "bar_", "foobar_", "baz", "qux_"};
+    static const unsigned types[] = {STT_NOTYPE, STT_OBJECT, STT_FUNC, STT_TLS, STT_GNU_IFUNC};
+    static const unsigned binds[] = {STB_LOCAL, STB_GLOBAL, STB_WEAK, STB_GNU_UNIQUE};
+
+    ELF::test::Elf_builder builder(ET_REL);
+    file.text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                    std::vector<std::uint8_t>(64, 0x90), 16);
+    file.data = builder.add_section(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, std::vector<std::uint8_t>(64, 1), 8);
+    file.bss = builder.add_section(".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, {}, 8);
+    const Elf64_Section sections[] = {static_cast<Elf64_Section>(file.text), static_cast<Elf64_Section>(file.data),
+                                      static_cast<Elf64_Section>(file.bss), SHN_UNDEF, SHN_ABS, SHN_COMMON};
+
+    file.names = {"", "filter.c"};
+    file.symbols = {make_symbol(STB_LOCAL, STT_NOTYPE, SHN_UNDEF, 0, 0),
+                    make_symbol(STB_LOCAL, STT_FILE, SHN_ABS, 0, 0)};
+    Sequence sequence(2024);
+    for (std::size_t i = file.symbols.size(); i < SYMBOL_NUMBER; ++i)
+    {
+        file.names.push_back(stems[sequence.next(5)] + std::to_string(sequence.next(200)));
+        file.symbols.push_back(make_symbol(binds[sequence.next(4)], types[sequence.next(5)],
+                                           sections[sequence.next(6)], sequence.next(0x4000), sequence.next(64)));
+    }
+    file.symbol_section = builder.add_symbol_table(file.names, file.symbols);
+    return builder.write(file_path);
+}
+
+// The reference: one symbol against every criterion, written out as plainly as possible.
+bool passes(const Symbol_file& file, std::size_t index, const Symbol_filter& filter, long section)
+{
+    const Elf64_Sym& symbol = file.symbols[index];
+    return (filter.type_mask >> ELF64_ST_TYPE(symbol.st_info) & 1) &&
+           (filter.bind_mask >> ELF64_ST_BIND(symbol.st_info) & 1) &&
+           (filter.section.empty() || symbol.st_shndx == section) &&
+           (filter.name_pattern.empty() || ::fnmatch(filter.name_pattern.c_str(), file.names[index].c_str(), 0) == 0) &&
+           symbol.st_value >= filter.address_low && symbol.st_value <= filter.address_high;
+}
+
+struct Filter_case
+{
+    const char *description;
+    const char *types;
+    const char *binds;
+    const char *section;
+    const char *name;
+    const char *addresses;
+    bool expect_empty;
+};
+
+const Filter_case filter_cases[] = {
+    {"no criteria",                      nullptr,        nullptr,        nullptr,    nullptr,     nullptr,          false},
+    {"type FUNC",                        "FUNC",         nullptr,        nullptr,    nullptr,     nullptr,          false},
+    {"types OBJECT,TLS",                 "OBJECT,TLS",   nullptr,        nullptr,    nullptr,     nullptr,          false},
+    {"type by number",                   "10",           nullptr,        nullptr,    nullptr,     nullptr,          false},
+    {"type FILE",                        "FILE",         nullptr,        nullptr,    nullptr,     nullptr,          false},
+    {"bind GLOBAL",                      nullptr,        "GLOBAL",       nullptr,    nullptr,     nullptr,          false},
+    {"binds WEAK,UNIQUE",                nullptr,        "weak,unique",  nullptr,    nullptr,     nullptr,          false},
+    {"section by name",                  nullptr,        nullptr,        ".text",    nullptr,     nullptr,          false},
+    {"section by index",                 nullptr,        nullptr,        "2",        nullptr,     nullptr,          false},
+    {"section NOBITS",                   nullptr,        nullptr,        ".bss",     nullptr,     nullptr,          false},
+    {"section UND",                      nullptr,        nullptr,        "UND",      nullptr,     nullptr,          false},
+    {"section ABS",                      nullptr,        nullptr,        "ABS",      nullptr,     nullptr,          false},
+    {"section COM",                      nullptr,        nullptr,        "COM",      nullptr,     nullptr,          false},
+    {"name with a prefix",               nullptr,        nullptr,        nullptr,    "foo_1*",    nullptr,          false},
+    {"name prefix inside other names",   nullptr,        nullptr,        nullptr,    "bar_*",     nullptr,          false},
+    {"name without a prefix",            nullptr,        nullptr,        nullptr,    "*_7",       nullptr,          false},
+    {"name with a bracket",              nullptr,        nullptr,        nullptr,    "[fq]*_3?",  nullptr,          false},
+    {"literal name",                     nullptr,        nullptr,        nullptr,    "filter.c",  nullptr,          false},
+    {"address range",                    nullptr,        nullptr,        nullptr,    nullptr,     "0x1000-0x1fff",  false},
+    {"single address",                   nullptr,        nullptr,        nullptr,    nullptr,     "0-0",            false},
+    {"type and bind",                    "FUNC",         "GLOBAL",       nullptr,    nullptr,     nullptr,          false},
+    {"type, section and name",           "FUNC,IFUNC",   nullptr,        ".text",    "foo*",      nullptr,          false},
+    {"every criterion",                  "OBJECT,FUNC",  "GLOBAL,WEAK",  ".data",    "*o*",       "0-0x2fff",       false},
+    {"few symbols, then a name",         "TLS",          "LOCAL",        nullptr,    "qux_*",     nullptr,          false},
+    {"no name matches",                  nullptr,        nullptr,        nullptr,    "nosuch*",   nullptr,          true},
+    {"no literal name matches",          nullptr,        nullptr,        nullptr,    "foo_",      nullptr,          true},
+    {"section that does not exist",      nullptr,        nullptr,        ".nosuch",  nullptr,     nullptr,          true},
+    {"type not in the table",            "SECTION",      nullptr,        nullptr,    nullptr,     nullptr,          true},
+    {"disjoint type and section",        "FILE",         nullptr,        ".text",    nullptr,     nullptr,          true},
+    {"address range past every symbol",  nullptr,        nullptr,        nullptr,    nullptr,     "0x4000-0x5000",  true},
+};
+
+long section_of(const Symbol_file& file, const char *section)
+{
+    if (section == nullptr)
+        return -1;
+    if (std::strcmp(section, ".text") == 0)
+        return static_cast<long>(file.text);
+    if (std::strcmp(section, ".data") == 0)
+        return static_cast<long>(file.data);
+    if (std::strcmp(section, ".bss") == 0)
+        return static_cast<long>(file.bss);
+    if (std::strcmp(section, "UND") == 0)
+        return SHN_UNDEF;
+    if (std::strcmp(section, "ABS") == 0)
+        return SHN_ABS;
+    if (std::strcmp(section, "COM") == 0)
+        return SHN_COMMON;
+    if (section[0] >= '0' && section[0] <= '9')
+        return std::strtol(section, nullptr, 10);
+    return -1;
+}
+
+// The "N of them match" count show_symbol_table() prints for filter, or -1.
+long printed_count(const ELF::ELF_reader& reader, std::size_t section_index, const Symbol_filter& filter)
+{
+    char *text = nullptr;
+    std::size_t length = 0;
+    std::FILE *out = ::open_memstream(&text, &length);
+    if (out == nullptr)
+    {
+        return -1;
+    }
+    reader.show_symbol_table(section_index, filter, out);
+    std::fclose(out);
+    long count = -1;
+    // The title line, then the count.
+    const char *found = length == 0 ? nullptr : std::strchr(text + 1, '\n');
+    if (found != nullptr)
+    {
+        std::sscanf(found + 1, "%ld of them match the filter", &count);
+    }
+    std::free(text);
+    return count;
+}
+
+} // namespace
+
+int main()
+{
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    std::string file_path = directory + "/symbols.o";
+    Symbol_file file;
+    if (!check(write_symbol_file(file_path, file), "cannot write %s", file_path.c_str()))
+    {
+        return ELF::test::finish("filter_test");
+    }
+
+    ELF::ELF_reader reader(file_path);
+    if (!check(!reader.error(), "cannot load %s: %s", file_path.c_str(), reader.error().message().c_str()))
+    {
+        return ELF::test::finish("filter_test");
+    }
+
+    for (const Filter_case& test_case : filter_cases)
+    {
+        Symbol_filter filter;
+        bool parsed = (test_case.types == nullptr || filter.set_types(test_case.types)) &&
+                      (test_case.binds == nullptr || filter.set_binds(test_case.binds)) &&
+                      (test_case.addresses == nullptr || filter.set_address_range(test_case.addresses));
+        if (!check(parsed, "%s: criteria not understood", test_case.description))
+        {
+            continue;
+        }
+        filter.section = test_case.section == nullptr ? "" : test_case.section;
+        filter.name_pattern = test_case.name == nullptr ? "" : test_case.name;
+
+        std::vector<std::uint32_t> expected;
+        long section = section_of(file, test_case.section);
+        if (test_case.section == nullptr || section != -1)
+        {
+            for (std::size_t i = 0; i < file.symbols.size(); ++i)
+            {
+                if (passes(file, i, filter, section))
+                {
+                    expected.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+        }
+        std::vector<std::uint32_t> selected = reader.select_symbols(file.symbol_section, filter);
+
+        check(selected == expected, "%s: selected %lu symbols, expected %lu", test_case.description,
+              selected.size(), expected.size());
+        check(expected.empty() == test_case.expect_empty, "%s: the reference selected %lu symbols",
+              test_case.description, expected.size());
+        if (!filter.empty())
+        {
+            long count = printed_count(reader, file.symbol_section, filter);
+            check(count == static_cast<long>(expected.size()), "%s: printed %ld matches, expected %lu",
+                  test_case.description, count, expected.size());
+        }
+    }
+
+    // Criteria that are not understood are refused rather than ignored.
+    Symbol_filter filter;
+    check(!filter.set_types("FUNC,NOSUCH") && !filter.set_types("16") && !filter.set_binds(""),
+          "bad type or bind list accepted");
+    check(!filter.set_address_range("0x2000-0x1000") && !filter.set_address_range("0x1000") &&
+          !filter.set_address_range("low-high"), "bad address range accepted");
+    check(filter.empty(), "refused criteria changed the filter");
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("filter_test");
+}
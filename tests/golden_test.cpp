@@ -0,0 +1,791 @@
+/*
+* Golden-output test: runs the readelf built here and binutils readelf on the same files and
+* compares what they print field by field.
+*
+* The two tools do not print the same text.  This readelf uses its own spelling for some
+* header values, prints section headers on two lines, truncates section names to 16
+* characters and symbol names to 25, and leaves out symbol versions.  Each output is parsed
+* into fields under common keys, and the values are put in one canonical form before they
+* are compared.  Values this readelf does not decode (an unknown section type, a machine it
+* has no name for) are compared as "Unknown".
+*
+* The corpus is a sample of the system's binaries and libraries, this readelf itself, any
+* files named on the command line, and ELF files made here for the edge cases: extended
+* section numbering, an empty symbol table, a symbol table with only the null entry, and a
+* file with no symbol tables at all.  The time each tool takes per file is printed, and
+* written as tab separated values with --timings.
+*
+* Exit status: 0 when every field matches, 1 on a mismatch, 77 (skipped, to CTest) when
+* binutils readelf cannot be found.
+*/
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::Elf_builder;
+using ELF::test::EXIT_SKIPPED;
+using ELF::test::run;
+
+// Files sampled from each system directory when no --corpus-limit is given.
+const std::size_t DEFAULT_CORPUS_LIMIT = 24;
+
+// Mismatches printed per file before the rest are only counted.
+const std::size_t MISMATCHES_SHOWN = 20;
+
+// Widths of the name columns of this readelf.
+const std::size_t SECTION_NAME_WIDTH = 16;
+const std::size_t SYMBOL_NAME_WIDTH = 25;
+
+const char *const SYSTEM_DIRECTORIES[] = {
+    "/usr/bin",
+    "/usr/sbin",
+    "/usr/lib/x86_64-linux-gnu",
+    "/usr/lib64",
+};
+
+typedef std::map<std::string, std::string> Fields;
+
+struct Translation
+{
+    const char *ours;
+    const char *binutils;
+};
+
+// Header values this readelf spells differently, and what binutils prints for them.
+const Translation header_translations[] = {
+    {"2's complement, little-endian", "2's complement, little endian"},
+    {"2's complement, big-endian",    "2's complement, big endian"},
+    {"UNIX System V ABI",             "UNIX - System V"},
+    {"HP-UX ABI",                     "UNIX - HP-UX"},
+    {"NetBSD ABI",                    "UNIX - NetBSD"},
+    {"Linux ABI",                     "UNIX - GNU"},
+    {"Solaris ABI",                   "UNIX - Solaris"},
+    {"IRIX ABI",                      "UNIX - IRIX"},
+    {"FreeBSD ABI",                   "UNIX - FreeBSD"},
+    {"TRU64 UNIX ABI",                "UNIX - TRU64"},
+    {"ARM architecture ABI",          "ARM"},
+    {"Stand-alone (embedded) ABI",    "Standalone App"},
+    {"unknonw type",                  "NONE"},
+    {"relocatable file",              "REL"},
+    {"executable file",               "EXEC"},
+    {"shared object",                 "DYN"},
+    {"core file",                     "CORE"},
+    {"Intel 80386",                   "Intel 80386"},
+    {"AMD x86-64",                    "Advanced Micro Devices X86-64"},
+    {"invalid version",               "0"},
+    {"current version",               "1"},
+    {"undefined value",               "0"},
+};
+
+// The section and symbol types this readelf has names for, as binutils prints them.
+const char *const section_types[] = {
+    "NULL", "PROGBITS", "SYMTAB", "STRTAB", "RELA", "HASH", "DYNAMIC", "NOTE", "NOBITS", "REL",
+    "SHLIB", "DYNSYM", "INIT_ARRAY", "FINI_ARRAY", "PREINIT_ARRAY", "GROUP", "SYMTAB_SHNDX", "RELR",
+    "GNU_ATTRIBUTES", "GNU_HASH", "GNU_LIBLIST", "CHECKSUM", "VERDEF", "VERNEED", "VERSYM",
+};
+
+const char *const symbol_types[] = {
+    "NOTYPE", "OBJECT", "FUNC", "SECTION", "FILE", "COMMON", "TLS", "IFUNC",
+};
+
+template <std::size_t N>
+std::string known_or_unknown(const std::string& value, const char *const (&names)[N])
+{
+    return std::find(std::begin(names), std::end(names), value) != std::end(names) ? value : "Unknown";
+}
+
+std::string translate(const std::string& value)
+{
+    for (const Translation& translation : header_translations)
+    {
+        if (value == translation.ours)
+        {
+            return translation.binutils;
+        }
+    }
+    return value;
+}
+
+std::string trim(const std::string& text)
+{
+    std::size_t begin = text.find_first_not_of(' ');
+    std::size_t end = text.find_last_not_of(' ');
+    return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+std::vector<std::string> split(const std::string& text)
+{
+    std::vector<std::string> tokens;
+    std::istringstream stream(text);
+    std::string token;
+    while (stream >> token)
+    {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+std::string first_token(const std::string& text)
+{
+    std::vector<std::string> tokens = split(text);
+    return tokens.empty() ? std::string() : tokens[0];
+}
+
+// A number in any base strtoull() reads, in canonical hex; the text itself if it is not one.
+std::string number(const std::string& text, int base = 0)
+{
+    char *end;
+    unsigned long long value = std::strtoull(text.c_str(), &end, base);
+    if (text.empty() || *end != '\0')
+    {
+        return text;
+    }
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%llx", value);
+    return buffer;
+}
+
+// binutils shows an escaped count as "0 (70000)": the value that counts is in parentheses.
+std::string escaped_number(const std::string& text)
+{
+    std::size_t open = text.find('(');
+    std::size_t close = text.find(')', open);
+    if (open != std::string::npos && close != std::string::npos)
+    {
+        return number(text.substr(open + 1, close - open - 1));
+    }
+    return number(first_token(text));
+}
+
+std::string sorted(std::string text)
+{
+    std::sort(text.begin(), text.end());
+    return text;
+}
+
+std::string padded_index(const std::string& index)
+{
+    return std::string(index.size() < 6 ? 6 - index.size() : 0, '0') + index;
+}
+
+bool starts_with(const std::string& text, const char *prefix)
+{
+    return text.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+// "Symbol table 'NAME' contain(s) N entries:"; returns NAME.
+std::string parse_symbol_title(const std::string& line, Fields& fields)
+{
+    std::size_t open = line.find('\'');
+    std::size_t close = line.find('\'', open + 1);
+    std::string table = line.substr(open + 1, close - open - 1);
+    std::vector<std::string> tokens = split(line.substr(close + 1));
+    if (tokens.size() >= 2)
+    {
+        fields["symbols[" + table + "].count"] = number(tokens[1], 10);
+    }
+    return table;
+}
+
+// "Num: Value Size Type Bind Vis Ndx Name"; the name may be empty.
+void parse_symbol_row(const std::string& line, const std::string& table, bool is_binutils, Fields& fields)
+{
+    std::istringstream stream(line);
+    std::string index, value, size, type, bind, visibility, section;
+    stream >> index >> value >> size >> type >> bind >> visibility >> section;
+    if (index.size() < 2 || index.back() != ':' || index.find_first_not_of("0123456789") != index.size() - 1)
+    {
+        return;
+    }
+    index.pop_back();
+
+    std::string name;
+    std::getline(stream, name);
+    name = name.empty() ? name : name.substr(1);
+    if (is_binutils)
+    {
+        // Dynamic symbols carry their version: "name@VERSION (2)" or "name@@VERSION".
+        std::size_t version = name.rfind(" (");
+        if (version != std::string::npos && name.back() == ')')
+        {
+            name.erase(version);
+        }
+        if (table == ".dynsym" && name.find('@') != std::string::npos)
+        {
+            name.erase(name.find('@'));
+        }
+        name = name.substr(0, SYMBOL_NAME_WIDTH);
+        type = known_or_unknown(type, symbol_types);
+    }
+    if (type == "SECTION")
+    {
+        name.clear();       // binutils shows the section's name, this readelf st_name
+    }
+
+    std::string key = "symbols[" + table + "]." + padded_index(index) + ".";
+    fields[key + "value"] = number(value, 16);
+    fields[key + "size"] = number(size);
+    fields[key + "type"] = type;
+    fields[key + "bind"] = bind;
+    fields[key + "visibility"] = visibility;
+    fields[key + "section"] = section;
+    fields[key + "name"] = name;
+}
+
+void parse_header_line(const std::string& line, std::map<std::string, int>& seen,
+                       bool is_binutils, Fields& fields)
+{
+    std::size_t colon = line.find(':');
+    if (colon == std::string::npos)
+    {
+        return;
+    }
+    std::string label = trim(line.substr(0, colon));
+    std::string value = trim(line.substr(colon + 1));
+    int occurrence = seen[label]++;
+
+    if (label == "Magic")
+        fields["header.magic"] = trim(value);
+    else if (label == "Class" || label == "Data" || label == "OS/ABI" || label == "Machine")
+        fields["header." + label] = is_binutils ? value : translate(value);
+    else if (label == "Type")
+        fields["header.Type"] = is_binutils ? first_token(value) : translate(value);
+    else if (label == "Version" && is_binutils && occurrence == 0)
+        fields["header.ident version"] = first_token(value);
+    else if (label == "Version" && !is_binutils)
+        fields[occurrence == 0 ? "header.ABI Version" : "header.ident version"] = translate(value);
+    else if (label == "ABI Version")
+        fields["header.ABI Version"] = value;
+    else if (label == "Version")
+        ;       // e_version: binutils only
+    else if (label == "Number of program headers" || label == "Number of section headers" ||
+             label == "Section header string table index")
+        fields["header." + label] = escaped_number(translate(value));
+    else
+        fields["header." + label] = number(first_token(value));
+}
+
+/*
+* This readelf: each section is two lines,
+*
+*   [Nr] Name (16 columns)  Type  Address  Offset
+*        Size  EntSize  Flags  Link  Info  Align
+*
+* where Flags may be empty.
+*/
+void parse_our_section(const std::string& first, const std::string& second, Fields& fields)
+{
+    std::size_t close = first.find(']');
+    std::string index = trim(first.substr(first.find('[') + 1, close - first.find('[') - 1));
+    std::string name = first.size() > close + 2 ? trim(first.substr(close + 2, SECTION_NAME_WIDTH)) : "";
+    std::vector<std::string> head = split(first.size() > close + 2 + SECTION_NAME_WIDTH ?
+                                          first.substr(close + 2 + SECTION_NAME_WIDTH) : "");
+    std::vector<std::string> tail = split(second);
+    if (head.size() != 3 || (tail.size() != 5 && tail.size() != 6))
+    {
+        return;
+    }
+    std::string flags = tail.size() == 6 ? tail[2] : "";
+    std::size_t last = tail.size() - 1;
+
+    std::string key = "sections." + padded_index(index) + ".";
+    fields[key + "name"] = name;
+    fields[key + "type"] = head[0];
+    fields[key + "address"] = number(head[1], 16);
+    fields[key + "offset"] = number(head[2], 16);
+    fields[key + "size"] = number(tail[0], 16);
+    fields[key + "entsize"] = number(tail[1], 16);
+    fields[key + "flags"] = sorted(flags);
+    fields[key + "link"] = number(tail[last - 2], 10);
+    fields[key + "info"] = number(tail[last - 1], 10);
+    fields[key + "align"] = number(tail[last], 10);
+}
+
+/*
+* binutils -W: one line per section,
+*
+*   [Nr] Name Type Address Off Size ES Flg Lk Inf Al
+*
+* The name may be empty and so may Flg.  Read from the right: Al, Inf and Lk, then Address
+* is the 16 digit token four or five tokens before them, depending on whether Flg is there.
+*/
+void parse_binutils_section(const std::string& line, Fields& fields)
+{
+    std::size_t close = line.find(']');
+    std::string index = trim(line.substr(line.find('[') + 1, close - line.find('[') - 1));
+    std::string rest = line.substr(close + 1);
+    std::vector<std::string> tokens;
+    std::vector<std::size_t> starts;
+    for (std::size_t end = 0, start; (start = rest.find_first_not_of(' ', end)) != std::string::npos; )
+    {
+        end = std::min(rest.find(' ', start), rest.size());
+        tokens.push_back(rest.substr(start, end - start));
+        starts.push_back(start);
+    }
+    if (tokens.size() < 8)
+    {
+        return;
+    }
+
+    std::size_t right = tokens.size() - 3;     // Lk
+    std::size_t address = right - 4;
+    bool has_flags = tokens[address].size() != 16 && right >= 5 && tokens[right - 5].size() == 16;
+    if (has_flags)
+    {
+        address = right - 5;
+    }
+    if (address < 1)
+    {
+        return;
+    }
+
+    // The name is whatever precedes the type, which precedes the address.
+    std::string name = trim(rest.substr(0, starts[address - 1]));
+
+    std::string key = "sections." + padded_index(index) + ".";
+    fields[key + "name"] = name.substr(0, SECTION_NAME_WIDTH);
+    fields[key + "type"] = known_or_unknown(tokens[address - 1], section_types);
+    fields[key + "address"] = number(tokens[address], 16);
+    fields[key + "offset"] = number(tokens[address + 1], 16);
+    fields[key + "size"] = number(tokens[address + 2], 16);
+    fields[key + "entsize"] = number(tokens[address + 3], 16);
+    fields[key + "flags"] = sorted(has_flags ? tokens[address + 4] : "");
+    fields[key + "link"] = number(tokens[right], 10);
+    fields[key + "info"] = number(tokens[right + 1], 10);
+    fields[key + "align"] = number(tokens[right + 2], 10);
+}
+
+Fields parse_output(const std::string& text, bool is_binutils)
+{
+    enum { NONE, HEADER, SECTIONS, SYMBOLS } block = NONE;
+    Fields fields;
+    std::map<std::string, int> seen;
+    std::string table;
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    for (std::string line; std::getline(stream, line); )
+    {
+        lines.push_back(line);
+    }
+
+    for (std::size_t i = 0; i < lines.size(); ++i)
+    {
+        const std::string& line = lines[i];
+        if (line == "ELF Header:")
+        {
+            block = HEADER;
+        }
+        else if (line == "Section Headers:")
+        {
+            block = SECTIONS;
+        }
+        else if (starts_with(line, "Symbol table '"))
+        {
+            block = SYMBOLS;
+            table = parse_symbol_title(line, fields);
+        }
+        else if (line.empty() || starts_with(line, "Key to Flags:") || starts_with(line, "There "))
+        {
+            block = NONE;
+        }
+        else if (block == HEADER)
+        {
+            parse_header_line(line, seen, is_binutils, fields);
+        }
+        else if (block == SECTIONS && starts_with(line, "  [") && !starts_with(line, "  [Nr]"))
+        {
+            if (is_binutils)
+            {
+                parse_binutils_section(line, fields);
+            }
+            else if (i + 1 < lines.size())
+            {
+                parse_our_section(line, lines[i + 1], fields);
+                ++i;
+            }
+        }
+        else if (block == SYMBOLS)
+        {
+            parse_symbol_row(line, table, is_binutils, fields);
+        }
+    }
+    return fields;
+}
+
+// binutils readelf: $BINUTILS_READELF, or the first GNU readelf on $PATH.
+std::string find_binutils()
+{
+    std::vector<std::string> candidates;
+    const char *requested = std::getenv("BINUTILS_READELF");
+    if (requested != nullptr && *requested != '\0')
+    {
+        candidates.push_back(requested);
+    }
+    const char *path = std::getenv("PATH");
+    std::istringstream directories(path == nullptr ? "/usr/bin:/bin" : path);
+    for (std::string directory; std::getline(directories, directory, ':'); )
+    {
+        if (!directory.empty())
+        {
+            candidates.push_back(directory + "/readelf");
+        }
+    }
+
+    for (const std::string& candidate : candidates)
+    {
+        if (::access(candidate.c_str(), X_OK) == 0)
+        {
+            ELF::test::Run_result version = run({candidate, "--version"});
+            if (version.status == 0 && starts_with(version.output, "GNU readelf"))
+            {
+                return candidate;
+            }
+        }
+    }
+    return std::string();
+}
+
+bool is_elf64(const std::string& file_path)
+{
+    unsigned char ident[EI_NIDENT];
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd == -1)
+    {
+        return false;
+    }
+    ssize_t length = ::pread(fd, ident, sizeof(ident), 0);
+    ::close(fd);
+    return length == EI_NIDENT && std::memcmp(ident, ELFMAG, SELFMAG) == 0 && ident[EI_CLASS] == ELFCLASS64;
+}
+
+// Up to limit 64-bit ELF files spread evenly over the sorted contents of directory.
+void sample_directory(const std::string& directory, std::size_t limit, std::vector<std::string>& files)
+{
+    DIR *stream = ::opendir(directory.c_str());
+    if (stream == nullptr)
+    {
+        return;
+    }
+    std::vector<std::string> found;
+    struct dirent *entry;
+    while ((entry = ::readdir(stream)) != nullptr)
+    {
+        std::string file_path = directory + "/" + entry->d_name;
+        struct stat st;
+        if (::lstat(file_path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && is_elf64(file_path))
+        {
+            found.push_back(file_path);
+        }
+    }
+    ::closedir(stream);
+
+    std::sort(found.begin(), found.end());
+    std::size_t count = std::min(limit, found.size());
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        files.push_back(found[i * found.size() / count]);
+    }
+}
+
+Elf64_Sym make_symbol(unsigned bind, unsigned type, Elf64_Section section, Elf64_Addr value, Elf64_Xword size)
+{
+    Elf64_Sym symbol;
+    std::memset(&symbol, 0, sizeof(symbol));
+    symbol.st_info = ELF64_ST_INFO(bind, type);
+    symbol.st_shndx = section;
+    symbol.st_value = value;
+    symbol.st_size = size;
+    return symbol;
+}
+
+/*
+* Write the edge-case files into directory and add them to files.  Returns false if one
+* could not be written.
+*/
+bool make_edge_cases(const std::string& directory, std::vector<std::string>& files)
+{
+    Elf64_Sym null_symbol = make_symbol(STB_LOCAL, STT_NOTYPE, SHN_UNDEF, 0, 0);
+    std::vector<std::uint8_t> code(16, 0x90);
+    bool written = true;
+
+    // More sections than e_shnum can hold: the count and .shstrtab index live in section 0.
+    {
+        Elf_builder builder(ET_REL);
+        std::size_t text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, code, 16);
+        while (builder.section_number() < SHN_LORESERVE + 16)
+        {
+            builder.add_section(".filler", SHT_PROGBITS, 0, {});
+        }
+        builder.add_symbol_table({"", "edge.c", "", "entry", "counter"},
+                                 {null_symbol,
+                                  make_symbol(STB_LOCAL, STT_FILE, SHN_ABS, 0, 0),
+                                  make_symbol(STB_LOCAL, STT_SECTION, static_cast<Elf64_Section>(text), 0, 0),
+                                  make_symbol(STB_GLOBAL, STT_FUNC, static_cast<Elf64_Section>(text), 0, 16),
+                                  make_symbol(STB_GLOBAL, STT_OBJECT, SHN_COMMON, 8, 8)});
+        files.push_back(directory + "/extended-numbering.o");
+        written = written && builder.write(files.back());
+    }
+
+    // Extended numbering requested for a small file: readers must still honour it.
+    {
+        Elf_builder builder(ET_REL);
+        builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, code, 16);
+        builder.set_extended_numbering(true);
+        files.push_back(directory + "/escaped-numbering.o");
+        written = written && builder.write(files.back());
+    }
+
+    // A symbol table with no entries at all.
+    {
+        Elf_builder builder(ET_REL);
+        builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, code, 16);
+        builder.add_symbol_table({}, {});
+        files.push_back(directory + "/empty-symtab.o");
+        written = written && builder.write(files.back());
+    }
+
+    // A symbol table holding only the reserved null symbol.
+    {
+        Elf_builder builder(ET_REL);
+        builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, code, 16);
+        builder.add_symbol_table({""}, {null_symbol});
+        files.push_back(directory + "/null-symtab.o");
+        written = written && builder.write(files.back());
+    }
+
+    // A stripped executable: sections but no symbol tables.
+    {
+        Elf_builder builder(ET_EXEC);
+        builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, code, 16);
+        builder.add_section(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, std::vector<std::uint8_t>(8, 1), 8);
+        builder.add_section(".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, {}, 8);
+        builder.set_entry(0x401000);
+        files.push_back(directory + "/stripped");
+        written = written && builder.write(files.back());
+    }
+    return written;
+}
+
+struct Timing
+{
+    std::string file_path;
+    std::size_t fields;
+    double ours;                // milliseconds
+    double binutils;
+};
+
+/*
+* Compare one file.  Prints the mismatches and returns how many there are; fields is set to
+* the number of fields binutils printed.
+*/
+std::size_t compare_file(const std::string& readelf, const std::string& binutils, const std::string& file_path,
+                         Timing& timing)
+{
+    ELF::test::Run_result binutils_run = run({binutils, "-hSsW", file_path});
+    ELF::test::Run_result our_run = run({readelf, "-hSs", file_path});
+    timing = Timing{file_path, 0, our_run.milliseconds, binutils_run.milliseconds};
+    if (our_run.status != 0 && binutils_run.status == 0)
+    {
+        printf("FAIL %s: readelf exited with status %d\n", file_path.c_str(), our_run.status);
+        return 1;
+    }
+
+    Fields expected = parse_output(binutils_run.output, true);
+    Fields actual = parse_output(our_run.output, false);
+    timing.fields = expected.size();
+
+    std::size_t mismatches = 0;
+    auto report = [&](const std::string& key, const char *expected_value, const char *actual_value) {
+        if (mismatches++ < MISMATCHES_SHOWN)
+        {
+            printf("FAIL %s: %s: binutils '%s', readelf '%s'\n", file_path.c_str(), key.c_str(),
+                   expected_value, actual_value);
+        }
+    };
+    for (const auto& field : expected)
+    {
+        auto found = actual.find(field.first);
+        if (found == actual.end())
+            report(field.first, field.second.c_str(), "(missing)");
+        else if (found->second != field.second)
+            report(field.first, field.second.c_str(), found->second.c_str());
+    }
+    for (const auto& field : actual)
+    {
+        if (expected.find(field.first) == expected.end())
+        {
+            report(field.first, "(missing)", field.second.c_str());
+        }
+    }
+    if (mismatches > MISMATCHES_SHOWN)
+    {
+        printf("FAIL %s: %lu more mismatches\n", file_path.c_str(), mismatches - MISMATCHES_SHOWN);
+    }
+    if (expected.empty())
+    {
+        printf("FAIL %s: nothing parsed from binutils readelf\n", file_path.c_str());
+        ++mismatches;
+    }
+    return mismatches;
+}
+
+bool write_timings(const std::string& timings_path, const std::vector<Timing>& timings)
+{
+    std::FILE *out = std::fopen(timings_path.c_str(), "w");
+    if (out == nullptr)
+    {
+        return false;
+    }
+    fprintf(out, "file\tfields\treadelf_ms\tbinutils_ms\n");
+    for (const Timing& timing : timings)
+    {
+        fprintf(out, "%s\t%lu\t%.3f\t%.3f\n", timing.file_path.c_str(), timing.fields, timing.ours, timing.binutils);
+    }
+    return std::fclose(out) == 0;
+}
+
+void usage(std::FILE *out)
+{
+    fprintf(out,
+            "Usage: golden_test [options] READELF [elf-file(s)]\n"
+            " Compare the output of READELF -hSs with binutils readelf -hSsW\n"
+            " Options are:\n"
+            "     --binutils=PATH     binutils readelf to compare with (default: $BINUTILS_READELF,\n"
+            "                         then readelf on $PATH)\n"
+            "     --corpus-limit=N    System files sampled per directory (default %lu, 0 for none)\n"
+            "     --timings=FILE      Write the time taken per file as tab separated values\n",
+            DEFAULT_CORPUS_LIMIT);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    enum
+    {
+        OPTION_BINUTILS = 256,
+        OPTION_CORPUS_LIMIT,
+        OPTION_TIMINGS,
+    };
+    static const struct option long_options[] = {
+        {"binutils",     required_argument, nullptr, OPTION_BINUTILS},
+        {"corpus-limit", required_argument, nullptr, OPTION_CORPUS_LIMIT},
+        {"timings",      required_argument, nullptr, OPTION_TIMINGS},
+        {"help",         no_argument,       nullptr, 'H'},
+        {nullptr,        0,                 nullptr, 0}
+    };
+
+    std::string binutils;
+    std::size_t corpus_limit = DEFAULT_CORPUS_LIMIT;
+    std::string timings_path;
+
+    int option;
+    while ((option = getopt_long(argc, argv, "H", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case OPTION_BINUTILS:
+            binutils = optarg;
+            break;
+        case OPTION_CORPUS_LIMIT:
+            corpus_limit = std::strtoul(optarg, nullptr, 0);
+            break;
+        case OPTION_TIMINGS:
+            timings_path = optarg;
+            break;
+        case 'H':
+            usage(stdout);
+            return EXIT_SUCCESS;
+        default:
+            usage(stderr);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc)
+    {
+        usage(stderr);
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[optind++];
+
+    if (binutils.empty())
+    {
+        binutils = find_binutils();
+    }
+    if (binutils.empty())
+    {
+        printf("binutils readelf not found; skipping\n");
+        return EXIT_SKIPPED;
+    }
+
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> edge_files;
+    if (!make_edge_cases(directory, edge_files))
+    {
+        perror(directory.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> files(edge_files);
+    files.push_back(readelf);
+    for (int i = optind; i < argc; ++i)
+    {
+        files.push_back(argv[i]);
+    }
+    for (const char *system_directory : SYSTEM_DIRECTORIES)
+    {
+        sample_directory(system_directory, corpus_limit, files);
+    }
+
+    printf("Comparing %s with %s on %lu files\n", readelf.c_str(), binutils.c_str(), files.size());
+    std::vector<Timing> timings;
+    std::size_t failed_files = 0;
+    std::size_t fields = 0;
+    double our_total = 0;
+    double binutils_total = 0;
+    for (const std::string& file_path : files)
+    {
+        Timing timing;
+        std::size_t mismatches = compare_file(readelf, binutils, file_path, timing);
+        failed_files += mismatches != 0;
+        fields += timing.fields;
+        our_total += timing.ours;
+        binutils_total += timing.binutils;
+        printf("%-4s %-60s %8lu fields %9.3f ms %9.3f ms\n", mismatches == 0 ? "ok" : "FAIL", file_path.c_str(),
+               timing.fields, timing.ours, timing.binutils);
+        timings.push_back(timing);
+    }
+
+    ELF::test::remove_directory(directory);
+
+    printf("%lu files, %lu fields, %lu failed; readelf %.3f ms, binutils %.3f ms in total\n",
+           files.size(), fields, failed_files, our_total, binutils_total);
+    if (!timings_path.empty() && !write_timings(timings_path, timings))
+    {
+        perror(timings_path.c_str());
+        return EXIT_FAILURE;
+    }
+    return failed_files == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+/*
+* Symbol index test: builds an index over a directory of small shared objects and looks
+* symbols up in it again.  Checked are that
+*
+*   - global and weak definitions and imports are found, definitions first, and local,
+*     section and file symbols are not indexed;
+*   - names outside the string table or holding control characters are left out;
+*   - files whose path holds a tab or a newline are not indexed, so every line of the
+*     index still has exactly three fields;
+*   - every indexed symbol can be looked up, the first and the last included.
+*
+* Usage: index_test
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include <sys/stat.h>
+#include "Elf_builder.h"
+#include "Symbol_index.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+
+struct Dynamic_symbol
+{
+    const char *name;           // nullptr for a name past the end of .dynstr
+    unsigned bind;
+    unsigned type;
+    bool defined;
+};
+
+// A shared object whose .dynsym holds symbols, after the null symbol.
+bool write_shared_object(const std::string& file_path, const std::vector<Dynamic_symbol>& symbols)
+{
+    ELF::test::Elf_builder builder(ET_DYN);
+    std::size_t text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                           std::vector<std::uint8_t>(64, 0xc3), 16);
+
+    std::vector<std::uint8_t> strings(1, 0);
+    std::vector<Elf64_Sym> table(1);
+    std::memset(&table[0], 0, sizeof(table[0]));
+    for (const Dynamic_symbol& symbol : symbols)
+    {
+        Elf64_Sym entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.st_info = ELF64_ST_INFO(symbol.bind, symbol.type);
+        entry.st_shndx = static_cast<Elf64_Section>(symbol.defined ? text : SHN_UNDEF);
+        if (symbol.name == nullptr)
+        {
+            entry.st_name = 0x7fffffff;
+        }
+        else
+        {
+            entry.st_name = static_cast<Elf64_Word>(strings.size());
+            strings.insert(strings.end(), symbol.name, symbol.name + std::strlen(symbol.name) + 1);
+        }
+        table.push_back(entry);
+    }
+
+    std::size_t dynstr = builder.add_section(".dynstr", SHT_STRTAB, SHF_ALLOC, strings);
+    const std::uint8_t *bytes = reinterpret_cast<const std::uint8_t *>(table.data());
+    builder.add_section(".dynsym", SHT_DYNSYM, SHF_ALLOC,
+                        std::vector<std::uint8_t>(bytes, bytes + table.size() * sizeof(Elf64_Sym)), 8,
+                        sizeof(Elf64_Sym), static_cast<Elf64_Word>(dynstr), 1);
+    return builder.write(file_path);
+}
+
+std::string describe(const std::vector<ELF::Symbol_index::Entry>& entries)
+{
+    std::string text;
+    for (const ELF::Symbol_index::Entry& entry : entries)
+    {
+        text += std::string(entry.defined ? " D " : " U ") + entry.file_path;
+    }
+    return text.empty() ? " (none)" : text;
+}
+
+void expect(const ELF::Symbol_index& index, const std::string& name,
+            const std::vector<ELF::Symbol_index::Entry>& expected)
+{
+    std::vector<ELF::Symbol_index::Entry> found = index.find(name);
+    bool same = found.size() == expected.size();
+    for (std::size_t i = 0; same && i < found.size(); ++i)
+    {
+        same = found[i].defined == expected[i].defined && found[i].file_path == expected[i].file_path;
+    }
+    check(same, "lookup of '%s' found%s, expected%s", name.c_str(), describe(found).c_str(),
+          describe(expected).c_str());
+}
+
+} // namespace
+
+int main()
+{
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    std::string root = directory + "/root";
+    std::string library = root + "/lib/libfoo.so";
+    std::string program = root + "/bin/app";
+    std::string index_path = directory + "/symbols.index";
+
+    bool written = ::mkdir(root.c_str(), 0755) == 0 && ::mkdir((root + "/lib").c_str(), 0755) == 0 &&
+                   ::mkdir((root + "/bin").c_str(), 0755) == 0 &&
+                   write_shared_object(library, {{"foo_init", STB_GLOBAL, STT_FUNC, true},
+                                                 {"foo_table", STB_GLOBAL, STT_OBJECT, true},
+                                                 {"foo_hook", STB_WEAK, STT_FUNC, true},
+                                                 {"puts", STB_GLOBAL, STT_FUNC, false},
+                                                 {"foo_local", STB_LOCAL, STT_FUNC, true},
+                                                 {".text", STB_GLOBAL, STT_SECTION, true},
+                                                 {"foo.c", STB_GLOBAL, STT_FILE, true},
+                                                 {"bad\x01name", STB_GLOBAL, STT_FUNC, true},
+                                                 {nullptr, STB_GLOBAL, STT_FUNC, true}}) &&
+                   write_shared_object(program, {{"main", STB_GLOBAL, STT_FUNC, true},
+                                                 {"foo_init", STB_GLOBAL, STT_FUNC, false},
+                                                 {"puts", STB_GLOBAL, STT_FUNC, false}}) &&
+                   write_shared_object(root + "/bin/tab\tname.so", {{"foo_init", STB_GLOBAL, STT_FUNC, true}}) &&
+                   write_shared_object(root + "/bin/new\nline.so", {{"puts", STB_GLOBAL, STT_FUNC, true}}) &&
+                   ELF::test::write_file(root + "/README", "not an ELF file\n");
+    if (!check(written, "cannot write the files under %s", root.c_str()))
+    {
+        ELF::test::remove_directory(directory);
+        return ELF::test::finish("index_test");
+    }
+
+    ELF::Index_statistics statistics;
+    std::error_code error = ELF::build_symbol_index(root, index_path, 2, statistics);
+    check(!error, "cannot build the index: %s", error.message().c_str());
+    check(statistics.files == 3 && statistics.elf_files == 2 && statistics.failed_files == 0 &&
+          statistics.entries == 7, "%lu files, %lu ELF, %lu failed, %lu entries; expected 3, 2, 0 and 7",
+          statistics.files, statistics.elf_files, statistics.failed_files, statistics.entries);
+
+    std::string text = ELF::test::read_file(index_path);
+    std::size_t lines = 0;
+    std::size_t line_start = text.find('\n') + 1;
+    for (std::size_t line_end; (line_end = text.find('\n', line_start)) != std::string::npos; line_start = line_end + 1)
+    {
+        std::string line = text.substr(line_start, line_end - line_start);
+        check(std::count(line.begin(), line.end(), '\t') == 2, "index line without three fields: %s", line.c_str());
+        ++lines;
+    }
+    check(lines == statistics.entries, "%lu index lines, %lu entries", lines, statistics.entries);
+
+    ELF::Symbol_index index;
+    error = index.open(index_path);
+    if (check(!error, "cannot open the index: %s", error.message().c_str()))
+    {
+        expect(index, "foo_init", {{true, library}, {false, program}});
+        expect(index, "foo_table", {{true, library}});
+        expect(index, "foo_hook", {{true, library}});
+        expect(index, "main", {{true, program}});
+        expect(index, "puts", {{false, program}, {false, library}});
+        for (const char *missing : {"foo_local", ".text", "foo.c", "bad\x01name", "foo", "foo_init2", "", "zzz"})
+        {
+            expect(index, missing, {});
+        }
+    }
+    check(static_cast<bool>(ELF::build_symbol_index(root + "/bin/tab\tname.so", directory + "/other.index", 1,
+                                                    statistics)),
+          "a root path with a tab was accepted");
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("index_test");
+}
@@ -0,0 +1,273 @@
+/*
+* Loader test: the loaders that do not map the whole file must show what the mapping shows.
+*
+* Every file is printed with each option by --loader=mmap, by --loader=read through io_uring
+* and through pread (READELF_IO=pread), and from standard input, and the outputs are
+* compared with the mapped one.  The files are this test's own binary, an object with
+* symbols and notes, one with more separate regions than the io_uring queue holds, and one
+* whose section table is present but holds no sections (e_shoff set, e_shnum and section 0's
+* sh_size both 0).
+*
+* The io_uring path is also driven directly: Region_loader must fill exactly the regions a
+* partial load needs with the file's bytes, and leave the rest zero.  A kernel without
+* io_uring is reported and that part skipped.
+*
+* Usage: loader_test READELF
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Elf_builder.h"
+#include "Region_loader.h"
+#include "Sparse_image.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+using ELF::test::run;
+
+// More regions than Region_loader keeps in flight, so the ring's slots are reused.
+const std::size_t NOTE_NUMBER = 100;
+const std::size_t FILLER_LENGTH = 8192;
+
+const std::vector<std::vector<std::string>> option_lists = {
+    {"-h"},
+    {"-S"},
+    {"-s"},
+    {"-s", "--sym-type=FUNC"},
+    {"--sym-histogram"},
+    {"--size-report=5"},
+    {"--build-id"},
+    {"-h", "-S", "-s"},
+    {"-x", ".text"},
+    {"-p", ".strtab"},
+};
+
+std::vector<std::uint8_t> build_note(const char *name, Elf64_Word type, const std::vector<std::uint8_t>& description)
+{
+    Elf64_Nhdr header;
+    header.n_namesz = static_cast<Elf64_Word>(std::strlen(name) + 1);
+    header.n_descsz = static_cast<Elf64_Word>(description.size());
+    header.n_type = type;
+
+    std::vector<std::uint8_t> note(reinterpret_cast<const std::uint8_t *>(&header),
+                                   reinterpret_cast<const std::uint8_t *>(&header) + sizeof(header));
+    note.insert(note.end(), name, name + header.n_namesz);
+    note.resize((note.size() + 3) & ~std::size_t(3), 0);
+    note.insert(note.end(), description.begin(), description.end());
+    note.resize((note.size() + 3) & ~std::size_t(3), 0);
+    return note;
+}
+
+Elf64_Sym make_symbol(unsigned type, std::size_t section, Elf64_Addr value, Elf64_Xword size)
+{
+    Elf64_Sym symbol;
+    std::memset(&symbol, 0, sizeof(symbol));
+    symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, type);
+    symbol.st_shndx = static_cast<Elf64_Section>(section);
+    symbol.st_value = value;
+    symbol.st_size = size;
+    return symbol;
+}
+
+/*
+* Symbols and a build ID, then notes that each sit between filler sections no option asks
+* for, so a partial load reads every note on its own.
+*/
+bool write_notes_file(const std::string& file_path, std::size_t note_number)
+{
+    ELF::test::Elf_builder builder(ET_REL);
+    std::size_t text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                           std::vector<std::uint8_t>(96, 0xc3), 16);
+    std::size_t data = builder.add_section(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+                                           std::vector<std::uint8_t>(48, 7), 8);
+    builder.add_section(".note.gnu.build-id", SHT_NOTE, SHF_ALLOC,
+                        build_note("GNU", NT_GNU_BUILD_ID, {0xde, 0xad, 0xbe, 0xef, 0x01, 0x23, 0x45, 0x67}), 4);
+    for (std::size_t i = 0; i < note_number; ++i)
+    {
+        builder.add_section(".filler", SHT_PROGBITS, 0, std::vector<std::uint8_t>(FILLER_LENGTH, 0xaa));
+        builder.add_section(".note.test", SHT_NOTE, 0,
+                            build_note("test", 1, std::vector<std::uint8_t>(8, static_cast<std::uint8_t>(i))), 4);
+    }
+    builder.add_symbol_table({"", "main", "helper", "table"},
+                             {make_symbol(STT_NOTYPE, SHN_UNDEF, 0, 0), make_symbol(STT_FUNC, text, 0, 64),
+                              make_symbol(STT_FUNC, text, 64, 32), make_symbol(STT_OBJECT, data, 0, 48)});
+    return builder.write(file_path);
+}
+
+/*
+* A section table is there, but neither e_shnum nor section 0 counts any section.  The file
+* ends after section 0: nothing refers to the bytes past it, so a stream would not read them.
+*/
+bool write_empty_table_file(const std::string& file_path)
+{
+    ELF::test::Elf_builder builder(ET_EXEC);
+    builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, std::vector<std::uint8_t>(16, 0x90));
+    std::vector<std::uint8_t> image = builder.build();
+
+    Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(image.data());
+    file_header->e_shnum = 0;
+    file_header->e_shstrndx = SHN_UNDEF;
+    ELF::test::section_header(image, 0).sh_size = 0;
+    image.resize(file_header->e_shoff + sizeof(Elf64_Shdr));
+    return ELF::test::write_image(file_path, image);
+}
+
+std::string describe(const std::vector<std::string>& options)
+{
+    std::string text;
+    for (const std::string& option : options)
+    {
+        text += (text.empty() ? "" : " ") + option;
+    }
+    return text;
+}
+
+void compare_loaders(const std::string& readelf, const std::string& file_path)
+{
+    for (const std::vector<std::string>& options : option_lists)
+    {
+        std::vector<std::string> arguments = {readelf, "--loader=mmap"};
+        arguments.insert(arguments.end(), options.begin(), options.end());
+        arguments.push_back(file_path);
+        ELF::test::Run_result mapped = run(arguments);
+        std::string what = file_path + ": " + describe(options);
+        if (!check(mapped.signal == 0, "%s: mmap killed by signal %d", what.c_str(), mapped.signal))
+        {
+            continue;
+        }
+
+        arguments[1] = "--loader=read";
+        for (const char *method : {"io_uring", "pread"})
+        {
+            ::setenv("READELF_IO", method, 1);
+            ELF::test::Run_result read = run(arguments);
+            check(read.status == mapped.status && read.signal == 0, "%s: %s exits %d (signal %d), mmap %d",
+                  what.c_str(), method, read.status, read.signal, mapped.status);
+            check(read.output == mapped.output, "%s: %s output differs from mmap:\n%s\n--- mmap:\n%s",
+                  what.c_str(), method, read.output.c_str(), mapped.output.c_str());
+            check(read.errors == mapped.errors, "%s: %s errors differ from mmap:\n%s\n--- mmap:\n%s",
+                  what.c_str(), method, read.errors.c_str(), mapped.errors.c_str());
+        }
+        ::unsetenv("READELF_IO");
+
+        // Standard input is named "-" where the size report names the file; errors are not compared.
+        arguments.erase(arguments.begin() + 1);
+        arguments.back() = "-";
+        ELF::test::Run_result streamed = run(arguments, file_path);
+        std::string expected = mapped.output;
+        for (std::size_t at = expected.find(file_path); at != std::string::npos; at = expected.find(file_path, at))
+        {
+            expected.replace(at, file_path.size(), "-");
+        }
+        check(streamed.status == mapped.status && streamed.signal == 0, "%s: stdin exits %d (signal %d), mmap %d",
+              what.c_str(), streamed.status, streamed.signal, mapped.status);
+        check(streamed.output == expected, "%s: stdin output differs from mmap:\n%s\n--- mmap:\n%s",
+              what.c_str(), streamed.output.c_str(), expected.c_str());
+    }
+}
+
+// Load file_path with io_uring directly and compare the image with the file.
+void check_ring_load(const std::string& file_path, unsigned parts)
+{
+    std::string contents = ELF::test::read_file(file_path);
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (!check(fd != -1 && !contents.empty(), "cannot read %s", file_path.c_str()))
+    {
+        return;
+    }
+
+    ELF::Region_loader loader(parts, ELF::Region_loader::Method::io_uring);
+    ELF::Sparse_image image;
+    std::error_code error = loader.load(fd, contents.size(), image);
+    ::close(fd);
+    if (!check(!error, "%s: io_uring load failed: %s", file_path.c_str(), error.message().c_str()))
+    {
+        return;
+    }
+    if (loader.method() != ELF::Region_loader::Method::io_uring)
+    {
+        printf("%s: io_uring is not available, the load used pread; ring not tested\n", file_path.c_str());
+        return;
+    }
+
+    // Inside a needed region the file's bytes, outside it zeros.
+    std::vector<ELF::File_region> regions = ELF::needed_regions(image.data(), parts);
+    std::vector<bool> needed(contents.size(), false);
+    for (const ELF::File_region& region : regions)
+    {
+        for (std::uint64_t i = region.offset; i < region.offset + region.length && i < contents.size(); ++i)
+        {
+            needed[i] = true;
+        }
+    }
+    std::size_t wrong = 0;
+    std::uint64_t bytes = 0;
+    for (std::size_t i = 0; i < contents.size(); ++i)
+    {
+        std::uint8_t expected = needed[i] ? static_cast<std::uint8_t>(contents[i]) : 0;
+        wrong += image.data()[i] != expected;
+        bytes += needed[i];
+    }
+    check(wrong == 0, "%s: %lu bytes of the io_uring image are wrong", file_path.c_str(), wrong);
+    check(loader.bytes_read() >= bytes, "%s: io_uring read %lu bytes of %lu needed", file_path.c_str(),
+          static_cast<unsigned long>(loader.bytes_read()), static_cast<unsigned long>(bytes));
+    printf("%s: io_uring filled %lu regions\n", file_path.c_str(), regions.size());
+}
+
+// The path of this test's own binary, a real and fairly large ELF file.
+std::string own_path()
+{
+    char path[4096];
+    ssize_t length = ::readlink("/proc/self/exe", path, sizeof(path));
+    return length <= 0 || length == sizeof(path) ? std::string() : std::string(path, length);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: loader_test READELF\n");
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[1];
+
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    std::string notes_path = directory + "/notes.o";
+    std::string many_notes_path = directory + "/many-notes.o";
+    std::string empty_table_path = directory + "/empty-table";
+    check(write_notes_file(notes_path, 1), "cannot write %s", notes_path.c_str());
+    check(write_notes_file(many_notes_path, NOTE_NUMBER), "cannot write %s", many_notes_path.c_str());
+    check(write_empty_table_file(empty_table_path), "cannot write %s", empty_table_path.c_str());
+
+    std::string self_path = own_path();
+    check(!self_path.empty(), "cannot find the test binary");
+    for (const std::string& file_path : {self_path, notes_path, many_notes_path, empty_table_path})
+    {
+        if (!file_path.empty())
+        {
+            compare_loaders(readelf, file_path);
+        }
+    }
+
+    check_ring_load(many_notes_path, ELF::load_notes);
+    check_ring_load(many_notes_path, ELF::load_symbols | ELF::load_section_headers);
+    check_ring_load(notes_path, ELF::load_everything);
+    check_ring_load(empty_table_path, ELF::load_everything);
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("loader_test");
+}
@@ -0,0 +1,244 @@
+/*
+* Malformed-file test: runs readelf on files whose names point outside their string tables,
+* whose string table is not terminated or is section 0, and whose symbol tables have a bad
+* entry size or string table link or are section 0.  Every option that prints or matches
+* names must finish without a crash; the files with a bad symbol table must be rejected with
+* a message.
+*
+* Usage: malformed_test READELF
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::Elf_builder;
+using ELF::test::check;
+using ELF::test::run;
+using ELF::test::section_header;
+
+const Elf64_Word FAR_OFFSET = 0x7fffffff;
+
+// Options that read section or symbol names, each run on every file.
+const std::vector<std::vector<std::string>> name_options = {
+    {"-S"},
+    {"-s"},
+    {"-a"},
+    {"--sym-type=FUNC"},
+    {"--sym-name=ma*"},
+    {"--sym-name=*a"},
+    {"--sym-section=.text"},
+    {"--sym-histogram"},
+    {"--size-report"},
+    {"--size-report=2"},
+    {"--loader=read", "-s", "--size-report"},
+};
+
+Elf64_Sym make_symbol(unsigned bind, unsigned type, Elf64_Section section, Elf64_Addr value, Elf64_Xword size)
+{
+    Elf64_Sym symbol;
+    std::memset(&symbol, 0, sizeof(symbol));
+    symbol.st_info = ELF64_ST_INFO(bind, type);
+    symbol.st_shndx = section;
+    symbol.st_value = value;
+    symbol.st_size = size;
+    return symbol;
+}
+
+Elf64_Sym& symbol_at(std::vector<std::uint8_t>& image, std::size_t symbol_section, std::size_t index)
+{
+    return reinterpret_cast<Elf64_Sym *>(image.data() + section_header(image, symbol_section).sh_offset)[index];
+}
+
+/*
+* A small object file: .text, .data, and a symbol table naming a file, a function and an
+* object, after empty_sections empty sections.
+*/
+std::vector<std::uint8_t> make_image(std::size_t& text, std::size_t& symbol_section, std::size_t empty_sections = 0)
+{
+    Elf_builder builder(ET_REL);
+    for (std::size_t i = 0; i < empty_sections; ++i)
+    {
+        builder.add_section(".empty", SHT_PROGBITS, 0, {});
+    }
+    text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, std::vector<std::uint8_t>(32, 0x90), 16);
+    std::size_t data = builder.add_section(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+                                           std::vector<std::uint8_t>(16, 1), 8);
+    symbol_section = builder.add_symbol_table(
+        {"", "bad.c", "main", "helper", "data"},
+        {make_symbol(STB_LOCAL, STT_NOTYPE, SHN_UNDEF, 0, 0),
+         make_symbol(STB_LOCAL, STT_FILE, SHN_ABS, 0, 0),
+         make_symbol(STB_GLOBAL, STT_FUNC, static_cast<Elf64_Section>(text), 0, 16),
+         make_symbol(STB_GLOBAL, STT_FUNC, static_cast<Elf64_Section>(text), 16, 16),
+         make_symbol(STB_GLOBAL, STT_OBJECT, static_cast<Elf64_Section>(data), 0, 8)});
+    return builder.build();
+}
+
+struct Case
+{
+    std::string name;
+    std::vector<std::uint8_t> image;
+    bool rejected;          // readelf must refuse the file with an error
+};
+
+std::vector<Case> make_cases()
+{
+    std::vector<Case> cases;
+    std::size_t text, symbol_section;
+
+    // Section and symbol names far past the end of their string tables.
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        section_header(image, text).sh_name = FAR_OFFSET;
+        section_header(image, symbol_section).sh_name = FAR_OFFSET;
+        for (std::size_t i = 1; i < 5; ++i)
+        {
+            symbol_at(image, symbol_section, i).st_name = FAR_OFFSET;
+        }
+        cases.push_back({"far-names.o", image, false});
+    }
+
+    // Names exactly at sh_size, and a string table whose last string has no terminator.
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        Elf64_Shdr& strings = section_header(image, section_header(image, symbol_section).sh_link);
+        symbol_at(image, symbol_section, 2).st_name = static_cast<Elf64_Word>(strings.sh_size);
+        strings.sh_size -= 1;
+        cases.push_back({"unterminated-strtab.o", image, false});
+    }
+
+    // The section name table is not a string table at all.
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        reinterpret_cast<Elf64_Ehdr *>(image.data())->e_shstrndx = static_cast<Elf64_Half>(text);
+        cases.push_back({"shstrndx-not-strtab.o", image, false});
+    }
+
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        section_header(image, symbol_section).sh_entsize = 16;
+        cases.push_back({"symtab-entsize-16.o", image, true});
+    }
+
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        section_header(image, symbol_section).sh_entsize = 0;
+        cases.push_back({"symtab-entsize-0.o", image, true});
+    }
+
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        section_header(image, symbol_section).sh_link = static_cast<Elf64_Word>(text);
+        cases.push_back({"symtab-link-progbits.o", image, true});
+    }
+
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        section_header(image, symbol_section).sh_link = FAR_OFFSET;
+        cases.push_back({"symtab-link-out-of-range.o", image, true});
+    }
+
+    // The symbol table links to section 0, typed as a string table but without data.
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section);
+        section_header(image, 0).sh_type = SHT_STRTAB;
+        section_header(image, symbol_section).sh_link = 0;
+        cases.push_back({"symtab-link-0.o", image, false});
+    }
+
+    // Section 0 holds the extended section count in sh_size, and says it is a symbol table of
+    // more than one entry.
+    {
+        std::vector<std::uint8_t> image = make_image(text, symbol_section, 2 * sizeof(Elf64_Sym));
+        Elf64_Ehdr *file_header = reinterpret_cast<Elf64_Ehdr *>(image.data());
+        Elf64_Shdr& first = section_header(image, 0);
+        first.sh_type = SHT_SYMTAB;
+        first.sh_entsize = sizeof(Elf64_Sym);
+        first.sh_link = section_header(image, symbol_section).sh_link;
+        first.sh_size = file_header->e_shnum;
+        file_header->e_shnum = 0;
+        cases.push_back({"symtab-section-0.o", image, true});
+    }
+    return cases;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: malformed_test READELF\n");
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[1];
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (const Case& test_case : make_cases())
+    {
+        std::string file_path = directory + "/" + test_case.name;
+        if (!check(ELF::test::write_image(file_path, test_case.image), "cannot write %s", file_path.c_str()))
+        {
+            continue;
+        }
+
+        for (const std::vector<std::string>& options : name_options)
+        {
+            std::vector<std::string> arguments{readelf};
+            arguments.insert(arguments.end(), options.begin(), options.end());
+            arguments.push_back(file_path);
+            ELF::test::Run_result result = run(arguments);
+
+            std::string command = options[0] + (options.size() > 1 ? " ..." : "");
+            check(result.signal == 0, "%s %s: killed by signal %d", test_case.name.c_str(), command.c_str(),
+                  result.signal);
+            if (test_case.rejected)
+            {
+                check(result.status == EXIT_FAILURE &&
+                      result.errors.find("Symbol table has a bad entry size") != std::string::npos,
+                      "%s %s: not rejected (status %d, errors '%s')", test_case.name.c_str(), command.c_str(),
+                      result.status, result.errors.c_str());
+            }
+            else
+            {
+                check(result.status == EXIT_SUCCESS, "%s %s: status %d, errors '%s'", test_case.name.c_str(),
+                      command.c_str(), result.status, result.errors.c_str());
+            }
+        }
+    }
+
+    // The names that point outside the table read as empty; the ones inside still print.
+    {
+        ELF::test::Run_result result = run({readelf, "-s", directory + "/unterminated-strtab.o"});
+        check(result.output.find(" bad.c\n") != std::string::npos && result.output.find(" helper\n") != std::string::npos,
+              "unterminated-strtab.o -s: good names missing:\n%s", result.output.c_str());
+        check(result.output.find(" data") == std::string::npos && result.output.find(" main") == std::string::npos,
+              "unterminated-strtab.o -s: names outside the table printed:\n%s", result.output.c_str());
+
+        result = run({readelf, "--sym-type=FUNC", directory + "/far-names.o"});
+        check(result.output.find("2 of them match the filter") != std::string::npos,
+              "far-names.o --sym-type=FUNC: wrong selection:\n%s", result.output.c_str());
+
+        // Without a string table every name is empty: only a pattern matching "" selects.
+        result = run({readelf, "--sym-name=ma*", directory + "/symtab-link-0.o"});
+        check(result.output.find("0 of them match the filter") != std::string::npos,
+              "symtab-link-0.o --sym-name=ma*: wrong selection:\n%s", result.output.c_str());
+        result = run({readelf, "--sym-name=*", directory + "/symtab-link-0.o"});
+        check(result.output.find("5 of them match the filter") != std::string::npos,
+              "symtab-link-0.o --sym-name=*: wrong selection:\n%s", result.output.c_str());
+    }
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("malformed_test");
+}
@@ -0,0 +1,345 @@
+/*
+* Query server test: starts readelf --server and checks that
+*
+*   - it refuses to replace a file at the socket path that is not a socket, and replaces a
+*     socket left behind by an earlier server;
+*   - answers match what the command line tool prints, size-report takes a checked symbol
+*     count, and a file with names outside its string tables gets an answer without taking
+*     the server down;
+*   - a client that shuts down its sending side while a request is being answered costs no
+*     CPU time while it waits (a FIFO holds the worker until the test writes to it);
+*   - a client that sends many more requests than the server keeps pending at once gets
+*     every answer, in order.
+*
+* Usage: server_test READELF
+*/
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+using ELF::test::run;
+
+const long START_TIMEOUT_MS = 5000;
+const long IDLE_WINDOW_MS = 500;
+const long IDLE_CPU_LIMIT_MS = 100;
+const std::size_t MANY_REQUESTS = 500;
+
+// Server commands and the options that print the same text.
+struct Command
+{
+    const char *request;
+    const char *option;
+};
+
+const Command commands[] = {
+    {"header", "-h"},
+    {"sections", "-S"},
+    {"symbols", "-s"},
+    {"histogram", "--sym-histogram"},
+    {"size-report", "--size-report"},
+};
+
+int connect_to(const std::string& socket_path)
+{
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1)
+    {
+        ::close(fd);
+        return -1;
+    }
+    struct timeval timeout = {10, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+int wait_for_server(const std::string& socket_path)
+{
+    for (long waited = 0; waited < START_TIMEOUT_MS; waited += 10)
+    {
+        int fd = connect_to(socket_path);
+        if (fd != -1)
+        {
+            return fd;
+        }
+        ELF::test::pause_for(10);
+    }
+    return -1;
+}
+
+bool send_all(int fd, const std::string& text)
+{
+    std::size_t sent = 0;
+    while (sent < text.size())
+    {
+        ssize_t length = ::write(fd, text.data() + sent, text.size() - sent);
+        if (length == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (length <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<std::size_t>(length);
+    }
+    return true;
+}
+
+// Reads one answer: the body of "OK <length>", or the whole "ERR ..." line.  "" on failure.
+class Answer_reader
+{
+public:
+    explicit Answer_reader(int fd) : fd_(fd) { }
+
+    std::string next()
+    {
+        std::size_t end;
+        while ((end = buffer_.find('\n')) == std::string::npos)
+        {
+            if (!fill())
+            {
+                return std::string();
+            }
+        }
+        std::string line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+        if (line.compare(0, 3, "OK ") != 0)
+        {
+            return line;
+        }
+
+        std::size_t length = std::strtoul(line.c_str() + 3, nullptr, 10);
+        while (buffer_.size() < length)
+        {
+            if (!fill())
+            {
+                return std::string();
+            }
+        }
+        std::string body = buffer_.substr(0, length);
+        buffer_.erase(0, length);
+        return body;
+    }
+
+    // True when the server has closed the connection and nothing is left unread.
+    bool at_end()
+    {
+        return buffer_.empty() && !fill();
+    }
+
+private:
+    bool fill()
+    {
+        char chunk[65536];
+        ssize_t length;
+        while ((length = ::read(fd_, chunk, sizeof(chunk))) == -1 && errno == EINTR)
+        {
+        }
+        if (length <= 0)
+        {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<std::size_t>(length));
+        return true;
+    }
+
+    int fd_;
+    std::string buffer_;
+};
+
+std::string ask(const std::string& socket_path, const std::string& request)
+{
+    int fd = connect_to(socket_path);
+    if (fd == -1 || !send_all(fd, request + "\n"))
+    {
+        if (fd != -1)
+        {
+            ::close(fd);
+        }
+        return std::string();
+    }
+    Answer_reader reader(fd);
+    std::string answer = reader.next();
+    ::close(fd);
+    return answer;
+}
+
+// An object file whose symbol and section names point far outside their string tables.
+bool write_far_names(const std::string& file_path)
+{
+    ELF::test::Elf_builder builder(ET_REL);
+    std::size_t text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                           std::vector<std::uint8_t>(16, 0x90), 16);
+    Elf64_Sym symbols[2];
+    std::memset(symbols, 0, sizeof(symbols));
+    symbols[1].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+    symbols[1].st_shndx = static_cast<Elf64_Section>(text);
+    symbols[1].st_size = 16;
+    std::size_t symbol_section = builder.add_symbol_table({"", "main"}, {symbols[0], symbols[1]});
+
+    std::vector<std::uint8_t> image = builder.build();
+    ELF::test::section_header(image, text).sh_name = 0x7fffffff;
+    Elf64_Shdr& table = ELF::test::section_header(image, symbol_section);
+    reinterpret_cast<Elf64_Sym *>(image.data() + table.sh_offset)[1].st_name = 0x7fffffff;
+    return ELF::test::write_image(file_path, image);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: server_test READELF\n");
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[1];
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    std::string socket_path = directory + "/socket";
+
+    // A regular file at the socket path is left alone and the server does not start.
+    ELF::test::write_file(socket_path, "not a socket\n");
+    int refused = ELF::test::wait_for(ELF::test::start({readelf, "--server=" + socket_path}), START_TIMEOUT_MS);
+    check(refused == EXIT_FAILURE, "server started over a regular file (status %d)", refused);
+    check(ELF::test::read_file(socket_path) == "not a socket\n", "regular file at the socket path was replaced");
+    ::unlink(socket_path.c_str());
+
+    // A socket left behind by an earlier server is replaced.
+    {
+        int stale = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        struct sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+        check(::bind(stale, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0,
+              "cannot leave a stale socket: %s", std::strerror(errno));
+        ::close(stale);
+    }
+
+    pid_t server = ELF::test::start({readelf, "--server=" + socket_path, "--workers=1"});
+    int first = wait_for_server(socket_path);
+    if (!check(first != -1, "server did not start on a stale socket"))
+    {
+        ELF::test::stop(server, SIGKILL);
+        ELF::test::remove_directory(directory);
+        return ELF::test::finish("server_test");
+    }
+    ::close(first);
+
+    // Answers are what the command line prints.
+    check(ask(socket_path, "header " + readelf) == run({readelf, "-h", readelf}).output,
+          "header answer differs from readelf -h");
+    check(ask(socket_path, "symbols " + readelf) == run({readelf, "-s", readelf}).output,
+          "symbols answer differs from readelf -s");
+    check(ask(socket_path, "frobnicate " + readelf).compare(0, 4, "ERR ") == 0, "unknown command not refused");
+
+    std::string far_names = directory + "/far-names.o";
+    check(write_far_names(far_names), "cannot write %s", far_names.c_str());
+    for (const Command& command : commands)
+    {
+        std::string answer = ask(socket_path, std::string(command.request) + " " + far_names);
+        check(!answer.empty() && answer == run({readelf, command.option, far_names}).output,
+              "%s far-names.o: answer differs from readelf %s", command.request, command.option);
+    }
+    check(ask(socket_path, "header " + readelf) == run({readelf, "-h", readelf}).output,
+          "server stopped answering after a file with names outside its string tables");
+
+    // size-report takes an optional count of symbols to list, which is checked.
+    check(ask(socket_path, "size-report 3 " + readelf) == run({readelf, "--size-report=3", readelf}).output,
+          "size-report 3 differs from readelf --size-report=3");
+    check(ask(socket_path, "size-report 0 " + readelf) == run({readelf, "--size-report=0", readelf}).output,
+          "size-report 0 differs from readelf --size-report=0");
+    check(ask(socket_path, "size-report " + readelf) == run({readelf, "--size-report=20", readelf}).output,
+          "size-report without a count does not list 20 symbols");
+    check(ask(socket_path, "size-report 10001 " + readelf).compare(0, 4, "ERR ") == 0, "size-report 10001 accepted");
+    check(ask(socket_path, "size-report 99999999999999999999 " + readelf).compare(0, 4, "ERR ") == 0,
+          "size-report with an overflowing count accepted");
+    check(ask(socket_path, "size-report 5 ") == "ERR malformed request", "size-report without a path accepted");
+
+    // A half-closed client waiting on a busy request does not spin the event loop.
+    std::string fifo = directory + "/fifo";
+    if (check(::mkfifo(fifo.c_str(), 0600) == 0, "mkfifo: %s", std::strerror(errno)))
+    {
+        int fd = connect_to(socket_path);
+        check(fd != -1 && send_all(fd, "header " + fifo + "\n") && ::shutdown(fd, SHUT_WR) == 0,
+              "cannot send the FIFO request");
+        ELF::test::pause_for(50);
+        long before = ELF::test::cpu_milliseconds(server);
+        ELF::test::pause_for(IDLE_WINDOW_MS);
+        long used = ELF::test::cpu_milliseconds(server) - before;
+        check(before >= 0 && used < IDLE_CPU_LIMIT_MS,
+              "server used %ld ms of CPU in %ld ms while a half-closed client waited", used, IDLE_WINDOW_MS);
+
+        // Opening the FIFO for writing releases the worker; the answer is an error.
+        int writer = ::open(fifo.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        check(writer != -1, "the worker is not waiting on the FIFO: %s", std::strerror(errno));
+        ::close(writer);
+        Answer_reader reader(fd);
+        check(reader.next().compare(0, 4, "ERR ") == 0, "FIFO request not answered with an error");
+        check(reader.at_end(), "connection not closed after the last answer");
+        ::close(fd);
+    }
+
+    // Many more requests than the server keeps pending: all are answered, in order.
+    {
+        int fd = connect_to(socket_path);
+        std::string expected_header = run({readelf, "-h", readelf}).output;
+        std::string requests;
+        for (std::size_t i = 0; i < MANY_REQUESTS; ++i)
+        {
+            requests += i % 2 == 0 ? "header " + readelf + "\n" : "frobnicate " + std::to_string(i) + "\n";
+        }
+        check(fd != -1 && send_all(fd, requests) && ::shutdown(fd, SHUT_WR) == 0, "cannot send the requests");
+
+        Answer_reader reader(fd);
+        std::size_t answered = 0;
+        for (; answered < MANY_REQUESTS; ++answered)
+        {
+            std::string answer = reader.next();
+            std::string expected = answered % 2 == 0 ? expected_header :
+                                   "ERR unknown command 'frobnicate'";
+            if (!check(answer == expected, "answer %lu out of order or missing", answered))
+            {
+                break;
+            }
+        }
+        check(answered == MANY_REQUESTS && reader.at_end(), "%lu of %lu requests answered", answered, MANY_REQUESTS);
+        ::close(fd);
+    }
+
+    check(ELF::test::stop(server, SIGTERM) == 0, "server did not shut down cleanly");
+    struct stat st;
+    check(::lstat(socket_path.c_str(), &st) == -1, "socket left behind after shutdown");
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("server_test");
+}
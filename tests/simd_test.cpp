@@ -0,0 +1,271 @@
+/*
+* SIMD kernel test: every kernel in Simd_scan.h must give the scalar answer at every level.
+*
+* The kernels are chosen once per process, so the test runs itself again with
+* READELF_SIMD=scalar, sse2 and avx2.  Each run feeds every kernel the same generated
+* inputs, with lengths and start offsets on both sides of the 16- and 32-byte vector widths
+* (and of 4 and 8 symbols, the SSE2 and AVX2 batches), and prints one line per call.  The
+* sse2 and avx2 outputs are compared with the scalar one line by line.  A level the CPU
+* does not have is reported and not compared.
+*
+* Usage: simd_test [--emit]
+*/
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include "Simd_scan.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+
+const char *const LEVELS[] = {"scalar", "sse2", "avx2"};
+
+// Lengths around the vector widths, in bytes or symbols.
+const std::size_t MAX_LENGTH = 100;
+const std::size_t MAX_OFFSET = 33;
+const std::size_t MAX_SYMBOLS = 70;
+
+class Sequence
+{
+public:
+    explicit Sequence(std::uint32_t seed) : state_(seed) { }
+
+    std::uint32_t next(std::uint32_t bound)
+    {
+        state_ = state_ * 1103515245u + 12345u;
+        return (state_ >> 8) % bound;
+    }
+
+private:
+    std::uint32_t state_;
+};
+
+std::vector<Elf64_Sym> make_symbols(Sequence& sequence, std::size_t number)
+{
+    static const Elf64_Addr values[] = {0, 1, 0x1000, 0x1fff, 0x2000, 0x7fffffffffffffffull,
+                                        0x8000000000000000ull, 0xffffffffffffffffull};
+    static const Elf64_Section sections[] = {SHN_UNDEF, 1, 2, 7, SHN_ABS, SHN_COMMON, SHN_XINDEX};
+    std::vector<Elf64_Sym> symbols(number);
+    for (Elf64_Sym& symbol : symbols)
+    {
+        std::memset(&symbol, 0, sizeof(symbol));
+        symbol.st_name = sequence.next(1000);
+        symbol.st_info = static_cast<unsigned char>(sequence.next(256));
+        symbol.st_other = static_cast<unsigned char>(sequence.next(4));
+        symbol.st_shndx = sections[sequence.next(7)];
+        symbol.st_value = sequence.next(2) == 0 ? values[sequence.next(8)] : sequence.next(0x3000);
+        symbol.st_size = sequence.next(100);
+    }
+    return symbols;
+}
+
+std::vector<ELF::Symbol_predicate> make_predicates()
+{
+    std::vector<ELF::Symbol_predicate> predicates;
+    const std::uint32_t type_masks[] = {~0u, 1u << STT_FUNC, (1u << STT_OBJECT) | (1u << STT_TLS), 0u, 0x8000u};
+    const std::uint32_t bind_masks[] = {~0u, 1u << STB_GLOBAL, (1u << STB_WEAK) | (1u << 15)};
+    for (std::uint32_t type_mask : type_masks)
+    {
+        for (std::uint32_t bind_mask : bind_masks)
+        {
+            predicates.push_back({type_mask, bind_mask, true, 0, 0, ~Elf64_Addr(0)});
+            predicates.push_back({type_mask, bind_mask, false, 2, 0, ~Elf64_Addr(0)});
+            predicates.push_back({type_mask, bind_mask, false, SHN_UNDEF, 0x1000, 0xfff});
+            predicates.push_back({type_mask, bind_mask, true, 0, 0x7fffffffffffffffull, 1});
+            predicates.push_back({type_mask, bind_mask, false, SHN_COMMON, 0x8000000000000000ull,
+                                  0x7fffffffffffffffull});
+        }
+    }
+    return predicates;
+}
+
+// A string of length bytes, each drawn from alphabet (which may contain NUL).
+std::string make_text(Sequence& sequence, std::size_t length, const char *alphabet, std::size_t alphabet_size)
+{
+    std::string text(length, '\0');
+    for (char& c : text)
+    {
+        c = alphabet[sequence.next(static_cast<std::uint32_t>(alphabet_size))];
+    }
+    return text;
+}
+
+/*
+* Call every kernel on the generated inputs and print one line per call.  Inputs are copied
+* to a buffer at the given offset from a 64-byte boundary so the vector loads start both
+* aligned and misaligned.
+*/
+void emit(std::FILE *out)
+{
+    fprintf(out, "level %s\n", ELF::simd_level_name(ELF::simd_level()));
+    Sequence sequence(29);
+    alignas(64) static char buffer[64 + MAX_OFFSET + MAX_LENGTH + 64];
+
+    std::vector<ELF::Symbol_predicate> predicates = make_predicates();
+    for (std::size_t number = 0; number <= MAX_SYMBOLS; ++number)
+    {
+        std::vector<Elf64_Sym> symbols = make_symbols(sequence, number);
+        for (std::size_t p = 0; p < predicates.size(); ++p)
+        {
+            std::vector<std::uint32_t> indices(number + 1, 0xffffffff);
+            std::size_t count = ELF::scan_symbols(symbols.data(), number, predicates[p], indices.data());
+            fprintf(out, "scan_symbols %lu %lu:", number, p);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                fprintf(out, " %u", indices[i]);
+            }
+            fprintf(out, "\n");
+        }
+
+        ELF::Symbol_histogram histogram;
+        ELF::histogram_symbols(symbols.data(), number, histogram);
+        fprintf(out, "histogram_symbols %lu:", number);
+        for (std::uint64_t count : histogram.type)
+            fprintf(out, " %" PRIu64, count);
+        fprintf(out, " |");
+        for (std::uint64_t count : histogram.bind)
+            fprintf(out, " %" PRIu64, count);
+        fprintf(out, " |");
+        for (std::size_t i = 0; i < histogram.section.size(); ++i)
+        {
+            if (histogram.section[i] != 0)
+                fprintf(out, " %lu=%" PRIu64, i, histogram.section[i]);
+        }
+        fprintf(out, "\n");
+    }
+
+    static const char terminators[] = {'a', 'b', '\0', 'c'};
+    static const char prefix_text[] = {'a', 'b', 'a', 'c', '\0'};
+    static const char printable[] = {'a', ' ', '~', '\t', '\x7f', '\x80', '\0', 'Z'};
+    static const char *const prefixes[] = {"a", "ab", "aba", "abacabac"};
+    for (std::size_t length = 0; length <= MAX_LENGTH; ++length)
+    {
+        for (std::size_t offset = 0; offset <= MAX_OFFSET; offset += length < 40 ? 1 : 7)
+        {
+            char *begin = buffer + 64 + offset;
+            char *end = begin + length;
+
+            // One terminator at each position in turn (none when it is past the end), then random text.
+            for (std::size_t position = 0; position <= length; position += length < 40 ? 1 : 5)
+            {
+                std::memset(begin, 'x', length);
+                if (position < length)
+                    begin[position] = '\0';
+                fprintf(out, "find_terminator %lu %lu %lu: %ld\n", length, offset, position,
+                        static_cast<long>(ELF::find_terminator(begin, end) - begin));
+            }
+
+            std::string text = make_text(sequence, length, terminators, sizeof(terminators));
+            std::memcpy(begin, text.data(), length);
+            fprintf(out, "find_terminator %lu %lu random: %ld\n", length, offset,
+                    static_cast<long>(ELF::find_terminator(begin, end) - begin));
+            fprintf(out, "count_strings %lu %lu: %lu\n", length, offset, ELF::count_strings(begin, end));
+
+            text = make_text(sequence, length, prefix_text, sizeof(prefix_text));
+            std::memcpy(begin, text.data(), length);
+            for (const char *prefix : prefixes)
+            {
+                std::vector<std::uint64_t> bitmap((length + 63) / 64 + 1, 0);
+                ELF::mark_prefix(begin, end, prefix, std::strlen(prefix), bitmap.data());
+                fprintf(out, "mark_prefix %lu %lu %s:", length, offset, prefix);
+                for (std::uint64_t word : bitmap)
+                    fprintf(out, " %016" PRIx64, word);
+                fprintf(out, "\n");
+            }
+
+            text = make_text(sequence, length, printable, sizeof(printable));
+            std::memcpy(begin, text.data(), length);
+            fprintf(out, "printable_run_end %lu %lu: %ld %ld\n", length, offset,
+                    static_cast<long>(ELF::printable_run_end(begin, end, true) - begin),
+                    static_cast<long>(ELF::printable_run_end(begin, end, false) - begin));
+        }
+    }
+
+    for (std::size_t lines = 1; lines <= 5; ++lines)
+    {
+        std::vector<std::uint8_t> data(lines * ELF::HEX_LINE_BYTES);
+        for (std::uint8_t& byte : data)
+        {
+            byte = static_cast<std::uint8_t>(sequence.next(256));
+        }
+        std::string text(lines * (ELF::HEX_LINE_LENGTH + 1), '|');
+        ELF::format_hex_lines(data.data(), lines, &text[0], ELF::HEX_LINE_LENGTH + 1);
+        fprintf(out, "format_hex_lines %lu: %s\n", lines, text.c_str());
+    }
+}
+
+std::vector<std::string> split_lines(const std::string& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    for (std::string line; std::getline(stream, line); )
+    {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && std::strcmp(argv[1], "--emit") == 0)
+    {
+        emit(stdout);
+        return EXIT_SUCCESS;
+    }
+    if (argc != 1)
+    {
+        fprintf(stderr, "Usage: simd_test [--emit]\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> scalar;
+    for (const char *level : LEVELS)
+    {
+        ::setenv("READELF_SIMD", level, 1);
+        ELF::test::Run_result result = ELF::test::run({"/proc/self/exe", "--emit"});
+        if (!check(result.status == EXIT_SUCCESS, "READELF_SIMD=%s: status %d, signal %d", level, result.status,
+                   result.signal))
+        {
+            continue;
+        }
+
+        std::vector<std::string> lines = split_lines(result.output);
+        std::string chosen = lines.empty() ? "" : lines[0].substr(6);
+        if (chosen != level)
+        {
+            printf("READELF_SIMD=%s: this CPU runs the %s kernels; not compared\n", level, chosen.c_str());
+            continue;
+        }
+        if (scalar.empty())
+        {
+            scalar = lines;
+            printf("scalar: %lu kernel calls\n", lines.size() - 1);
+            continue;
+        }
+
+        std::size_t differences = 0;
+        check(lines.size() == scalar.size(), "%s: %lu lines of output, scalar %lu", level, lines.size(),
+              scalar.size());
+        for (std::size_t i = 1; i < lines.size() && i < scalar.size(); ++i)
+        {
+            if (lines[i] != scalar[i] && differences++ < 10)
+            {
+                check(false, "%s differs from scalar:\n  %s\n  %s", level, lines[i].c_str(), scalar[i].c_str());
+            }
+        }
+        check(differences == 0, "%s: %lu calls differ from scalar", level, differences);
+        printf("%s: %lu kernel calls compared with scalar\n", level, lines.size() - 1);
+    }
+    ::unsetenv("READELF_SIMD");
+    return ELF::test::finish("simd_test");
+}
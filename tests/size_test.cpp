@@ -0,0 +1,288 @@
+/*
+* Size report test: readelf --size-report=N must print what a plain reference computes
+* from the raw headers and symbols of the file:
+*
+*   - file and memory bytes per section, NOBITS and non-ALLOC sections included, and the
+*     headers and padding left over;
+*   - symbol bytes and counts per section, leaving out section, file, undefined, zero sized
+*     and special-index symbols;
+*   - local symbols charged to the STT_FILE before them, global ones and locals before any
+*     STT_FILE to "(global symbols)", and a file symbol without a name shown as "(unnamed)";
+*   - the N largest symbols for N of 0, less than and more than the symbols there are;
+*   - .dynsym when there is no .symtab, and the note when there is neither;
+*   - counts that are not a number or above the limit are refused.
+*
+* Usage: size_test READELF
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include "Elf_builder.h"
+#include "Symbol_filter.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+using ELF::test::run;
+
+Elf64_Sym make_symbol(unsigned bind, unsigned type, std::size_t section, Elf64_Xword size)
+{
+    Elf64_Sym symbol;
+    std::memset(&symbol, 0, sizeof(symbol));
+    symbol.st_info = ELF64_ST_INFO(bind, type);
+    symbol.st_shndx = static_cast<Elf64_Section>(section);
+    symbol.st_size = size;
+    return symbol;
+}
+
+std::vector<std::uint8_t> build_objects_image(bool dynamic)
+{
+    ELF::test::Elf_builder builder(ET_REL);
+    std::size_t text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                           std::vector<std::uint8_t>(4096, 0x90), 16);
+    std::size_t data = builder.add_section(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+                                           std::vector<std::uint8_t>(512, 1), 8);
+    std::size_t bss = builder.add_section(".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, {}, 8);
+    builder.add_section(".comment", SHT_PROGBITS, SHF_MERGE | SHF_STRINGS, std::vector<std::uint8_t>(64, 'c'));
+
+    std::vector<std::string> names = {"", "early", "a.c", "static_a", "counter", "b.c", "helper", "",
+                                      "anonymous", "main", "table", "weak_fn", "imported", ".text", "marker",
+                                      "absolute", "common"};
+    std::vector<Elf64_Sym> symbols = {
+        make_symbol(STB_LOCAL, STT_NOTYPE, SHN_UNDEF, 0),
+        make_symbol(STB_LOCAL, STT_OBJECT, data, 5),
+        make_symbol(STB_LOCAL, STT_FILE, SHN_ABS, 0),
+        make_symbol(STB_LOCAL, STT_FUNC, text, 100),
+        make_symbol(STB_LOCAL, STT_OBJECT, bss, 8),
+        make_symbol(STB_LOCAL, STT_FILE, SHN_ABS, 0),
+        make_symbol(STB_LOCAL, STT_FUNC, text, 300),
+        make_symbol(STB_LOCAL, STT_FILE, SHN_ABS, 0),
+        make_symbol(STB_LOCAL, STT_OBJECT, data, 12),
+        make_symbol(STB_GLOBAL, STT_FUNC, text, 700),
+        make_symbol(STB_GLOBAL, STT_OBJECT, data, 256),
+        make_symbol(STB_WEAK, STT_FUNC, text, 50),
+        make_symbol(STB_GLOBAL, STT_FUNC, SHN_UNDEF, 10),
+        make_symbol(STB_LOCAL, STT_SECTION, text, 99),
+        make_symbol(STB_GLOBAL, STT_NOTYPE, text, 0),
+        make_symbol(STB_GLOBAL, STT_OBJECT, SHN_ABS, 40),
+        make_symbol(STB_GLOBAL, STT_OBJECT, SHN_COMMON, 64),
+    };
+    std::size_t symtab = builder.add_symbol_table(names, symbols);
+    std::vector<std::uint8_t> image = builder.build();
+    if (dynamic)
+    {
+        ELF::test::section_header(image, symtab).sh_type = SHT_DYNSYM;
+    }
+    return image;
+}
+
+std::vector<std::uint8_t> build_plain_image()
+{
+    ELF::test::Elf_builder builder(ET_EXEC);
+    builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, std::vector<std::uint8_t>(100, 0x90));
+    builder.add_section(".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE, {});
+    return builder.build();
+}
+
+// The report computed straight from image, a file written by Elf_builder.
+std::string reference_report(const std::string& file_path, std::vector<std::uint8_t>& image, std::size_t top)
+{
+    const Elf64_Ehdr& file_header = *reinterpret_cast<const Elf64_Ehdr *>(image.data());
+    std::size_t section_count = file_header.e_shnum;
+    const Elf64_Shdr& names = ELF::test::section_header(image, file_header.e_shstrndx);
+    auto section_name = [&](std::size_t i) {
+        return std::string(reinterpret_cast<const char *>(image.data() + names.sh_offset +
+                                                          ELF::test::section_header(image, i).sh_name));
+    };
+
+    std::size_t symbol_section = 0;
+    for (std::size_t i = 1; i < section_count; ++i)
+    {
+        Elf64_Word type = ELF::test::section_header(image, i).sh_type;
+        if (type == SHT_SYMTAB || (type == SHT_DYNSYM && symbol_section == 0))
+            symbol_section = i;
+    }
+
+    std::vector<Elf64_Xword> symbol_bytes(section_count, 0);
+    std::vector<std::size_t> symbol_counts(section_count, 0);
+    std::map<std::string, std::pair<Elf64_Xword, std::size_t>> files;
+    std::vector<std::pair<Elf64_Xword, std::size_t>> sized;
+    const Elf64_Sym *symbols = nullptr;
+    const char *strings = nullptr;
+    if (symbol_section != 0)
+    {
+        const Elf64_Shdr& section = ELF::test::section_header(image, symbol_section);
+        symbols = reinterpret_cast<const Elf64_Sym *>(image.data() + section.sh_offset);
+        strings = reinterpret_cast<const char *>(image.data() + ELF::test::section_header(image, section.sh_link).sh_offset);
+        std::string current_file;
+        bool in_file = false;
+        for (std::size_t i = 0; i < section.sh_size / sizeof(Elf64_Sym); ++i)
+        {
+            const Elf64_Sym& symbol = symbols[i];
+            if (ELF64_ST_TYPE(symbol.st_info) == STT_FILE)
+            {
+                current_file = strings + symbol.st_name;
+                in_file = true;
+                continue;
+            }
+            if (ELF64_ST_TYPE(symbol.st_info) == STT_SECTION || symbol.st_size == 0 || symbol.st_shndx == SHN_UNDEF ||
+                symbol.st_shndx >= section_count)
+                continue;
+            symbol_bytes[symbol.st_shndx] += symbol.st_size;
+            ++symbol_counts[symbol.st_shndx];
+            bool local = ELF64_ST_BIND(symbol.st_info) == STB_LOCAL && in_file;
+            std::pair<Elf64_Xword, std::size_t>& file = files[local ? current_file : "(global symbols)"];
+            file.first += symbol.st_size;
+            ++file.second;
+            sized.emplace_back(symbol.st_size, i);
+        }
+    }
+
+    std::string report;
+    char line[512];
+    std::snprintf(line, sizeof(line), "Size report for %s (%lu bytes):\n\n", file_path.c_str(), image.size());
+    report += line;
+    report += "  [Nr] Name                   File size   Memory size  Symbol bytes  Symbols    %File\n";
+    Elf64_Xword file_total = 0, memory_total = 0;
+    for (std::size_t i = 1; i < section_count; ++i)
+    {
+        const Elf64_Shdr& section = ELF::test::section_header(image, i);
+        Elf64_Xword in_file = section.sh_type == SHT_NOBITS ? 0 : section.sh_size;
+        Elf64_Xword in_memory = (section.sh_flags & SHF_ALLOC) ? section.sh_size : 0;
+        file_total += in_file;
+        memory_total += in_memory;
+        std::snprintf(line, sizeof(line), "  [%2lu] %-20.20s %11lu  %12lu  %12lu  %7lu  %6.2f%%\n", i,
+                      section_name(i).c_str(), in_file, in_memory, symbol_bytes[i], symbol_counts[i],
+                      100.0 * static_cast<double>(in_file) / static_cast<double>(image.size()));
+        report += line;
+    }
+    std::snprintf(line, sizeof(line), "       %-20s %11lu  %12lu\n       %-20s %11lu\n", "Total", file_total,
+                  memory_total, "Headers and padding", image.size() - file_total);
+    report += line;
+    if (symbol_section == 0)
+    {
+        return report + "\nThere is no symbol table in this file.\n";
+    }
+
+    // Largest first; the test files have no two symbols of the same size.
+    std::sort(sized.rbegin(), sized.rend());
+    sized.resize(std::min(sized.size(), top));
+    std::snprintf(line, sizeof(line), "\nTop %lu symbols by size in '%s':\n", sized.size(),
+                  section_name(symbol_section).c_str());
+    report += line;
+    report += "   Num:       Size Type    Bind   Ndx Section          Name\n";
+    for (const auto& entry : sized)
+    {
+        const Elf64_Sym& symbol = symbols[entry.second];
+        std::snprintf(line, sizeof(line), "%6lu: %10lu %-7s %-6s %3u %-16.16s %s\n", entry.second, symbol.st_size,
+                      ELF::symbol_type_name(ELF64_ST_TYPE(symbol.st_info)),
+                      ELF::symbol_bind_name(ELF64_ST_BIND(symbol.st_info)), symbol.st_shndx,
+                      section_name(symbol.st_shndx).c_str(), strings + symbol.st_name);
+        report += line;
+    }
+
+    std::vector<std::pair<std::string, std::pair<Elf64_Xword, std::size_t>>> by_size(files.begin(), files.end());
+    std::stable_sort(by_size.begin(), by_size.end(), [](const decltype(by_size)::value_type& a,
+                                                        const decltype(by_size)::value_type& b) {
+        return a.second.first > b.second.first;
+    });
+    report += "\nSymbol bytes per source file (STT_FILE):\n         Bytes  Symbols  File\n";
+    for (const auto& file : by_size)
+    {
+        std::snprintf(line, sizeof(line), "  %12lu  %7lu  %s\n", file.second.first, file.second.second,
+                      file.first.empty() ? "(unnamed)" : file.first.c_str());
+        report += line;
+    }
+    return report;
+}
+
+void compare(const std::string& what, const std::string& got, const std::string& expected)
+{
+    if (got == expected)
+    {
+        return;
+    }
+    std::size_t at = 0;
+    while (at < got.size() && at < expected.size() && got[at] == expected[at])
+        ++at;
+    std::size_t line_start = expected.rfind('\n', at == 0 ? 0 : at - 1);
+    line_start = line_start == std::string::npos ? 0 : line_start + 1;
+    check(false, "%s differs at byte %lu:\n  got      %s\n  expected %s", what.c_str(), at,
+          got.substr(line_start, got.find('\n', line_start) - line_start).c_str(),
+          expected.substr(line_start, expected.find('\n', line_start) - line_start).c_str());
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: size_test READELF\n");
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[1];
+
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+
+    struct Sample
+    {
+        const char *file_name;
+        std::vector<std::uint8_t> image;
+    };
+    Sample samples[] = {
+        {"objects.o", build_objects_image(false)},
+        {"dynamic.so", build_objects_image(true)},
+        {"plain", build_plain_image()},
+    };
+    std::size_t reports = 0;
+    for (Sample& sample : samples)
+    {
+        std::string file_path = directory + "/" + sample.file_name;
+        if (!check(ELF::test::write_image(file_path, sample.image), "cannot write %s", file_path.c_str()))
+        {
+            continue;
+        }
+        for (std::size_t top : {0, 1, 3, 20, 1000})
+        {
+            std::string option = "--size-report=" + std::to_string(top);
+            ELF::test::Run_result result = run({readelf, option, file_path});
+            std::string what = std::string(sample.file_name) + " " + option;
+            check(result.status == EXIT_SUCCESS && result.errors.empty(), "%s exits %d: %s", what.c_str(),
+                  result.status, result.errors.c_str());
+            compare(what, result.output, reference_report(file_path, sample.image, top));
+            ++reports;
+        }
+        // The default is the 20 largest.
+        compare(std::string(sample.file_name) + " --size-report", run({readelf, "--size-report", file_path}).output,
+                reference_report(file_path, sample.image, 20));
+    }
+    printf("%lu reports compared with the reference\n", reports);
+
+    // The count is checked: the limit itself is taken, anything else is refused.
+    std::string objects_path = directory + "/objects.o";
+    compare("objects.o --size-report=10000", run({readelf, "--size-report=10000", objects_path}).output,
+            reference_report(objects_path, samples[0].image, 10000));
+    for (const char *count : {"10001", "100000000000", "-1", "abc", "5x", ""})
+    {
+        ELF::test::Run_result result = run({readelf, std::string("--size-report=") + count, objects_path});
+        check(result.status == EXIT_FAILURE && result.signal == 0 && result.output.empty() &&
+              result.errors.find("symbol count") != std::string::npos,
+              "--size-report=%s: status %d, signal %d, errors '%s'", count, result.status, result.signal,
+              result.errors.c_str());
+    }
+
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("size_test");
+}
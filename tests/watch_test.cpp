@@ -0,0 +1,166 @@
+/*
+* Watch test: starts readelf --watch -s on a file and rebuilds the file under it, checking
+* that
+*
+*   - a rebuild that only renames symbols, so only .strtab changes, prints the symbol table
+*     again with the new names;
+*   - a file that cannot be loaded is reported on standard error, not standard output, and
+*     the next good file is printed in full;
+*   - when the inotify queue overflows while the watcher is stopped, so the events for a
+*     rebuild are lost, the file is still read again and printed in full.  This part is
+*     skipped when the queue limit is too large to overflow quickly.
+*
+* Usage: watch_test READELF
+*/
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Elf_builder.h"
+#include "Test_support.h"
+
+namespace
+{
+
+using ELF::test::check;
+
+const long CHANGE_TIMEOUT_MS = 5000;
+const long POLL_INTERVAL_MS = 20;
+const long MAX_FLOODED_EVENTS = 100000;
+
+bool write_watched_file(const std::string& file_path, const std::string& first, const std::string& second)
+{
+    ELF::test::Elf_builder builder(ET_REL);
+    std::size_t text = builder.add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                           std::vector<std::uint8_t>(32, 0x90), 16);
+    std::vector<Elf64_Sym> symbols(3);
+    for (std::size_t i = 1; i < symbols.size(); ++i)
+    {
+        symbols[i].st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        symbols[i].st_shndx = static_cast<Elf64_Section>(text);
+        symbols[i].st_value = 16 * (i - 1);
+        symbols[i].st_size = 16;
+    }
+    builder.add_symbol_table({"", first, second}, symbols);
+
+    // Written next to the file and renamed over it, as most linkers do.
+    std::string temporary_path = file_path + ".tmp";
+    return builder.write(temporary_path) && ::rename(temporary_path.c_str(), file_path.c_str()) == 0;
+}
+
+std::size_t occurrences(const std::string& text, const std::string& word)
+{
+    std::size_t count = 0;
+    for (std::size_t at = text.find(word); at != std::string::npos; at = text.find(word, at + word.size()))
+    {
+        ++count;
+    }
+    return count;
+}
+
+// Wait until file_path holds at least count copies of word.  Returns false on time out.
+bool wait_for_text(const std::string& file_path, const std::string& word, std::size_t count = 1)
+{
+    for (long waited = 0; waited < CHANGE_TIMEOUT_MS; waited += POLL_INTERVAL_MS)
+    {
+        if (occurrences(ELF::test::read_file(file_path), word) >= count)
+        {
+            return true;
+        }
+        ELF::test::pause_for(POLL_INTERVAL_MS);
+    }
+    return false;
+}
+
+long queued_event_limit()
+{
+    std::string limit = ELF::test::read_file("/proc/sys/fs/inotify/max_queued_events");
+    return limit.empty() ? -1 : std::strtol(limit.c_str(), nullptr, 10);
+}
+
+// Create files in directory until about events inotify events have been queued for them.
+bool flood(const std::string& directory, long events)
+{
+    // Each file gives IN_CREATE and IN_CLOSE_WRITE.
+    for (long i = 0; i < events / 2 + 1; ++i)
+    {
+        std::string file_path = directory + "/flood-" + std::to_string(i);
+        int fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            return false;
+        }
+        ::close(fd);
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: watch_test READELF\n");
+        return EXIT_FAILURE;
+    }
+    std::string readelf = argv[1];
+
+    std::string directory = ELF::test::make_temporary_directory();
+    if (directory.empty())
+    {
+        return EXIT_FAILURE;
+    }
+    // The watched directory holds nothing but the file, so the output files make no events.
+    std::string watched_directory = directory + "/bin";
+    std::string file_path = watched_directory + "/watched.o";
+    std::string output_path = directory + "/output";
+    std::string errors_path = directory + "/errors";
+    if (!check(::mkdir(watched_directory.c_str(), 0755) == 0 && write_watched_file(file_path, "alpha", "beta"),
+               "cannot write %s", file_path.c_str()))
+    {
+        ELF::test::remove_directory(directory);
+        return ELF::test::finish("watch_test");
+    }
+
+    pid_t watcher = ELF::test::start({readelf, "--watch", "-s", file_path}, output_path, errors_path);
+    check(wait_for_text(output_path, "alpha"), "the first load was not printed");
+
+    // Same symbols, names of the same lengths: .symtab is byte for byte the same.
+    check(write_watched_file(file_path, "omega", "zeta"), "cannot rewrite %s", file_path.c_str());
+    check(wait_for_text(output_path, "changed"), "a rebuild was not reported");
+    check(wait_for_text(output_path, "omega") && wait_for_text(output_path, "zeta"),
+          "a change to .strtab alone did not print the symbols again");
+
+    check(ELF::test::write_file(file_path, "not an ELF file\n"), "cannot write %s", file_path.c_str());
+    check(wait_for_text(errors_path, "readelf: Error:"), "a file that cannot be loaded was not reported");
+    check(write_watched_file(file_path, "omega", "zeta"), "cannot rewrite %s", file_path.c_str());
+    check(wait_for_text(output_path, "reloaded"), "the file was not printed again after a failed load");
+    check(ELF::test::read_file(output_path).find("Error") == std::string::npos, "an error went to standard output");
+
+    long limit = queued_event_limit();
+    if (limit <= 0 || limit > MAX_FLOODED_EVENTS)
+    {
+        printf("inotify queue limit %ld: overflow not tested\n", limit);
+    }
+    else
+    {
+        // Stopped, the watcher reads nothing; the flood overflows its queue and the events
+        // of the rebuild after it are dropped.
+        ::kill(watcher, SIGSTOP);
+        check(flood(watched_directory, limit), "cannot create files in %s", watched_directory.c_str());
+        check(write_watched_file(file_path, "sigma", "iota"), "cannot rewrite %s", file_path.c_str());
+        ::kill(watcher, SIGCONT);
+        check(wait_for_text(output_path, "reloaded", 2) && wait_for_text(output_path, "sigma"),
+              "a rebuild whose events were lost in an overflow was not printed");
+    }
+
+    ELF::test::stop(watcher, SIGKILL);
+    ELF::test::remove_directory(directory);
+    return ELF::test::finish("watch_test");
+}